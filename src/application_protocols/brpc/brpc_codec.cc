@@ -35,6 +35,31 @@ MetaProtocolProxy::DecodeStatus BrpcCodec::decode(Buffer::Instance& buffer,
   return DecodeStatus::Done;
 }
 
+MetaProtocolProxy::DecodeStatus BrpcCodec::decodeFrame(Buffer::Instance& buffer,
+                                                       MetaProtocolProxy::Metadata& metadata) {
+  // A message whose header has been decoded is finished by the state machine.
+  if (decode_status != BrpcDecodeStatus::DecodeHeader) {
+    return decode(buffer, metadata);
+  }
+  const absl::optional<uint64_t> length = frameLength(buffer);
+  if (!length.has_value() || buffer.length() < length.value()) {
+    return DecodeStatus::WaitForData;
+  }
+
+  // Only the correlation id is read from the meta, the service and method names aren't needed.
+  const uint32_t meta_len = buffer.peekBEInt<uint32_t>(2 * sizeof(uint32_t));
+  if (BrpcHeader::HEADER_SIZE + static_cast<uint64_t>(meta_len) > length.value()) {
+    throw EnvoyException(fmt::format("brpc meta of {} bytes is longer than its frame", meta_len));
+  }
+  meta_.ParseFromArray(
+      static_cast<uint8_t*>(buffer.linearize(BrpcHeader::HEADER_SIZE + meta_len)) +
+          BrpcHeader::HEADER_SIZE,
+      meta_len);
+  metadata.setRequestId(meta_.correlation_id());
+  metadata.originMessage().move(buffer, length.value());
+  return DecodeStatus::Done;
+}
+
 void BrpcCodec::encode(const MetaProtocolProxy::Metadata& metadata,
                        const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
   // TODO we don't need to implement encode for now.
@@ -63,6 +88,19 @@ void BrpcCodec::onError(const MetaProtocolProxy::Metadata& /*metadata*/,
   // response.encode(buffer);
 }
 
+absl::optional<uint64_t> BrpcCodec::frameLength(Buffer::Instance& buffer) {
+  // The header is only peeked until the whole message has been received.
+  if (buffer.length() < BrpcHeader::HEADER_SIZE) {
+    return absl::nullopt;
+  }
+  // The length is only trusted if the header is a bRPC one.
+  const uint32_t magic = buffer.peekBEInt<uint32_t>();
+  if (magic != BrpcHeader::MAGIC) {
+    throw EnvoyException(fmt::format("invalid brpc magic {:#x}", magic));
+  }
+  return BrpcHeader::HEADER_SIZE + buffer.peekBEInt<uint32_t>(sizeof(uint32_t));
+}
+
 BrpcDecodeStatus BrpcCodec::handleState(Buffer::Instance& buffer) {
   switch (decode_status) {
   case BrpcDecodeStatus::DecodeHeader:
@@ -110,8 +148,13 @@ BrpcDecodeStatus BrpcCodec::decodeBody(Buffer::Instance& buffer) {
 }
 
 void BrpcCodec::toMetadata(MetaProtocolProxy::Metadata& metadata) {
-  // metadata.setRequestId(brpc_header_.get_pack_flow());
   // metadata.putString("cmd", std::to_string(brpc_header_.get_req_cmd()));
+  // The responses are matched to the requests by the correlation id.
+  metadata.setRequestId(meta_.correlation_id());
+  if (messageType_ == MetaProtocolProxy::MessageType::Request && meta_.has_request()) {
+    metadata.putString("service_name", meta_.request().service_name());
+    metadata.putString("method_name", meta_.request().method_name());
+  }
   metadata.originMessage().move(*origin_msg_);
 }
 
@@ -35,10 +35,13 @@ public:
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
+  MetaProtocolProxy::DecodeStatus decodeFrame(Buffer::Instance& buffer,
+                                              MetaProtocolProxy::Metadata& metadata) override;
   void encode(const MetaProtocolProxy::Metadata& metadata,
               const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
   void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
                Buffer::Instance& buffer) override;
+  absl::optional<uint64_t> frameLength(Buffer::Instance& buffer) override;
 
 protected:
   BrpcDecodeStatus handleState(Buffer::Instance& buffer);
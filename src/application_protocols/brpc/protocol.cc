@@ -7,7 +7,8 @@ namespace MetaProtocolProxy {
 namespace Brpc {
 
 const uint32_t BrpcHeader::HEADER_SIZE = 12;
-const uint32_t BrpcHeader::MAGIC = *static_cast<uint32_t*>(static_cast<void*>((const_cast<char*>("PRPC"))));
+// "PRPC" in network byte order.
+const uint32_t BrpcHeader::MAGIC = 0x50525043;
 
 bool BrpcHeader::decode(Buffer::Instance& buffer) {
   if (buffer.length() < HEADER_SIZE) {
@@ -17,7 +18,10 @@ bool BrpcHeader::decode(Buffer::Instance& buffer) {
 
   uint32_t pos = 0;
 
-  // todo : Check MAGIC
+  if (buffer.peekBEInt<uint32_t>(pos) != MAGIC) {
+    ENVOY_LOG(error, "Brpc Header decode invalid magic.");
+    return false;
+  }
   pos += sizeof(uint32_t);
 
   _body_len = buffer.peekBEInt<uint32_t>(pos);
@@ -6,6 +6,7 @@
 
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/application_protocols/dubbo/dubbo_codec.h"
+#include "src/application_protocols/dubbo/dubbo_protocol_impl.h"
 #include "src/application_protocols/dubbo/protocol.h"
 #include "src/application_protocols/dubbo/message.h"
 #include "src/application_protocols/dubbo/message_impl.h"
@@ -42,6 +43,32 @@ MetaProtocolProxy::DecodeStatus DubboCodec::decode(Buffer::Instance& buffer,
   return DecodeStatus::Done;
 }
 
+MetaProtocolProxy::DecodeStatus DubboCodec::decodeFrame(Buffer::Instance& buffer,
+                                                        MetaProtocolProxy::Metadata& metadata) {
+  // A message whose decoding has started is finished by the state machine.
+  if (decode_started_) {
+    return decode(buffer, metadata);
+  }
+
+  // The framing is in the fixed size header, the body is moved to the origin message without
+  // being deserialized.
+  auto msg_metadata = std::make_shared<MessageMetadata>();
+  auto result = protocol_->decodeHeader(buffer, msg_metadata);
+  if (!result.second) {
+    return DecodeStatus::WaitForData;
+  }
+  const uint64_t length = result.first->messageSize();
+  if (buffer.length() < length) {
+    return DecodeStatus::WaitForData;
+  }
+
+  toFrame(*msg_metadata, metadata);
+  metadata.setHeaderSize(result.first->headerSize());
+  metadata.setBodySize(result.first->bodySize());
+  metadata.originMessage().move(buffer, length);
+  return DecodeStatus::Done;
+}
+
 void DubboCodec::start() {
   state_machine_ = std::make_unique<DecoderStateMachine>(*protocol_);
   decode_started_ = true;
@@ -104,6 +131,11 @@ void DubboCodec::onError(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
+absl::optional<uint64_t> DubboCodec::frameLength(Buffer::Instance& buffer) {
+  // The header is only peeked until the whole message has been received.
+  return DubboProtocolImpl::peekMessageLength(buffer);
+}
+
 void DubboCodec::toMetadata(const MessageMetadata& msgMetadata,
                             MetaProtocolProxy::Metadata& metadata) {
   if (msgMetadata.hasInvocationInfo()) {
@@ -125,7 +157,6 @@ void DubboCodec::toMetadata(const MessageMetadata& msgMetadata,
   metadata.put("ProtocolType", msgMetadata.protocolType());
   metadata.put("ProtocolVersion", msgMetadata.protocolVersion());
   metadata.put("MessageType", msgMetadata.messageType());
-  metadata.setRequestId(msgMetadata.requestId());
   auto timeout = msgMetadata.timeout();
   if (timeout.has_value()) {
     metadata.put("Timeout", msgMetadata.timeout());
@@ -136,6 +167,12 @@ void DubboCodec::toMetadata(const MessageMetadata& msgMetadata,
     metadata.put("ResponseStatus", msgMetadata.responseStatus());
   }
 
+  toFrame(msgMetadata, metadata);
+}
+
+void DubboCodec::toFrame(const MessageMetadata& msgMetadata,
+                         MetaProtocolProxy::Metadata& metadata) {
+  metadata.setRequestId(msgMetadata.requestId());
   switch (msgMetadata.messageType()) {
   case MessageType::Request:
     metadata.setMessageType(MetaProtocolProxy::MessageType::Request);
@@ -108,13 +108,18 @@ public:
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
+  MetaProtocolProxy::DecodeStatus decodeFrame(Buffer::Instance& buffer,
+                                              MetaProtocolProxy::Metadata& metadata) override;
   void encode(const MetaProtocolProxy::Metadata& metadata,
               const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
   void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
                Buffer::Instance& buffer) override;
+  absl::optional<uint64_t> frameLength(Buffer::Instance& buffer) override;
 
 private:
   void toMetadata(const MessageMetadata& msgMetadata, MetaProtocolProxy::Metadata& metadata);
+  // Sets the request id, the message type and the response status.
+  static void toFrame(const MessageMetadata& msgMetadata, MetaProtocolProxy::Metadata& metadata);
 
   void toMetadata(const MessageMetadata& msgMetadata, Context& context,
                   MetaProtocolProxy::Metadata& metadata);
@@ -1,5 +1,8 @@
 #include "src/application_protocols/dubbo/dubbo_hessian2_serializer_impl.h"
 
+#include <algorithm>
+#include <array>
+
 #include "envoy/common/exception.h"
 
 #include "source/common/common/assert.h"
@@ -15,68 +18,129 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Dubbo {
 
+namespace {
+
+// The string encodings of Hessian2, see
+// http://hessian.caucho.com/doc/hessian-serialization.html#anchor14
+constexpr uint8_t ShortStringMax = 0x1f;
+constexpr uint8_t MediumStringBegin = 0x30;
+constexpr uint8_t MediumStringEnd = 0x33;
+constexpr uint8_t FinalChunk = 'S';
+
+// Reads a string of ASCII characters in place, which is how the names of an invocation are encoded
+// in practice. The length of a string counts its characters, which are one byte each then.
+// Returns false without reading anything if the string is encoded otherwise.
+bool readAsciiString(absl::string_view data, uint64_t& offset, absl::string_view& value) {
+  if (offset >= data.size()) {
+    return false;
+  }
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data.data()) + offset;
+  const uint64_t available = data.size() - offset;
+  uint64_t header_size;
+  uint64_t length;
+  if (bytes[0] <= ShortStringMax) {
+    header_size = 1;
+    length = bytes[0];
+  } else if (bytes[0] >= MediumStringBegin && bytes[0] <= MediumStringEnd && available >= 2) {
+    header_size = 2;
+    length = (static_cast<uint64_t>(bytes[0] - MediumStringBegin) << 8) | bytes[1];
+  } else if (bytes[0] == FinalChunk && available >= 3) {
+    header_size = 3;
+    length = (static_cast<uint64_t>(bytes[1]) << 8) | bytes[2];
+  } else {
+    return false;
+  }
+  if (available - header_size < length) {
+    return false;
+  }
+  for (uint64_t i = 0; i < length; i++) {
+    if (bytes[header_size + i] & 0x80) {
+      return false;
+    }
+  }
+  value = data.substr(offset + header_size, length);
+  offset += header_size + length;
+  return true;
+}
+
+} // namespace
+
 std::pair<RpcInvocationSharedPtr, bool>
 
 DubboHessian2SerializerImpl::deserializeRpcInvocation(Buffer::Instance& buffer,
                                                       ContextSharedPtr context) {
-  Hessian2::Decoder decoder(std::make_unique<BufferReader>(buffer));
+  // The dubbo version, service name, service version and method name are read in place from the
+  // first slice of the body when they can be, so that no string is allocated for them. The names
+  // are then interned by the invocation.
+  const Buffer::RawSlice slice = buffer.frontSlice();
+  const absl::string_view front(static_cast<const char*>(slice.mem_),
+                                std::min<uint64_t>(slice.len_, context->bodySize()));
+  std::array<absl::string_view, 4> names;
+  std::array<std::unique_ptr<std::string>, 4> decoded_names;
+  uint64_t offset = 0;
 
   // TODO(zyfjeff): Add format checker
-  auto dubbo_version = decoder.decode<std::string>();
-  auto service_name = decoder.decode<std::string>();
-  auto service_version = decoder.decode<std::string>();
-  auto method_name = decoder.decode<std::string>();
-
-  if (context->bodySize() < decoder.offset()) {
-    throw EnvoyException(fmt::format("RpcInvocation size({}) larger than body size({})",
-                                     decoder.offset(), context->bodySize()));
+  for (size_t i = 0; i < names.size(); i++) {
+    if (readAsciiString(front, offset, names[i])) {
+      continue;
+    }
+    Hessian2::Decoder decoder(std::make_unique<BufferReader>(buffer, offset));
+    decoded_names[i] = decoder.decode<std::string>();
+    if (decoded_names[i] == nullptr) {
+      throw EnvoyException(fmt::format("RpcInvocation has no request metadata"));
+    }
+    names[i] = *decoded_names[i];
+    offset = decoder.offset();
   }
 
-  if (dubbo_version == nullptr || service_name == nullptr || service_version == nullptr ||
-      method_name == nullptr) {
-    throw EnvoyException(fmt::format("RpcInvocation has no request metadata"));
+  if (context->bodySize() < offset) {
+    throw EnvoyException(fmt::format("RpcInvocation size({}) larger than body size({})", offset,
+                                     context->bodySize()));
   }
 
   auto invo = std::make_shared<RpcInvocationImpl>();
-  invo->setServiceName(*service_name);
-  invo->setServiceVersion(*service_version);
-  invo->setMethodName(*method_name);
-
-  size_t parsed_size = context->headerSize() + decoder.offset();
-
-  auto delayed_decoder = std::make_shared<Hessian2::Decoder>(
-      std::make_unique<BufferReader>(context->originMessage(), parsed_size));
-
-  invo->setParametersLazyCallback([delayed_decoder]() -> RpcInvocationImpl::ParametersPtr {
-    auto params = std::make_unique<RpcInvocationImpl::Parameters>();
-
-    if (auto types = delayed_decoder->decode<std::string>(); types != nullptr && !types->empty()) {
-      uint32_t number = HessianUtils::getParametersNumber(*types);
-      for (uint32_t i = 0; i < number; i++) {
-        if (auto result = delayed_decoder->decode<Hessian2::Object>(); result != nullptr) {
-          params->push_back(std::move(result));
+  invo->setServiceName(names[1]);
+  invo->setServiceVersion(names[2]);
+  invo->setMethodName(names[3]);
+
+  // The rest of the body is decoded from the origin message when it's needed, starting from the
+  // saved offsets. The origin message holds the body by then.
+  const size_t parsed_size = context->headerSize() + offset;
+  Buffer::Instance* origin_message = &context->originMessage();
+
+  invo->setParametersLazyCallback(
+      [origin_message, parsed_size](size_t& attachment_offset) -> RpcInvocationImpl::ParametersPtr {
+        Hessian2::Decoder decoder(std::make_unique<BufferReader>(*origin_message, parsed_size));
+        auto params = std::make_unique<RpcInvocationImpl::Parameters>();
+
+        if (auto types = decoder.decode<std::string>(); types != nullptr && !types->empty()) {
+          uint32_t number = HessianUtils::getParametersNumber(*types);
+          for (uint32_t i = 0; i < number; i++) {
+            if (auto result = decoder.decode<Hessian2::Object>(); result != nullptr) {
+              params->push_back(std::move(result));
+            } else {
+              throw EnvoyException("Cannot parse RpcInvocation parameter from buffer");
+            }
+          }
+        }
+        attachment_offset = decoder.offset();
+        return params;
+      });
+
+  invo->setAttachmentLazyCallback(
+      [origin_message](size_t offset) -> RpcInvocationImpl::AttachmentPtr {
+        Hessian2::Decoder decoder(std::make_unique<BufferReader>(*origin_message, offset));
+        auto result = decoder.decode<Hessian2::Object>();
+        if (result != nullptr && result->type() == Hessian2::Object::Type::UntypedMap) {
+          return std::make_unique<RpcInvocationImpl::Attachment>(
+              RpcInvocationImpl::Attachment::MapPtr{
+                  dynamic_cast<RpcInvocationImpl::Attachment::Map*>(result.release())},
+              offset);
         } else {
-          throw EnvoyException("Cannot parse RpcInvocation parameter from buffer");
+          return std::make_unique<RpcInvocationImpl::Attachment>(
+              std::make_unique<RpcInvocationImpl::Attachment::Map>(), offset);
         }
-      }
-    }
-    return params;
-  });
-
-  invo->setAttachmentLazyCallback([delayed_decoder]() -> RpcInvocationImpl::AttachmentPtr {
-    size_t offset = delayed_decoder->offset();
-
-    auto result = delayed_decoder->decode<Hessian2::Object>();
-    if (result != nullptr && result->type() == Hessian2::Object::Type::UntypedMap) {
-      return std::make_unique<RpcInvocationImpl::Attachment>(
-          RpcInvocationImpl::Attachment::MapPtr{
-              dynamic_cast<RpcInvocationImpl::Attachment::Map*>(result.release())},
-          offset);
-    } else {
-      return std::make_unique<RpcInvocationImpl::Attachment>(
-          std::make_unique<RpcInvocationImpl::Attachment::Map>(), offset);
-    }
-  });
+      });
 
   return std::pair<RpcInvocationSharedPtr, bool>(invo, true);
 }
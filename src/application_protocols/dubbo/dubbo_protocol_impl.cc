@@ -22,6 +22,35 @@ constexpr uint64_t StatusOffset = 3;
 constexpr uint64_t RequestIDOffset = 4;
 constexpr uint64_t BodySizeOffset = 12;
 
+// Hessian2 encodes the integers from -16 to 47, the response types among them, in a single byte.
+constexpr uint8_t CompactIntZero = 0x90;
+
+uint64_t loadBigEndian(const uint8_t* data, uint32_t length) {
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+// Most responses carry a value without attachments. Their response type is told from the first byte
+// of the body, without deserializing the result. The other responses are fully deserialized.
+bool isPlainValueResponse(Buffer::Instance& buffer, const Context& context,
+                          SerializationType type) {
+  if (type != SerializationType::Hessian2 || context.bodySize() == 0) {
+    return false;
+  }
+  const uint8_t response_type = buffer.peekInt<uint8_t>();
+  if (response_type ==
+      CompactIntZero + static_cast<uint8_t>(RpcResponseType::ResponseWithValue)) {
+    return true;
+  }
+  // A null value response has nothing after the response type.
+  return response_type ==
+             CompactIntZero + static_cast<uint8_t>(RpcResponseType::ResponseWithNullValue) &&
+         context.bodySize() == 1;
+}
+
 } // namespace
 
 // Consistent with the SerializationType
@@ -54,9 +83,8 @@ bool isValidResponseStatus(ResponseStatus status) {
   return true;
 }
 
-void parseRequestInfoFromBuffer(Buffer::Instance& data, MessageMetadataSharedPtr metadata) {
-  ASSERT(data.length() >= DubboProtocolImpl::MessageSize);
-  uint8_t flag = data.peekInt<uint8_t>(FlagOffset);
+void parseRequestInfoFromBuffer(const uint8_t* header, MessageMetadataSharedPtr metadata) {
+  uint8_t flag = header[FlagOffset];
   bool is_two_way = (flag & TwoWayMask) == TwoWayMask ? true : false;
   SerializationType type = static_cast<SerializationType>(flag & SerializationTypeMask);
   if (!isValidSerializationType(type)) {
@@ -72,9 +100,8 @@ void parseRequestInfoFromBuffer(Buffer::Instance& data, MessageMetadataSharedPtr
   metadata->setSerializationType(type);
 }
 
-void parseResponseInfoFromBuffer(Buffer::Instance& buffer, MessageMetadataSharedPtr metadata) {
-  ASSERT(buffer.length() >= DubboProtocolImpl::MessageSize);
-  ResponseStatus status = static_cast<ResponseStatus>(buffer.peekInt<uint8_t>(StatusOffset));
+void parseResponseInfoFromBuffer(const uint8_t* header, MessageMetadataSharedPtr metadata) {
+  ResponseStatus status = static_cast<ResponseStatus>(header[StatusOffset]);
   if (!isValidResponseStatus(status)) {
     throw EnvoyException(
         absl::StrCat("invalid dubbo message response status ",
@@ -84,6 +111,18 @@ void parseResponseInfoFromBuffer(Buffer::Instance& buffer, MessageMetadataShared
   metadata->setResponseStatus(status);
 }
 
+absl::optional<uint64_t> DubboProtocolImpl::peekMessageLength(Buffer::Instance& buffer) {
+  if (buffer.length() < DubboProtocolImpl::MessageSize ||
+      buffer.peekBEInt<uint16_t>() != MagicNumber) {
+    return absl::nullopt;
+  }
+  const int32_t body_size = buffer.peekBEInt<int32_t>(BodySizeOffset);
+  if (body_size < 0) {
+    return absl::nullopt;
+  }
+  return DubboProtocolImpl::MessageSize + static_cast<uint64_t>(body_size);
+}
+
 std::pair<ContextSharedPtr, bool>
 DubboProtocolImpl::decodeHeader(Buffer::Instance& buffer, MessageMetadataSharedPtr metadata) {
   if (!metadata) {
@@ -94,17 +133,21 @@ DubboProtocolImpl::decodeHeader(Buffer::Instance& buffer, MessageMetadataSharedP
     return std::pair<ContextSharedPtr, bool>(nullptr, false);
   }
 
-  uint16_t magic_number = buffer.peekBEInt<uint16_t>();
+  // The fixed size header is read in place rather than peeked field by field.
+  const uint8_t* header =
+      static_cast<const uint8_t*>(buffer.linearize(DubboProtocolImpl::MessageSize));
+  uint16_t magic_number = static_cast<uint16_t>(loadBigEndian(header, sizeof(uint16_t)));
   if (magic_number != MagicNumber) {
     throw EnvoyException(absl::StrCat("invalid dubbo message magic number ", magic_number));
   }
 
-  uint8_t flag = buffer.peekInt<uint8_t>(FlagOffset);
+  uint8_t flag = header[FlagOffset];
   MessageType type =
       (flag & MessageTypeMask) == MessageTypeMask ? MessageType::Request : MessageType::Response;
   bool is_event = (flag & EventMask) == EventMask ? true : false;
-  int64_t request_id = buffer.peekBEInt<int64_t>(RequestIDOffset);
-  int32_t body_size = buffer.peekBEInt<int32_t>(BodySizeOffset);
+  int64_t request_id =
+      static_cast<int64_t>(loadBigEndian(header + RequestIDOffset, sizeof(int64_t)));
+  int32_t body_size = static_cast<int32_t>(loadBigEndian(header + BodySizeOffset, sizeof(int32_t)));
 
   // The body size of the heartbeat message is zero.
   if (body_size > MaxBodySize || body_size < 0) {
@@ -118,13 +161,13 @@ DubboProtocolImpl::decodeHeader(Buffer::Instance& buffer, MessageMetadataSharedP
       type = MessageType::HeartbeatRequest;
     }
     metadata->setMessageType(type);
-    parseRequestInfoFromBuffer(buffer, metadata);
+    parseRequestInfoFromBuffer(header, metadata);
   } else {
     if (is_event) {
       type = MessageType::HeartbeatResponse;
     }
     metadata->setMessageType(type);
-    parseResponseInfoFromBuffer(buffer, metadata);
+    parseResponseInfoFromBuffer(header, metadata);
   }
 
   auto context = std::make_shared<ContextImpl>();
@@ -159,6 +202,9 @@ bool DubboProtocolImpl::decodeData(Buffer::Instance& buffer, ContextSharedPtr co
       metadata->setMessageType(MessageType::Exception);
       break;
     }
+    if (isPlainValueResponse(buffer, *context, metadata->serializationType())) {
+      break;
+    }
     auto ret = serializer_->deserializeRpcResult(buffer, context);
     if (!ret.second) {
       return false;
@@ -27,6 +27,12 @@ public:
   static constexpr uint8_t MessageSize = 16;
   static constexpr int32_t MaxBodySize = 16 * 1024 * 1024;
 
+  /**
+   * @return the length of the message at the start of the buffer, header included, or
+   * absl::nullopt if the buffer doesn't hold a whole valid header.
+   */
+  static absl::optional<uint64_t> peekMessageLength(Buffer::Instance& buffer);
+
 private:
   void headerMutation(Buffer::Instance& buffer, const MessageMetadata& metadata,
                       const Context& context);
@@ -1,5 +1,8 @@
 #include "src/application_protocols/dubbo/hessian_utils.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
@@ -62,7 +65,34 @@ void BufferWriter::rawWrite(absl::string_view data) { buffer_.add(data); }
 
 void BufferReader::rawReadNBytes(void* data, size_t len, size_t peek_offset) {
   ASSERT(byteAvailable() - peek_offset >= len);
-  buffer_.copyOut(offset() + peek_offset, len, data);
+  if (len == 0) {
+    return;
+  }
+  const uint64_t position = offset() + peek_offset;
+  if (slices_.size() == 1) {
+    // The message has been read in one go.
+    memcpy(data, static_cast<const uint8_t*>(slices_[0].mem_) + position, len);
+    return;
+  }
+
+  if (position < slice_offset_) {
+    slice_ = 0;
+    slice_offset_ = 0;
+  }
+  while (position >= slice_offset_ + slices_[slice_].len_) {
+    slice_offset_ += slices_[slice_].len_;
+    slice_++;
+  }
+
+  uint8_t* out = static_cast<uint8_t*>(data);
+  uint64_t start = position - slice_offset_;
+  for (size_t i = slice_; len > 0; i++) {
+    const uint64_t size = std::min<uint64_t>(len, slices_[i].len_ - start);
+    memcpy(out, static_cast<const uint8_t*>(slices_[i].mem_) + start, size);
+    out += size;
+    len -= size;
+    start = 0;
+  }
 }
 
 } // namespace Dubbo
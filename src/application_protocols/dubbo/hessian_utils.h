@@ -34,18 +34,28 @@ private:
   Envoy::Buffer::Instance& buffer_;
 };
 
+/**
+ * BufferReader reads the raw slices of a buffer directly instead of copying out of the buffer for
+ * each value. The slices are taken once, the buffer must not change while it's read.
+ */
 class BufferReader : public Hessian2::Reader {
 public:
-  BufferReader(Envoy::Buffer::Instance& buffer, uint64_t initial_offset = 0) : buffer_(buffer) {
+  BufferReader(Envoy::Buffer::Instance& buffer, uint64_t initial_offset = 0)
+      : slices_(buffer.getRawSlices()), length_(buffer.length()) {
     initial_offset_ = initial_offset;
   }
 
   // Hessian2::Reader
-  uint64_t length() const override { return buffer_.length(); }
+  uint64_t length() const override { return length_; }
   void rawReadNBytes(void* data, size_t len, size_t peek_offset) override;
 
 private:
-  Envoy::Buffer::Instance& buffer_;
+  const Envoy::Buffer::RawSliceVector slices_;
+  const uint64_t length_;
+  // The slice the last read started in and the offset of its first byte. The values are mostly
+  // read in order, so the next read looks for its slice from there.
+  size_t slice_{0};
+  uint64_t slice_offset_{0};
 };
 
 } // namespace Dubbo
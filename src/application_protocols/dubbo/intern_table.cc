@@ -0,0 +1,29 @@
+#include "src/application_protocols/dubbo/intern_table.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Dubbo {
+
+InternTable& InternTable::get() {
+  static thread_local InternTable table;
+  return table;
+}
+
+const std::string* InternTable::intern(absl::string_view value) {
+  auto iter = strings_.find(value);
+  if (iter != strings_.end()) {
+    return &*iter;
+  }
+  if (strings_.size() >= MaxStrings || value.size() > MaxStringLength) {
+    return nullptr;
+  }
+  return &*strings_.emplace(value).first;
+}
+
+} // namespace Dubbo
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
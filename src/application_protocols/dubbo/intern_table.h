@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "absl/container/node_hash_set.h"
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Dubbo {
+
+/**
+ * InternTable keeps a single copy of the service and method names of the Dubbo requests, which
+ * repeat from one request to the next, so that the invocations don't allocate a string for them.
+ * Each thread has its own table, so the lookups need no lock, and the strings live as long as the
+ * thread, so the invocations, which don't leave their worker, refer to them without counting.
+ */
+class InternTable {
+public:
+  /**
+   * @return InternTable& the table of the calling thread.
+   */
+  static InternTable& get();
+
+  /**
+   * @return const std::string* the string equal to the value, or nullptr if the value isn't in the
+   *         table and the table is full or the value too long.
+   */
+  const std::string* intern(absl::string_view value);
+
+  size_t size() const { return strings_.size(); }
+
+private:
+  // Bounds the memory held by the table, since the names come from the clients.
+  static constexpr size_t MaxStrings = 4096;
+  // Longer values are not worth keeping.
+  static constexpr size_t MaxStringLength = 256;
+
+  // The nodes keep the addresses of the strings stable.
+  absl::node_hash_set<std::string> strings_;
+};
+
+} // namespace Dubbo
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
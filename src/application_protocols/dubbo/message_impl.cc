@@ -61,7 +61,7 @@ const std::string* RpcInvocationImpl::Attachment::lookup(const std::string& key)
 void RpcInvocationImpl::assignParametersIfNeed() const {
   ASSERT(parameters_lazy_callback_ != nullptr);
   if (parameters_ == nullptr) {
-    parameters_ = parameters_lazy_callback_();
+    parameters_ = parameters_lazy_callback_(attachment_offset_);
   }
 }
 
@@ -72,7 +72,7 @@ void RpcInvocationImpl::assignAttachmentIfNeed() const {
   }
 
   assignParametersIfNeed();
-  attachment_ = attachment_lazy_callback_();
+  attachment_ = attachment_lazy_callback_(attachment_offset_);
 
   if (auto g = attachment_->lookup("group"); g != nullptr) {
     const_cast<RpcInvocationImpl*>(this)->group_ = *g;
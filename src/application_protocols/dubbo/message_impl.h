@@ -3,6 +3,7 @@
 #include "envoy/http/header_map.h"
 
 #include "src/application_protocols/dubbo/hessian_utils.h"
+#include "src/application_protocols/dubbo/intern_table.h"
 #include "src/application_protocols/dubbo/message.h"
 
 namespace Envoy {
@@ -33,21 +34,39 @@ class RpcInvocationBase : public RpcInvocation {
 public:
   ~RpcInvocationBase() override = default;
 
-  void setServiceName(const std::string& name) { service_name_ = name; }
-  const std::string& serviceName() const override { return service_name_; }
+  // The names are interned, the invocations of the same method share their strings. A name which
+  // can't be interned is kept by the invocation.
+  void setServiceName(absl::string_view name) {
+    setName(name, service_name_, service_name_storage_);
+  }
+  const std::string& serviceName() const override {
+    return service_name_ != nullptr ? *service_name_ : service_name_storage_;
+  }
 
-  void setMethodName(const std::string& name) { method_name_ = name; }
-  const std::string& methodName() const override { return method_name_; }
+  void setMethodName(absl::string_view name) { setName(name, method_name_, method_name_storage_); }
+  const std::string& methodName() const override {
+    return method_name_ != nullptr ? *method_name_ : method_name_storage_;
+  }
 
-  void setServiceVersion(const std::string& version) { service_version_ = version; }
+  // The versions are short, they fit in the inline buffer of the string.
+  void setServiceVersion(absl::string_view version) { service_version_.emplace(version); }
   const absl::optional<std::string>& serviceVersion() const override { return service_version_; }
 
   void setServiceGroup(const std::string& group) { group_ = group; }
   const absl::optional<std::string>& serviceGroup() const override { return group_; }
 
 protected:
-  std::string service_name_;
-  std::string method_name_;
+  static void setName(absl::string_view name, const std::string*& interned, std::string& storage) {
+    interned = InternTable::get().intern(name);
+    if (interned == nullptr) {
+      storage.assign(name.data(), name.size());
+    }
+  }
+
+  const std::string* service_name_{};
+  std::string service_name_storage_;
+  const std::string* method_name_{};
+  std::string method_name_storage_;
   absl::optional<std::string> service_version_;
   absl::optional<std::string> group_;
 };
@@ -97,8 +116,10 @@ public:
   };
   using AttachmentPtr = std::unique_ptr<Attachment>;
 
-  using AttachmentLazyCallback = std::function<AttachmentPtr()>;
-  using ParametersLazyCallback = std::function<ParametersPtr()>;
+  // The parameters and the attachment are decoded from the origin message when they're first
+  // used. The attachment follows the parameters, their callback tells where they end.
+  using AttachmentLazyCallback = std::function<AttachmentPtr(size_t attachment_offset)>;
+  using ParametersLazyCallback = std::function<ParametersPtr(size_t& attachment_offset)>;
 
   bool hasParameters() const { return parameters_ != nullptr; }
   const Parameters& parameters() const;
@@ -127,6 +148,7 @@ private:
 
   mutable ParametersPtr parameters_{};
   mutable AttachmentPtr attachment_{};
+  mutable size_t attachment_offset_{};
 };
 
 class RpcResultImpl : public RpcResult {
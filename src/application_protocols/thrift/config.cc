@@ -10,10 +10,27 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Thrift {
 
-MetaProtocolProxy::CodecPtr ThriftCodecConfig::createCodec(const Protobuf::Message&) {
-  return std::make_unique<Thrift::ThriftCodec>();
+MetaProtocolProxy::CodecPtr ThriftCodecConfig::createCodec(const Protobuf::Message& config) {
+  return std::make_unique<Thrift::ThriftCodec>(createFieldExtractor(config));
 };
 
+MetaProtocolProxy::CodecFactoryCb
+ThriftCodecConfig::createCodecFactory(const Protobuf::Message& config) {
+  // The field paths are compiled once, all the codecs share the extractor.
+  FieldExtractorSharedPtr field_extractor = createFieldExtractor(config);
+  return [field_extractor]() -> MetaProtocolProxy::CodecPtr {
+    return std::make_unique<Thrift::ThriftCodec>(field_extractor);
+  };
+}
+
+FieldExtractorSharedPtr ThriftCodecConfig::createFieldExtractor(const Protobuf::Message& config) {
+  const auto& codec_config = dynamic_cast<const aeraki::meta_protocol::codec::ThriftCodec&>(config);
+  if (codec_config.field_extractions().empty()) {
+    return nullptr;
+  }
+  return std::make_shared<FieldExtractor>(codec_config.field_extractions());
+}
+
 /**
  * Static registration for the thrift codec. @see RegisterFactory.
  */
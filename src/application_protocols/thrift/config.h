@@ -1,6 +1,7 @@
 #pragma once
 
 #include "src/meta_protocol_proxy/codec/factory.h"
+#include "src/application_protocols/thrift/field_extractor.h"
 #include "src/application_protocols/thrift/thrift_codec.pb.h"
 #include "src/application_protocols/thrift/thrift_codec.pb.validate.h"
 
@@ -15,6 +16,10 @@ class ThriftCodecConfig
 public:
   ThriftCodecConfig() : CodecFactoryBase("aeraki.meta_protocol.codec.thrift") {}
   MetaProtocolProxy::CodecPtr createCodec(const Protobuf::Message& config) override;
+  MetaProtocolProxy::CodecFactoryCb createCodecFactory(const Protobuf::Message& config) override;
+
+private:
+  static FieldExtractorSharedPtr createFieldExtractor(const Protobuf::Message& config);
 };
 
 } // namespace Thrift
@@ -0,0 +1,161 @@
+#include "src/application_protocols/thrift/field_extractor.h"
+
+#include "envoy/common/exception.h"
+
+#include "source/common/common/fmt.h"
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+FieldExtractor::FieldExtractor(
+    const Protobuf::RepeatedPtrField<aeraki::meta_protocol::codec::FieldExtraction>& extractions)
+    : nodes_(1) {
+  for (const auto& extraction : extractions) {
+    uint32_t index = 0;
+    for (absl::string_view id : absl::StrSplit(extraction.path(), '.')) {
+      int32_t field_id;
+      if (!absl::SimpleAtoi(id, &field_id) || field_id < INT16_MIN || field_id > INT16_MAX) {
+        throw EnvoyException(fmt::format("invalid thrift field path '{}'", extraction.path()));
+      }
+      const auto result = nodes_[index].children_.try_emplace(static_cast<int16_t>(field_id),
+                                                              static_cast<uint32_t>(nodes_.size()));
+      index = result.first->second;
+      if (result.second) {
+        // Invalidates the references to the nodes and their children.
+        nodes_.emplace_back();
+      }
+    }
+    if (!nodes_[index].key_.empty()) {
+      throw EnvoyException(
+          fmt::format("thrift field path '{}' is extracted more than once", extraction.path()));
+    }
+    nodes_[index].key_ = extraction.key();
+    keys_.insert(extraction.key());
+  }
+}
+
+bool FieldExtractor::extract(SpanReader& reader, ExtractedFields& fields, bool read_all) const {
+  return extractStruct(reader, nodes_.front(), fields, read_all);
+}
+
+bool FieldExtractor::extractStruct(SpanReader& reader, const Node& node, ExtractedFields& fields,
+                                   bool read_all) const {
+  reader.readStructBegin();
+  while (true) {
+    ThriftProxy::FieldType field_type;
+    int16_t field_id;
+    if (!reader.readFieldBegin(field_type, field_id)) {
+      return false;
+    }
+    if (field_type == ThriftProxy::FieldType::Stop) {
+      return reader.readStructEnd();
+    }
+
+    auto iter = node.children_.find(field_id);
+    if (iter == node.children_.end()) {
+      if (!reader.skip(field_type)) {
+        return false;
+      }
+      continue;
+    }
+
+    const Node& child = nodes_[iter->second];
+    if (field_type == ThriftProxy::FieldType::Struct && !child.children_.empty()) {
+      if (!extractStruct(reader, child, fields, read_all)) {
+        return false;
+      }
+      if (found(fields, read_all)) {
+        return true;
+      }
+      continue;
+    }
+    std::string value;
+    if (!child.key_.empty() && readValue(reader, field_type, value)) {
+      fields.emplace_back(child.key_, std::move(value));
+      if (found(fields, read_all)) {
+        return true;
+      }
+      continue;
+    }
+    // The value can't be extracted or the span ends before it.
+    if (!reader.skip(field_type)) {
+      return false;
+    }
+  }
+}
+
+bool FieldExtractor::readValue(SpanReader& reader, ThriftProxy::FieldType field_type,
+                               std::string& value) {
+  switch (field_type) {
+  case ThriftProxy::FieldType::Bool: {
+    bool v;
+    if (!reader.readBool(v)) {
+      return false;
+    }
+    value = v ? "true" : "false";
+    return true;
+  }
+  case ThriftProxy::FieldType::Byte: {
+    uint8_t v;
+    if (!reader.readByte(v)) {
+      return false;
+    }
+    value = std::to_string(static_cast<int8_t>(v));
+    return true;
+  }
+  case ThriftProxy::FieldType::I16: {
+    int16_t v;
+    if (!reader.readInt16(v)) {
+      return false;
+    }
+    value = std::to_string(v);
+    return true;
+  }
+  case ThriftProxy::FieldType::I32: {
+    int32_t v;
+    if (!reader.readInt32(v)) {
+      return false;
+    }
+    value = std::to_string(v);
+    return true;
+  }
+  case ThriftProxy::FieldType::I64: {
+    int64_t v;
+    if (!reader.readInt64(v)) {
+      return false;
+    }
+    value = std::to_string(v);
+    return true;
+  }
+  case ThriftProxy::FieldType::Double: {
+    double v;
+    if (!reader.readDouble(v)) {
+      return false;
+    }
+    value = fmt::format("{}", v);
+    return true;
+  }
+  case ThriftProxy::FieldType::String: {
+    absl::string_view v;
+    if (!reader.readString(v)) {
+      return false;
+    }
+    value = std::string(v);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "source/common/protobuf/protobuf.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "src/application_protocols/thrift/span_reader.h"
+#include "src/application_protocols/thrift/thrift.h"
+#include "src/application_protocols/thrift/thrift_codec.pb.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+using ExtractedFields = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * FieldExtractor reads the configured fields of the request arguments while the arguments struct
+ * is scanned. The field paths are compiled into a tree of field ids, so that each field of the
+ * message is either matched by a single lookup or skipped without being read.
+ */
+class FieldExtractor {
+public:
+  FieldExtractor(
+      const Protobuf::RepeatedPtrField<aeraki::meta_protocol::codec::FieldExtraction>& extractions);
+
+  bool empty() const { return nodes_.front().children_.empty(); }
+
+  /**
+   * @return bool whether the key is the metadata key of a configured field.
+   */
+  bool hasKey(absl::string_view key) const { return keys_.contains(key); }
+
+  /**
+   * Read the struct at the cursor of the reader, collecting the values of the configured fields.
+   * @param reader supplies the reader, positioned at the arguments struct.
+   * @param fields receives the metadata keys and values of the fields found.
+   * @param read_all supplies whether the struct is read to its end, otherwise the read stops once
+   *        all the configured fields are found.
+   * @return bool false if the span ends before the struct, or before the configured fields when
+   *         the struct isn't read to its end.
+   * @throw EnvoyException if the struct is invalid.
+   */
+  bool extract(SpanReader& reader, ExtractedFields& fields, bool read_all = true) const;
+
+private:
+  struct Node {
+    // The nodes of the fields of the struct, by field id.
+    absl::flat_hash_map<int16_t, uint32_t> children_;
+    // The metadata key of the value of the field, empty if the value isn't extracted.
+    std::string key_;
+  };
+
+  bool extractStruct(SpanReader& reader, const Node& node, ExtractedFields& fields,
+                     bool read_all) const;
+  bool found(const ExtractedFields& fields, bool read_all) const {
+    return !read_all && fields.size() == keys_.size();
+  }
+  static bool readValue(SpanReader& reader, ThriftProxy::FieldType field_type, std::string& value);
+
+  // The root is the arguments struct.
+  std::vector<Node> nodes_;
+  absl::flat_hash_set<std::string> keys_;
+};
+
+using FieldExtractorSharedPtr = std::shared_ptr<const FieldExtractor>;
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
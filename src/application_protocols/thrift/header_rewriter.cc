@@ -0,0 +1,179 @@
+#include "src/application_protocols/thrift/header_rewriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/fmt.h"
+
+#include "absl/strings/string_view.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+namespace {
+
+// The frame size, magic, flags, sequence id and header size which precede the header section, see
+// https://github.com/apache/thrift/blob/master/doc/specs/HeaderFormat.md
+constexpr uint64_t FixedHeaderSize = 14;
+constexpr uint64_t HeaderSizeOffset = 12;
+constexpr uint16_t HeaderMagic = 0x0fff;
+constexpr uint32_t InfoPadding = 0;
+constexpr uint32_t InfoKeyValue = 1;
+// The header size is in 4 byte words.
+constexpr uint64_t MaxHeaderBytes = 0xffff * 4;
+
+class HeaderSectionReader {
+public:
+  HeaderSectionReader(const uint8_t* data, uint64_t length) : pos_(data), end_(data + length) {}
+
+  bool done() const { return pos_ == end_; }
+  const uint8_t* pos() const { return pos_; }
+
+  uint32_t readVarint() {
+    uint32_t value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+      if (pos_ == end_) {
+        throw EnvoyException("invalid thrift header: truncated varint");
+      }
+      const uint8_t byte = *pos_++;
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    throw EnvoyException("invalid thrift header: varint too long");
+  }
+
+  absl::string_view readString() {
+    const uint32_t length = readVarint();
+    if (length > static_cast<uint64_t>(end_ - pos_)) {
+      throw EnvoyException(fmt::format("invalid thrift header: string of {} bytes", length));
+    }
+    absl::string_view value(reinterpret_cast<const char*>(pos_), length);
+    pos_ += length;
+    return value;
+  }
+
+private:
+  const uint8_t* pos_;
+  const uint8_t* const end_;
+};
+
+void writeVarint(std::string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void writeString(std::string& out, absl::string_view value) {
+  writeVarint(out, static_cast<uint32_t>(value.size()));
+  out.append(value.data(), value.size());
+}
+
+} // namespace
+
+bool HeaderRewriter::isHeaderFrame(Buffer::Instance& buffer) {
+  return buffer.length() >= FixedHeaderSize &&
+         buffer.peekBEInt<uint16_t>(sizeof(int32_t)) == HeaderMagic;
+}
+
+void HeaderRewriter::rewrite(Buffer::Instance& frame, const Mutation& headers) {
+  ASSERT(isHeaderFrame(frame));
+  const int32_t frame_size = frame.peekBEInt<int32_t>();
+  const uint64_t header_bytes =
+      static_cast<uint64_t>(frame.peekBEInt<uint16_t>(HeaderSizeOffset)) * 4;
+  if (frame_size < 0 ||
+      static_cast<uint64_t>(frame_size) + sizeof(int32_t) < FixedHeaderSize + header_bytes ||
+      frame.length() < FixedHeaderSize + header_bytes) {
+    throw EnvoyException(fmt::format("invalid thrift header: {} header bytes in a frame of {}",
+                                     header_bytes, frame_size));
+  }
+
+  // The header section is small, it's linearized to be read and overwritten in place.
+  uint8_t* prefix = static_cast<uint8_t*>(frame.linearize(FixedHeaderSize + header_bytes));
+  HeaderSectionReader reader(prefix + FixedHeaderSize, header_bytes);
+  // The protocol id and the transforms are kept as they are.
+  reader.readVarint();
+  const uint32_t transforms = reader.readVarint();
+  for (uint32_t i = 0; i < transforms; i++) {
+    reader.readVarint();
+  }
+  const absl::string_view kept(reinterpret_cast<const char*>(prefix + FixedHeaderSize),
+                               reader.pos() - (prefix + FixedHeaderSize));
+
+  std::vector<std::pair<absl::string_view, absl::string_view>> info;
+  while (!reader.done()) {
+    const uint32_t info_id = reader.readVarint();
+    if (info_id == InfoPadding) {
+      break;
+    }
+    if (info_id != InfoKeyValue) {
+      throw EnvoyException(fmt::format("invalid thrift header: unknown info id {}", info_id));
+    }
+    const uint32_t count = reader.readVarint();
+    for (uint32_t i = 0; i < count; i++) {
+      const absl::string_view key = reader.readString();
+      info.emplace_back(key, reader.readString());
+    }
+  }
+  for (const auto& header : headers) {
+    auto iter = std::find_if(info.begin(), info.end(),
+                             [&header](const auto& entry) { return entry.first == header.first; });
+    if (iter != info.end()) {
+      iter->second = header.second;
+    } else {
+      info.emplace_back(header.first, header.second);
+    }
+  }
+
+  std::string section(kept);
+  if (!info.empty()) {
+    writeVarint(section, InfoKeyValue);
+    writeVarint(section, static_cast<uint32_t>(info.size()));
+    for (const auto& entry : info) {
+      writeString(section, entry.first);
+      writeString(section, entry.second);
+    }
+  }
+  if (section.size() <= header_bytes) {
+    // The section fits, it's padded to its former size and overwritten in place, so that the frame
+    // size stays the same.
+    section.resize(header_bytes, static_cast<char>(InfoPadding));
+    std::memcpy(prefix + FixedHeaderSize, section.data(), section.size());
+    return;
+  }
+  section.resize((section.size() + 3) / 4 * 4, static_cast<char>(InfoPadding));
+
+  const uint64_t new_frame_size = frame_size - header_bytes + section.size();
+  if (section.size() > MaxHeaderBytes || new_frame_size > INT32_MAX) {
+    throw EnvoyException(fmt::format("thrift header section of {} bytes is too large",
+                                     section.size()));
+  }
+
+  Buffer::OwnedImpl new_prefix;
+  new_prefix.writeBEInt<int32_t>(static_cast<int32_t>(new_frame_size));
+  // The magic, flags and sequence id.
+  new_prefix.add(prefix + sizeof(int32_t), HeaderSizeOffset - sizeof(int32_t));
+  new_prefix.writeBEInt<uint16_t>(static_cast<uint16_t>(section.size() / 4));
+  new_prefix.add(section);
+
+  frame.drain(FixedHeaderSize + header_bytes);
+  frame.prepend(new_prefix);
+}
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "envoy/buffer/buffer.h"
+
+#include "src/meta_protocol_proxy/codec/codec.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+/**
+ * HeaderRewriter sets the info headers of a header transport (THeader) frame. Only the header
+ * section at the front of the frame is rewritten, the slices of the payload are kept as they are.
+ * A header section which doesn't grow is padded to its former size and overwritten in place.
+ */
+class HeaderRewriter {
+public:
+  /**
+   * @return bool whether the buffer starts with a header transport frame.
+   */
+  static bool isHeaderFrame(Buffer::Instance& buffer);
+
+  /**
+   * Set headers of the frame at the front of the buffer, the headers with the same keys are
+   * replaced.
+   * @param frame supplies the buffer starting with a complete header transport frame.
+   * @param headers supplies the headers to set.
+   * @throw EnvoyException if the header section of the frame is invalid.
+   */
+  static void rewrite(Buffer::Instance& frame, const Mutation& headers);
+};
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
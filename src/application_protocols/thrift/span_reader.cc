@@ -0,0 +1,594 @@
+#include "src/application_protocols/thrift/span_reader.h"
+
+#include <cstring>
+
+#include "envoy/common/exception.h"
+#include "envoy/common/platform.h"
+
+#include "source/common/common/assert.h"
+#include "source/common/common/fmt.h"
+
+#include "absl/numeric/bits.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+namespace {
+
+// The types of the compact protocol, see
+// https://github.com/apache/thrift/blob/master/doc/specs/thrift-compact-protocol.md
+enum CompactType : uint8_t {
+  CompactStop = 0,
+  CompactBoolTrue = 1,
+  CompactBoolFalse = 2,
+  CompactByte = 3,
+  CompactI16 = 4,
+  CompactI32 = 5,
+  CompactI64 = 6,
+  CompactDouble = 7,
+  CompactBinary = 8,
+  CompactList = 9,
+  CompactSet = 10,
+  CompactMap = 11,
+  CompactStruct = 12,
+};
+
+// The longest varint of a 64 bit value.
+constexpr uint32_t MaxVarintBytes = 10;
+
+uint64_t loadBigEndian(const uint8_t* data, uint32_t length) {
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+int64_t zigzagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+ThriftProxy::FieldType binaryType(uint8_t type) {
+  const auto field_type = static_cast<ThriftProxy::FieldType>(type);
+  switch (field_type) {
+  case ThriftProxy::FieldType::Stop:
+  case ThriftProxy::FieldType::Bool:
+  case ThriftProxy::FieldType::Byte:
+  case ThriftProxy::FieldType::Double:
+  case ThriftProxy::FieldType::I16:
+  case ThriftProxy::FieldType::I32:
+  case ThriftProxy::FieldType::I64:
+  case ThriftProxy::FieldType::String:
+  case ThriftProxy::FieldType::Struct:
+  case ThriftProxy::FieldType::Map:
+  case ThriftProxy::FieldType::Set:
+  case ThriftProxy::FieldType::List:
+    return field_type;
+  default:
+    throw EnvoyException(fmt::format("invalid thrift binary protocol field type {}", type));
+  }
+}
+
+} // namespace
+
+SpanReader::SpanReader(ThriftProxy::ProtocolType protocol, const uint8_t* data, uint64_t length)
+    : compact_(protocol == ThriftProxy::ProtocolType::Compact), begin_(data), pos_(data),
+      end_(data + length) {
+  ASSERT(supports(protocol));
+}
+
+bool SpanReader::supports(ThriftProxy::ProtocolType protocol) {
+  return protocol == ThriftProxy::ProtocolType::Binary ||
+         protocol == ThriftProxy::ProtocolType::LaxBinary ||
+         protocol == ThriftProxy::ProtocolType::Compact;
+}
+
+bool SpanReader::readStructBegin() {
+  if (compact_) {
+    last_field_ids_.push_back(last_field_id_);
+    last_field_id_ = 0;
+  }
+  return true;
+}
+
+bool SpanReader::readStructEnd() {
+  if (compact_) {
+    if (last_field_ids_.empty()) {
+      throw EnvoyException("invalid thrift compact protocol struct end");
+    }
+    last_field_id_ = last_field_ids_.back();
+    last_field_ids_.pop_back();
+  }
+  return true;
+}
+
+bool SpanReader::readFieldBegin(ThriftProxy::FieldType& field_type, int16_t& field_id) {
+  const uint8_t* start = pos_;
+  uint8_t header;
+  if (!readFixed(&header, 1)) {
+    return false;
+  }
+
+  if (!compact_) {
+    field_type = binaryType(header);
+    if (field_type == ThriftProxy::FieldType::Stop) {
+      field_id = 0;
+      return true;
+    }
+    uint8_t id[2];
+    if (!readFixed(id, 2)) {
+      pos_ = start;
+      return false;
+    }
+    field_id = static_cast<int16_t>(loadBigEndian(id, 2));
+    return true;
+  }
+
+  const uint8_t type = header & 0x0f;
+  if (type == CompactStop) {
+    field_type = ThriftProxy::FieldType::Stop;
+    field_id = 0;
+    return true;
+  }
+  const uint8_t delta = header >> 4;
+  if (delta != 0) {
+    field_id = static_cast<int16_t>(last_field_id_ + delta);
+  } else {
+    uint64_t id;
+    if (!readVarint(id)) {
+      pos_ = start;
+      return false;
+    }
+    field_id = static_cast<int16_t>(zigzagDecode(id));
+  }
+  field_type = compactElemType(type);
+  if (type == CompactBoolTrue || type == CompactBoolFalse) {
+    has_bool_field_ = true;
+    bool_field_ = type == CompactBoolTrue;
+  }
+  last_field_id_ = field_id;
+  return true;
+}
+
+bool SpanReader::readMapBegin(ThriftProxy::FieldType& key_type,
+                              ThriftProxy::FieldType& value_type, uint32_t& size) {
+  const uint8_t* start = pos_;
+  if (!compact_) {
+    uint8_t header[6];
+    if (!readFixed(header, sizeof(header))) {
+      return false;
+    }
+    const auto map_size = static_cast<int32_t>(loadBigEndian(header + 2, 4));
+    if (map_size < 0) {
+      throw EnvoyException(fmt::format("negative thrift map size {}", map_size));
+    }
+    key_type = binaryType(header[0]);
+    value_type = binaryType(header[1]);
+    size = static_cast<uint32_t>(map_size);
+    return true;
+  }
+
+  uint64_t map_size;
+  if (!readVarint(map_size)) {
+    return false;
+  }
+  if (map_size > INT32_MAX) {
+    throw EnvoyException(fmt::format("invalid thrift map size {}", map_size));
+  }
+  size = static_cast<uint32_t>(map_size);
+  if (size == 0) {
+    // An empty map has no types.
+    key_type = ThriftProxy::FieldType::Stop;
+    value_type = ThriftProxy::FieldType::Stop;
+    return true;
+  }
+  uint8_t types;
+  if (!readFixed(&types, 1)) {
+    pos_ = start;
+    return false;
+  }
+  key_type = compactElemType(types >> 4);
+  value_type = compactElemType(types & 0x0f);
+  return true;
+}
+
+bool SpanReader::readListBegin(ThriftProxy::FieldType& elem_type, uint32_t& size) {
+  const uint8_t* start = pos_;
+  if (!compact_) {
+    uint8_t header[5];
+    if (!readFixed(header, sizeof(header))) {
+      return false;
+    }
+    const auto list_size = static_cast<int32_t>(loadBigEndian(header + 1, 4));
+    if (list_size < 0) {
+      throw EnvoyException(fmt::format("negative thrift list size {}", list_size));
+    }
+    elem_type = binaryType(header[0]);
+    size = static_cast<uint32_t>(list_size);
+    return true;
+  }
+
+  uint8_t header;
+  if (!readFixed(&header, 1)) {
+    return false;
+  }
+  uint64_t list_size = header >> 4;
+  // A size of 15 or more is in a varint after the header.
+  if (list_size == 0x0f && !readVarint(list_size)) {
+    pos_ = start;
+    return false;
+  }
+  if (list_size > INT32_MAX) {
+    throw EnvoyException(fmt::format("invalid thrift list size {}", list_size));
+  }
+  elem_type = compactElemType(header & 0x0f);
+  size = static_cast<uint32_t>(list_size);
+  return true;
+}
+
+bool SpanReader::readBool(bool& value) {
+  if (has_bool_field_) {
+    has_bool_field_ = false;
+    value = bool_field_;
+    return true;
+  }
+  uint8_t byte;
+  if (!readFixed(&byte, 1)) {
+    return false;
+  }
+  value = compact_ ? byte == CompactBoolTrue : byte != 0;
+  return true;
+}
+
+bool SpanReader::readByte(uint8_t& value) { return readFixed(&value, 1); }
+
+bool SpanReader::readInt16(int16_t& value) {
+  int64_t wide;
+  if (!readInt64(wide)) {
+    return false;
+  }
+  value = static_cast<int16_t>(wide);
+  return true;
+}
+
+bool SpanReader::readInt32(int32_t& value) {
+  if (!compact_) {
+    uint8_t bytes[4];
+    if (!readFixed(bytes, sizeof(bytes))) {
+      return false;
+    }
+    value = static_cast<int32_t>(loadBigEndian(bytes, sizeof(bytes)));
+    return true;
+  }
+  int64_t wide;
+  if (!readInt64(wide)) {
+    return false;
+  }
+  value = static_cast<int32_t>(wide);
+  return true;
+}
+
+bool SpanReader::readInt64(int64_t& value) {
+  if (compact_) {
+    uint64_t raw;
+    if (!readVarint(raw)) {
+      return false;
+    }
+    value = zigzagDecode(raw);
+    return true;
+  }
+  uint8_t bytes[8];
+  if (!readFixed(bytes, sizeof(bytes))) {
+    return false;
+  }
+  value = static_cast<int64_t>(loadBigEndian(bytes, sizeof(bytes)));
+  return true;
+}
+
+bool SpanReader::readDouble(double& value) {
+  uint8_t bytes[8];
+  if (!readFixed(bytes, sizeof(bytes))) {
+    return false;
+  }
+  // The binary protocol writes doubles in big endian, the compact protocol in little endian.
+  uint64_t bits = 0;
+  if (compact_) {
+    for (int i = sizeof(bytes) - 1; i >= 0; i--) {
+      bits = (bits << 8) | bytes[i];
+    }
+  } else {
+    bits = loadBigEndian(bytes, sizeof(bytes));
+  }
+  static_assert(sizeof(double) == sizeof(uint64_t), "unexpected double size");
+  std::memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+bool SpanReader::readString(absl::string_view& value) {
+  const uint8_t* start = pos_;
+  uint64_t length;
+  if (compact_) {
+    if (!readVarint(length)) {
+      return false;
+    }
+  } else {
+    uint8_t bytes[4];
+    if (!readFixed(bytes, sizeof(bytes))) {
+      return false;
+    }
+    const auto signed_length = static_cast<int32_t>(loadBigEndian(bytes, sizeof(bytes)));
+    if (signed_length < 0) {
+      throw EnvoyException(fmt::format("negative thrift string length {}", signed_length));
+    }
+    length = static_cast<uint64_t>(signed_length);
+  }
+  if (length > static_cast<uint64_t>(end_ - pos_)) {
+    pos_ = start;
+    return false;
+  }
+  value = absl::string_view(reinterpret_cast<const char*>(pos_), length);
+  pos_ += length;
+  return true;
+}
+
+bool SpanReader::skip(ThriftProxy::FieldType field_type) {
+  const uint8_t* start = pos_;
+  const size_t struct_depth = last_field_ids_.size();
+  const int16_t last_field_id = last_field_id_;
+  const bool has_bool_field = has_bool_field_;
+  if (skip(field_type, 0)) {
+    return true;
+  }
+  pos_ = start;
+  last_field_ids_.resize(struct_depth);
+  last_field_id_ = last_field_id;
+  has_bool_field_ = has_bool_field;
+  return false;
+}
+
+bool SpanReader::skip(ThriftProxy::FieldType field_type, uint32_t depth) {
+  if (depth > MaxDepth) {
+    throw EnvoyException(fmt::format("thrift message nested deeper than {}", MaxDepth));
+  }
+
+  switch (field_type) {
+  case ThriftProxy::FieldType::Bool: {
+    bool value;
+    return readBool(value);
+  }
+  case ThriftProxy::FieldType::Byte:
+    return skipBytes(1);
+  case ThriftProxy::FieldType::I16:
+  case ThriftProxy::FieldType::I32:
+  case ThriftProxy::FieldType::I64: {
+    if (compact_) {
+      uint64_t value;
+      return readVarint(value);
+    }
+    return skipBytes(fixedSize(field_type));
+  }
+  case ThriftProxy::FieldType::Double:
+    return skipBytes(8);
+  case ThriftProxy::FieldType::String: {
+    absl::string_view value;
+    return readString(value);
+  }
+  case ThriftProxy::FieldType::Struct:
+    return skipStruct(depth + 1);
+  case ThriftProxy::FieldType::Map: {
+    ThriftProxy::FieldType key_type, value_type;
+    uint32_t size;
+    if (!readMapBegin(key_type, value_type, size)) {
+      return false;
+    }
+    if (size == 0) {
+      return true;
+    }
+    const uint32_t key_size = fixedSize(key_type);
+    const uint32_t value_size = fixedSize(value_type);
+    if (key_size != 0 && value_size != 0) {
+      return skipBytes(static_cast<uint64_t>(size) * (key_size + value_size));
+    }
+    if (isVarint(key_type) && isVarint(value_type)) {
+      return skipVarints(static_cast<uint64_t>(size) * 2);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      if (!skip(key_type, depth + 1) || !skip(value_type, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  case ThriftProxy::FieldType::Set:
+  case ThriftProxy::FieldType::List: {
+    ThriftProxy::FieldType elem_type;
+    uint32_t size;
+    if (!readListBegin(elem_type, size)) {
+      return false;
+    }
+    if (size == 0) {
+      return true;
+    }
+    // The elements of a primitive type are skipped at once.
+    const uint32_t elem_size = fixedSize(elem_type);
+    if (elem_size != 0) {
+      return skipBytes(static_cast<uint64_t>(size) * elem_size);
+    }
+    if (isVarint(elem_type)) {
+      return skipVarints(size);
+    }
+    for (uint32_t i = 0; i < size; i++) {
+      if (!skip(elem_type, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  default:
+    throw EnvoyException(
+        fmt::format("unknown field type {}", static_cast<int>(field_type)));
+  }
+}
+
+bool SpanReader::skipStruct(uint32_t depth) {
+  readStructBegin();
+  while (true) {
+    ThriftProxy::FieldType field_type;
+    int16_t field_id;
+    if (!readFieldBegin(field_type, field_id)) {
+      return false;
+    }
+    if (field_type == ThriftProxy::FieldType::Stop) {
+      return readStructEnd();
+    }
+    if (!skip(field_type, depth)) {
+      return false;
+    }
+  }
+}
+
+bool SpanReader::skipBytes(uint64_t length) {
+  if (length > static_cast<uint64_t>(end_ - pos_)) {
+    return false;
+  }
+  pos_ += length;
+  return true;
+}
+
+bool SpanReader::skipVarints(uint64_t count) {
+  const uint8_t* pos = pos_;
+  // The continuation bytes of the varint at pos.
+  uint32_t run = 0;
+
+  // Count the last bytes of the varints eight bytes at a time, the high bit of a byte is clear
+  // if the byte ends a varint.
+  while (end_ - pos >= 8) {
+    uint64_t word;
+    std::memcpy(&word, pos, sizeof(word));
+    const uint64_t ends = ~le64toh(word) & 0x8080808080808080ULL;
+    if (ends == 0) {
+      run += 8;
+      if (run >= MaxVarintBytes) {
+        throw EnvoyException("invalid thrift compact protocol varint");
+      }
+      pos += 8;
+      continue;
+    }
+    if (run + absl::countr_zero(ends) / 8 >= MaxVarintBytes) {
+      throw EnvoyException("invalid thrift compact protocol varint");
+    }
+    const uint32_t varints = absl::popcount(ends);
+    if (varints >= count) {
+      // The last varint ends in this word.
+      break;
+    }
+    count -= varints;
+    run = 7 - (63 - absl::countl_zero(ends)) / 8;
+    pos += 8;
+  }
+
+  while (count > 0) {
+    if (pos == end_) {
+      return false;
+    }
+    if (*pos++ & 0x80) {
+      if (++run >= MaxVarintBytes) {
+        throw EnvoyException("invalid thrift compact protocol varint");
+      }
+    } else {
+      run = 0;
+      count--;
+    }
+  }
+  pos_ = pos;
+  return true;
+}
+
+bool SpanReader::readVarint(uint64_t& value) {
+  const uint8_t* start = pos_;
+  value = 0;
+  for (uint32_t i = 0; i < MaxVarintBytes; i++) {
+    if (pos_ == end_) {
+      pos_ = start;
+      return false;
+    }
+    const uint8_t byte = *pos_++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  throw EnvoyException("invalid thrift compact protocol varint");
+}
+
+bool SpanReader::readFixed(uint8_t* value, uint32_t length) {
+  if (length > static_cast<uint64_t>(end_ - pos_)) {
+    return false;
+  }
+  std::memcpy(value, pos_, length);
+  pos_ += length;
+  return true;
+}
+
+uint32_t SpanReader::fixedSize(ThriftProxy::FieldType field_type) const {
+  switch (field_type) {
+  case ThriftProxy::FieldType::Bool:
+  case ThriftProxy::FieldType::Byte:
+    return 1;
+  case ThriftProxy::FieldType::Double:
+    return 8;
+  case ThriftProxy::FieldType::I16:
+    return compact_ ? 0 : 2;
+  case ThriftProxy::FieldType::I32:
+    return compact_ ? 0 : 4;
+  case ThriftProxy::FieldType::I64:
+    return compact_ ? 0 : 8;
+  default:
+    return 0;
+  }
+}
+
+bool SpanReader::isVarint(ThriftProxy::FieldType field_type) const {
+  return compact_ &&
+         (field_type == ThriftProxy::FieldType::I16 || field_type == ThriftProxy::FieldType::I32 ||
+          field_type == ThriftProxy::FieldType::I64);
+}
+
+ThriftProxy::FieldType SpanReader::compactElemType(uint8_t type) const {
+  switch (type) {
+  case CompactBoolTrue:
+  case CompactBoolFalse:
+    return ThriftProxy::FieldType::Bool;
+  case CompactByte:
+    return ThriftProxy::FieldType::Byte;
+  case CompactI16:
+    return ThriftProxy::FieldType::I16;
+  case CompactI32:
+    return ThriftProxy::FieldType::I32;
+  case CompactI64:
+    return ThriftProxy::FieldType::I64;
+  case CompactDouble:
+    return ThriftProxy::FieldType::Double;
+  case CompactBinary:
+    return ThriftProxy::FieldType::String;
+  case CompactList:
+    return ThriftProxy::FieldType::List;
+  case CompactSet:
+    return ThriftProxy::FieldType::Set;
+  case CompactMap:
+    return ThriftProxy::FieldType::Map;
+  case CompactStruct:
+    return ThriftProxy::FieldType::Struct;
+  default:
+    throw EnvoyException(fmt::format("invalid thrift compact protocol field type {}", type));
+  }
+}
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/string_view.h"
+#include "src/application_protocols/thrift/thrift.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+/**
+ * SpanReader reads the binary and compact protocols from a contiguous span of memory, typically a
+ * linearized message. Unlike ThriftProxy::Protocol, it doesn't drain a Buffer::Instance value by
+ * value: it moves a bounds-checked cursor, strings are returned as views into the span and values
+ * can be skipped without being materialized. The containers of primitive values are skipped at once
+ * rather than value by value.
+ *
+ * Each read returns false if the span ends before the value, the cursor is then left where it was
+ * before the read. Invalid data throws an EnvoyException.
+ */
+class SpanReader {
+public:
+  SpanReader(ThriftProxy::ProtocolType protocol, const uint8_t* data, uint64_t length);
+
+  /**
+   * @return bool whether the protocol can be read from a span, the twitter protocol can't.
+   */
+  static bool supports(ThriftProxy::ProtocolType protocol);
+
+  /**
+   * @return uint64_t the bytes read so far.
+   */
+  uint64_t offset() const { return pos_ - begin_; }
+
+  bool readStructBegin();
+  bool readStructEnd();
+  bool readFieldBegin(ThriftProxy::FieldType& field_type, int16_t& field_id);
+  bool readMapBegin(ThriftProxy::FieldType& key_type, ThriftProxy::FieldType& value_type,
+                    uint32_t& size);
+  bool readListBegin(ThriftProxy::FieldType& elem_type, uint32_t& size);
+  bool readSetBegin(ThriftProxy::FieldType& elem_type, uint32_t& size) {
+    return readListBegin(elem_type, size);
+  }
+  bool readBool(bool& value);
+  bool readByte(uint8_t& value);
+  bool readInt16(int16_t& value);
+  bool readInt32(int32_t& value);
+  bool readInt64(int64_t& value);
+  bool readDouble(double& value);
+  bool readString(absl::string_view& value);
+
+  /**
+   * Skip a value of the given type, including the nested values of a struct or a container.
+   * @return bool false if the span ends before the value.
+   */
+  bool skip(ThriftProxy::FieldType field_type);
+
+private:
+  // The nesting limit of skip, which protects the stack against malicious messages.
+  static constexpr uint32_t MaxDepth = 64;
+
+  bool skip(ThriftProxy::FieldType field_type, uint32_t depth);
+  bool skipStruct(uint32_t depth);
+  bool skipBytes(uint64_t length);
+  // Skips count compact protocol varints, counting their last bytes a word at a time.
+  bool skipVarints(uint64_t count);
+  bool readVarint(uint64_t& value);
+  bool readFixed(uint8_t* value, uint32_t length);
+  ThriftProxy::FieldType compactElemType(uint8_t type) const;
+  // The size of a value of the type, 0 if it isn't the same for all the values of the type.
+  uint32_t fixedSize(ThriftProxy::FieldType field_type) const;
+  bool isVarint(ThriftProxy::FieldType field_type) const;
+
+  const bool compact_;
+  const uint8_t* const begin_;
+  const uint8_t* pos_;
+  const uint8_t* const end_;
+  // The compact protocol encodes the field ids as deltas from the previous field of the struct.
+  absl::InlinedVector<int16_t, 8> last_field_ids_;
+  int16_t last_field_id_{};
+  // The compact protocol encodes the value of a bool field in its field header.
+  bool has_bool_field_{};
+  bool bool_field_{};
+};
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
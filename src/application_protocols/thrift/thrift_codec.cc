@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <any>
 
 #include "envoy/buffer/buffer.h"
@@ -7,6 +8,7 @@
 
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/application_protocols/thrift/thrift_codec.h"
+#include "src/application_protocols/thrift/header_rewriter.h"
 #include "src/application_protocols/thrift/metadata.h"
 
 namespace Envoy {
@@ -60,7 +62,12 @@ MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
     }
 
     frame_started_ = true;
-    state_machine_ = std::make_unique<DecoderStateMachine>(*protocol_, *metadata_);
+    // The body can only be passed through when the transport knows the frame size. The message
+    // body slices are then moved to the original message instead of being decoded and re-encoded.
+    const bool passthrough = metadata_->hasFrameSize() &&
+                             protocol_->type() != ThriftProxy::ProtocolType::Twitter;
+    state_machine_ = std::make_unique<DecoderStateMachine>(*protocol_, *metadata_, passthrough,
+                                                           field_extractor_.get());
   }
 
   ASSERT(state_machine_ != nullptr);
@@ -95,6 +102,85 @@ MetaProtocolProxy::DecodeStatus ThriftCodec::decode(Buffer::Instance& data,
   return DecodeStatus::Done;
 }
 
+absl::optional<uint64_t> ThriftCodec::frameLength(Buffer::Instance& buffer) {
+  // The transport consumes the frame size once the frame has started.
+  if (frame_started_ || buffer.length() < sizeof(int32_t) + sizeof(uint16_t)) {
+    return absl::nullopt;
+  }
+  // Only the framed and header transports tell the length of a message, they're told apart from
+  // the unframed transport by the binary (0x8001), compact (0x82) or header (0x0fff) magic which
+  // follows the frame size.
+  const int32_t frame_size = buffer.peekBEInt<int32_t>();
+  const uint16_t magic = buffer.peekBEInt<uint16_t>(sizeof(int32_t));
+  const bool framed = magic == 0x8001 || (magic >> 8) == 0x82 || magic == 0x0fff;
+  if (frame_size <= 0 || !framed) {
+    return absl::nullopt;
+  }
+  return sizeof(int32_t) + static_cast<uint64_t>(frame_size);
+}
+
+MetaProtocolProxy::DecodeStatus ThriftCodec::decodeFrame(Buffer::Instance& buffer,
+                                                         MetaProtocolProxy::Metadata& metadata) {
+  // Only the framed transport with the binary or the compact protocol tells the message type and
+  // the sequence id at the front of the frame, the other messages are decoded.
+  const absl::optional<uint64_t> length = frameLength(buffer);
+  if (!length.has_value() || buffer.peekBEInt<uint16_t>(sizeof(int32_t)) == 0x0fff) {
+    return decode(buffer, metadata);
+  }
+  if (buffer.length() < length.value()) {
+    return DecodeStatus::WaitForData;
+  }
+
+  uint8_t message_type;
+  int32_t sequence_id;
+  if (buffer.peekInt<uint8_t>(sizeof(int32_t)) == 0x82) {
+    // Compact: the protocol id, the version and type byte, then the sequence id as a varint.
+    message_type = buffer.peekInt<uint8_t>(sizeof(int32_t) + 1) >> 5;
+    uint32_t value = 0;
+    uint64_t offset = sizeof(int32_t) + 2;
+    for (uint32_t shift = 0;; shift += 7) {
+      if (shift >= 35 || offset >= length.value()) {
+        throw EnvoyException("invalid thrift compact message sequence id");
+      }
+      const uint8_t byte = buffer.peekInt<uint8_t>(offset++);
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    sequence_id = static_cast<int32_t>(value);
+  } else {
+    // Binary: the version and type word, the method name, then the sequence id.
+    message_type = buffer.peekInt<uint8_t>(2 * sizeof(int32_t) - 1);
+    const int32_t name_length = buffer.peekBEInt<int32_t>(2 * sizeof(int32_t));
+    if (name_length < 0 || 4 * sizeof(int32_t) + name_length > length.value()) {
+      throw EnvoyException(fmt::format("invalid thrift binary message name length {}",
+                                       name_length));
+    }
+    sequence_id = buffer.peekBEInt<int32_t>(3 * sizeof(int32_t) + name_length);
+  }
+
+  switch (static_cast<ThriftProxy::MessageType>(message_type)) {
+  case ThriftProxy::MessageType::Call:
+    metadata.setMessageType(MessageType::Request);
+    break;
+  case ThriftProxy::MessageType::Reply:
+    metadata.setMessageType(MessageType::Response);
+    break;
+  case ThriftProxy::MessageType::Oneway:
+    metadata.setMessageType(MessageType::Oneway);
+    break;
+  case ThriftProxy::MessageType::Exception:
+    metadata.setMessageType(MessageType::Error);
+    break;
+  default:
+    throw EnvoyException(fmt::format("invalid thrift message type {}", message_type));
+  }
+  metadata.setRequestId(sequence_id);
+  metadata.originMessage().move(buffer, length.value());
+  return DecodeStatus::Done;
+}
+
 void ThriftCodec::complete() {
   state_machine_ = nullptr;
   frame_started_ = false;
@@ -103,27 +189,22 @@ void ThriftCodec::complete() {
 
 void ThriftCodec::encode(const MetaProtocolProxy::Metadata& metadata,
                          const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) {
-  (void)buffer;
   for (const auto& keyValue : mutation) {
     ENVOY_LOG(debug, "thrift: codec mutation {} : {}", keyValue.first, keyValue.second);
   }
   ENVOY_LOG(debug, "thrift: codec server real address: {} ",
             metadata.getString(Metadata::HEADER_REAL_SERVER_ADDRESS));
-  // ASSERT(buffer.length() == 0);
+  // The buffer holds the decoded message, which has been framed again by the transport. It's
+  // forwarded as it is unless the mutation has to be applied to it.
   switch (metadata.getMessageType()) {
   case MetaProtocolProxy::MessageType::Heartbeat: {
     break;
   }
-  case MetaProtocolProxy::MessageType::Request: {
-    // TODO
-    break;
-  }
-  case MetaProtocolProxy::MessageType::Response: {
-    // TODO
-    break;
-  }
+  case MetaProtocolProxy::MessageType::Request:
+  case MetaProtocolProxy::MessageType::Oneway:
+  case MetaProtocolProxy::MessageType::Response:
   case MetaProtocolProxy::MessageType::Error: {
-    // TODO
+    encodeMutation(mutation, buffer);
     break;
   }
   default:
@@ -131,6 +212,21 @@ void ThriftCodec::encode(const MetaProtocolProxy::Metadata& metadata,
   }
 }
 
+void ThriftCodec::encodeMutation(const MetaProtocolProxy::Mutation& mutation,
+                                 Buffer::Instance& buffer) {
+  if (mutation.empty()) {
+    return;
+  }
+  // The mutation is carried by the info headers of the header transport, the other transports
+  // have no room for it.
+  if (!HeaderRewriter::isHeaderFrame(buffer)) {
+    ENVOY_LOG(debug, "thrift: the mutation is dropped, the message has no header transport");
+    return;
+  }
+  HeaderRewriter::rewrite(buffer, mutation);
+}
+
+static const std::string MethodKey = "method";
 static const std::string TApplicationException = "TApplicationException";
 static const std::string MessageField = "message";
 static const std::string TypeField = "type";
@@ -173,7 +269,7 @@ void ThriftCodec::onError(const MetaProtocolProxy::Metadata& metadata,
 
 void ThriftCodec::toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Metadata& metadata) {
   if (msgMetadata.hasMethodName()) {
-    metadata.putString("method", msgMetadata.methodName());
+    metadata.putString(MethodKey, msgMetadata.methodName());
   }
   if (msgMetadata.hasSequenceId()) {
     metadata.setRequestId(msgMetadata.sequenceId());
@@ -201,12 +297,29 @@ void ThriftCodec::toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Me
     NOT_REACHED_GCOVR_EXCL_LINE;
   }
 
+  for (const auto& field : state_machine_->extractedFields()) {
+    metadata.putString(field.first, field.second);
+  }
+
+  // The info headers of the header transport. They're set by the client, so they can't override
+  // the keys set by the codec or the proxy, which the routes match on.
+  msgMetadata.headers().iterate([this, &metadata](const Http::HeaderEntry& header) {
+    const absl::string_view key = header.key().getStringView();
+    if (key == MethodKey || key == Metadata::HEADER_REAL_SERVER_ADDRESS ||
+        (field_extractor_ != nullptr && field_extractor_->hasKey(key))) {
+      ENVOY_LOG(debug, "thrift: info header {} is ignored, the key is reserved", key);
+      return Http::HeaderMap::Iterate::Continue;
+    }
+    metadata.putString(std::string(key), std::string(header.value().getStringView()));
+    return Http::HeaderMap::Iterate::Continue;
+  });
+
   transport_->encodeFrame(metadata.originMessage(), msgMetadata, state_machine_->originalMessage());
 }
 
 void ThriftCodec::toMsgMetadata(const Metadata& metadata,
                                 ThriftProxy::MessageMetadata& msgMetadata) {
-  auto method = metadata.getString("method");
+  auto method = metadata.getString(MethodKey);
   // TODO we should use a more appropriate method to tell if metadata contains a specific key
   if (method != "") {
     msgMetadata.setMethodName(method);
@@ -225,7 +338,65 @@ ProtocolState DecoderStateMachine::passthroughData(Buffer::Instance& buffer) {
   return ProtocolState::MessageEnd;
 }
 
+// ScanData -> ScanData
+// ScanData -> PassthroughData (the body has been scanned)
+// ScanData -> StructBegin (the unframed body is too long to be scanned)
+ProtocolState DecoderStateMachine::scanData(Buffer::Instance& buffer) {
+  extracted_fields_.clear();
+  if (passthrough_enabled_) {
+    return scanFramedData(buffer);
+  }
+
+  // Without a frame, the scan starts over from the beginning of the body each time more data
+  // comes, which is only cheaper than the state machine as long as the body is short. The buffer
+  // may hold the next pipelined messages too, only its beginning is scanned.
+  const uint64_t length = std::min(buffer.length(), MaxUnframedScanBytes);
+  SpanReader reader(proto_.type(), static_cast<const uint8_t*>(buffer.linearize(length)), length);
+  if (extract_ ? !field_extractor_->extract(reader, extracted_fields_)
+               : !reader.skip(ThriftProxy::FieldType::Struct)) {
+    if (buffer.length() > MaxUnframedScanBytes) {
+      ENVOY_LOG(debug, "thrift: unframed body longer than {} bytes, decoding it without scanning",
+                MaxUnframedScanBytes);
+      extracted_fields_.clear();
+      return ProtocolState::StructBegin;
+    }
+    return ProtocolState::WaitForData;
+  }
+
+  body_bytes_ = reader.offset();
+  return ProtocolState::PassthroughData;
+}
+
+ProtocolState DecoderStateMachine::scanFramedData(Buffer::Instance& buffer) {
+  // The body of a framed message is scanned once it has been received entirely, for its fields
+  // only since its end is known.
+  ASSERT(extract_);
+  if (body_bytes_ > buffer.length()) {
+    return ProtocolState::WaitForData;
+  }
+
+  // The fields are usually near the beginning of the body, it's scanned within its first slice
+  // first. The body is only linearized, which copies it, if the fields aren't all found there.
+  const Buffer::RawSlice slice = buffer.frontSlice();
+  if (slice.len_ < body_bytes_) {
+    SpanReader reader(proto_.type(), static_cast<const uint8_t*>(slice.mem_), slice.len_);
+    if (field_extractor_->extract(reader, extracted_fields_, false)) {
+      return ProtocolState::PassthroughData;
+    }
+    extracted_fields_.clear();
+  }
+
+  SpanReader reader(proto_.type(), static_cast<const uint8_t*>(buffer.linearize(body_bytes_)),
+                    body_bytes_);
+  if (!field_extractor_->extract(reader, extracted_fields_, false)) {
+    throw EnvoyException("thrift message body is longer than its frame");
+  }
+  return ProtocolState::PassthroughData;
+}
+
 // MessageBegin -> StructBegin
+// MessageBegin -> PassthroughData (the frame size is known)
+// MessageBegin -> ScanData (the body can be scanned or has fields to extract)
 ProtocolState DecoderStateMachine::messageBegin(Buffer::Instance& buffer) {
   const auto total = buffer.length();
   if (!proto_.readMessageBegin(buffer, metadata_)) {
@@ -235,12 +406,21 @@ ProtocolState DecoderStateMachine::messageBegin(Buffer::Instance& buffer) {
   stack_.clear();
   stack_.emplace_back(Frame(ProtocolState::MessageEnd));
 
+  proto_.writeMessageBegin(origin_message_, metadata_);
+  // The auto protocol has detected the protocol of the connection by now. Without a frame size, the
+  // end of the body is found by scanning it with a SpanReader, unless the protocol can only be read
+  // from a buffer.
+  const bool scannable = SpanReader::supports(proto_.type());
+  extract_ = scannable && field_extractor_ != nullptr && isRequest();
   if (passthrough_enabled_) {
     body_bytes_ = metadata_.frameSize() - (total - buffer.length());
-    return ProtocolState::PassthroughData;
+    // The body of a request is scanned for the configured fields.
+    return extract_ ? ProtocolState::ScanData : ProtocolState::PassthroughData;
+  }
+  if (scannable) {
+    return ProtocolState::ScanData;
   }
 
-  proto_.writeMessageBegin(origin_message_, metadata_);
   return ProtocolState::StructBegin;
 }
 
@@ -529,6 +709,8 @@ ProtocolState DecoderStateMachine::handleState(Buffer::Instance& buffer) {
   switch (state_) {
   case ProtocolState::PassthroughData:
     return passthroughData(buffer);
+  case ProtocolState::ScanData:
+    return scanData(buffer);
   case ProtocolState::MessageBegin:
     return messageBegin(buffer);
   case ProtocolState::StructBegin:
@@ -11,7 +11,9 @@
 #include "source/common/common/logger.h"
 
 #include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/application_protocols/thrift/field_extractor.h"
 #include "src/application_protocols/thrift/protocol.h"
+#include "src/application_protocols/thrift/span_reader.h"
 #include "src/application_protocols/thrift/transport.h"
 #include "src/application_protocols/thrift/thrift.h"
 
@@ -25,6 +27,7 @@ namespace Thrift {
   FUNCTION(StopIteration)                                                                          \
   FUNCTION(WaitForData)                                                                            \
   FUNCTION(PassthroughData)                                                                        \
+  FUNCTION(ScanData)                                                                               \
   FUNCTION(MessageBegin)                                                                           \
   FUNCTION(MessageEnd)                                                                             \
   FUNCTION(StructBegin)                                                                            \
@@ -70,8 +73,10 @@ private:
  */
 class DecoderStateMachine : public Logger::Loggable<Logger::Id::thrift> {
 public:
-  DecoderStateMachine(ThriftProxy::Protocol& proto, ThriftProxy::MessageMetadata& metadata)
-      : proto_(proto), metadata_(metadata), state_(ProtocolState::MessageBegin) {}
+  DecoderStateMachine(ThriftProxy::Protocol& proto, ThriftProxy::MessageMetadata& metadata,
+                      bool passthrough_enabled, const FieldExtractor* field_extractor = nullptr)
+      : proto_(proto), metadata_(metadata), state_(ProtocolState::MessageBegin),
+        passthrough_enabled_(passthrough_enabled), field_extractor_(field_extractor) {}
 
   /**
    * Consumes as much data from the configured Buffer as possible and executes the decoding state
@@ -100,6 +105,11 @@ public:
    */
   Buffer::Instance& originalMessage() { return origin_message_; }
 
+  /**
+   * @return the fields extracted from the request arguments
+   */
+  const ExtractedFields& extractedFields() const { return extracted_fields_; }
+
 private:
   /**
    * Frame encodes information about the return state for nested elements, container element types,
@@ -133,6 +143,7 @@ private:
   // These functions map directly to the matching ProtocolState values. Each returns the next state
   // or ProtocolState::WaitForData if more data is required.
   ProtocolState passthroughData(Buffer::Instance& buffer);
+  ProtocolState scanData(Buffer::Instance& buffer);
   ProtocolState messageBegin(Buffer::Instance& buffer);
   ProtocolState messageEnd(Buffer::Instance& buffer);
   ProtocolState structBegin(Buffer::Instance& buffer);
@@ -159,6 +170,12 @@ private:
   ProtocolState handleValue(Buffer::Instance& buffer, ThriftProxy::FieldType elem_type,
                             ProtocolState return_state);
 
+  bool isRequest() const {
+    return metadata_.hasMessageType() &&
+           (metadata_.messageType() == ThriftProxy::MessageType::Call ||
+            metadata_.messageType() == ThriftProxy::MessageType::Oneway);
+  }
+
   // handleState delegates to the appropriate method based on state_.
   ProtocolState handleState(Buffer::Instance& buffer);
 
@@ -166,12 +183,26 @@ private:
   // stack.
   ProtocolState popReturnState();
 
+  // Scans the body of a framed message for the configured fields.
+  ProtocolState scanFramedData(Buffer::Instance& buffer);
+
+  // The unframed bodies longer than this are decoded by the state machine instead of being scanned
+  // again each time more data comes.
+  static constexpr uint64_t MaxUnframedScanBytes = 64 * 1024;
+
   ThriftProxy::Protocol& proto_;
   ThriftProxy::MessageMetadata& metadata_;
   ProtocolState state_;
   std::vector<Frame> stack_;
   uint32_t body_bytes_{};
-  bool passthrough_enabled_{false}; // TODO enable passthrough in the codec config
+  // When enabled, the message body is moved into the original message without being decoded.
+  const bool passthrough_enabled_;
+  // Extracts the configured fields of the requests while their body is scanned.
+  const FieldExtractor* const field_extractor_;
+  // Whether the fields of the current message are extracted. It's decided once the message begin
+  // has been read, since the auto protocol only knows the actual protocol by then.
+  bool extract_{false};
+  ExtractedFields extracted_fields_;
   Buffer::OwnedImpl origin_message_;
 };
 
@@ -182,7 +213,8 @@ using DecoderStateMachinePtr = std::unique_ptr<DecoderStateMachine>;
  */
 class ThriftCodec : public MetaProtocolProxy::Codec, public Logger::Loggable<Logger::Id::filter> {
 public:
-  ThriftCodec() {
+  explicit ThriftCodec(FieldExtractorSharedPtr field_extractor = nullptr)
+      : field_extractor_(std::move(field_extractor)) {
     transport_ =
         ThriftProxy::NamedTransportConfigFactory::getFactory(ThriftProxy::TransportType::Auto)
             .createTransport();
@@ -193,22 +225,28 @@ public:
 
   MetaProtocolProxy::DecodeStatus decode(Buffer::Instance& buffer,
                                          MetaProtocolProxy::Metadata& metadata) override;
+  MetaProtocolProxy::DecodeStatus decodeFrame(Buffer::Instance& buffer,
+                                              MetaProtocolProxy::Metadata& metadata) override;
   void encode(const MetaProtocolProxy::Metadata& metadata,
               const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer) override;
   void onError(const MetaProtocolProxy::Metadata& metadata, const MetaProtocolProxy::Error& error,
                Buffer::Instance& buffer) override;
+  absl::optional<uint64_t> frameLength(Buffer::Instance& buffer) override;
 
 private:
   void toMetadata(const ThriftProxy::MessageMetadata& msgMetadata, Metadata& metadata);
 
   void toMsgMetadata(const Metadata& metadata, ThriftProxy::MessageMetadata& msgMetadata);
 
+  void encodeMutation(const MetaProtocolProxy::Mutation& mutation, Buffer::Instance& buffer);
+
   void complete();
 
   ThriftProxy::TransportPtr transport_;
   ThriftProxy::ProtocolPtr protocol_;
   ThriftProxy::MessageMetadataSharedPtr metadata_;
   DecoderStateMachinePtr state_machine_;
+  FieldExtractorSharedPtr field_extractor_;
   bool frame_started_{false};
   bool frame_ended_{false};
 };
@@ -13,10 +13,13 @@ namespace MetaProtocolProxy {
 
 // class ActiveResponseDecoder
 ActiveResponseDecoder::ActiveResponseDecoder(ActiveMessage& parent, MetaProtocolProxyStats& stats,
+                                             MetaProtocolProxyPhaseStats* phase_stats,
+                                             TimeSource& time_source,
                                              Network::Connection& connection,
                                              std::string applicationProtocol, CodecPtr&& codec,
                                              Metadata& requestMetadata)
-    : parent_(parent), stats_(stats), downstream_connection_(connection),
+    : parent_(parent), stats_(stats), phase_stats_(phase_stats), time_source_(time_source),
+      downstream_connection_(connection),
       application_protocol_(applicationProtocol), codec_(std::move(codec)),
       request_metadata_(requestMetadata),
       decoder_(std::make_unique<ResponseDecoder>(*codec_, *this)), complete_(false),
@@ -27,6 +30,9 @@ UpstreamResponseStatus ActiveResponseDecoder::onData(Buffer::Instance& data) {
             application_protocol_, data.length());
 
   bool underflow = false;
+  if (phase_stats_ != nullptr) {
+    decode_start_ = time_source_.monotonicTime();
+  }
   decoder_->onData(data, underflow);
   // decoder return underflow in th following two cases:
   // 1. decoder needs more data to complete the decoding of the current response, in this case,
@@ -45,7 +51,13 @@ void ActiveResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata,
   ASSERT(metadata->getMessageType() == MessageType::Response ||
          metadata->getMessageType() == MessageType::Error);
 
+  if (phase_stats_ != nullptr) {
+    MetaProtocolProxyPhaseStats::recordSince(phase_stats_->upstream_response_decode_us_,
+                                             decode_start_, time_source_);
+  }
+
   metadata_ = metadata;
+  stats_.response_size_bytes_.recordValue(metadata->originMessage().length());
   if (applyMessageEncodedFilters(metadata, mutation) != FilterStatus::ContinueIteration) {
     response_status_ = UpstreamResponseStatus::Complete;
     return;
@@ -59,8 +71,14 @@ void ActiveResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata,
   metadata_->putString(Metadata::HEADER_REAL_SERVER_ADDRESS,
                        request_metadata_.getString(Metadata::HEADER_REAL_SERVER_ADDRESS));
   // TODO support response mutation
+  const MonotonicTime encode_start =
+      phase_stats_ != nullptr ? time_source_.monotonicTime() : MonotonicTime();
   codec_->encode(*metadata_, Mutation{}, metadata->originMessage());
-  downstream_connection_.write(metadata->originMessage(), false);
+  if (phase_stats_ != nullptr) {
+    MetaProtocolProxyPhaseStats::recordSince(phase_stats_->upstream_response_encode_us_,
+                                             encode_start, time_source_);
+  }
+  parent_.connection_manager_.downstreamWriteBatcher().write(metadata->originMessage(), false);
   ENVOY_LOG(debug,
             "meta protocol {} response: the upstream response message has been forwarded to the "
             "downstream",
@@ -72,12 +90,19 @@ void ActiveResponseDecoder::onMessageDecoded(MetadataSharedPtr metadata,
     stats_.response_business_exception_.inc();
   }
 
+  auto& method_stats = parent_.method_stats_;
   switch (metadata->getResponseStatus()) {
   case ResponseStatus::Ok:
     stats_.response_success_.inc();
+    if (method_stats != nullptr) {
+      method_stats->response_success_.inc();
+    }
     break;
   default:
     stats_.response_error_.inc();
+    if (method_stats != nullptr) {
+      method_stats->response_error_.inc();
+    }
     ENVOY_LOG(error, "meta protocol {} response status: {}", application_protocol_,
               metadata->getResponseStatus());
     break;
@@ -179,11 +204,20 @@ void ActiveMessageDecoderFilter::resetDownstreamConnection() {
 
 CodecPtr ActiveMessageDecoderFilter::createCodec() { return activeMessage_.createCodec(); }
 
+void ActiveMessageDecoderFilter::onUpstreamRequestSent(std::chrono::microseconds connection_wait) {
+  activeMessage_.onUpstreamRequestSent(connection_wait);
+}
+
 void ActiveMessageDecoderFilter::setUpstreamConnection(
     Tcp::ConnectionPool::ConnectionDataPtr conn) {
   return activeMessage_.setUpstreamConnection(std::move(conn));
 }
 
+Tcp::ConnectionPool::ConnectionData*
+ActiveMessageDecoderFilter::sharedStreamConnection(const std::string& host) {
+  return activeMessage_.sharedStreamConnection(host);
+}
+
 // class ActiveMessageEncoderFilter
 ActiveMessageEncoderFilter::ActiveMessageEncoderFilter(ActiveMessage& parent,
                                                        EncoderFilterSharedPtr filter,
@@ -221,6 +255,12 @@ ActiveMessage::~ActiveMessage() {
   ENVOY_LOG(trace, "********** ActiveMessage destructed ***********");
   connection_manager_.stats().request_active_.dec();
   request_timer_->complete();
+  if (method_stats_ != nullptr) {
+    method_stats_->request_time_ms_.recordValue(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            connection_manager_.timeSystem().monotonicTime() - stream_info_.startTimeMonotonic())
+            .count());
+  }
   for (auto& filter : decoder_filters_) {
     ENVOY_LOG(debug, "destroy decoder filter");
     filter->handler()->onDestroy();
@@ -270,12 +310,25 @@ ActiveMessage::commonDecodePrefix(ActiveMessageDecoderFilter* filter,
 
 void ActiveMessage::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedPtr mutation) {
   connection_manager_.stats().request_decoding_success_.inc();
+  connection_manager_.stats().request_size_bytes_.recordValue(metadata->originMessage().length());
   bool needApplyFilters = false;
+  metadata_ = metadata;
   switch (metadata->getMessageType()) {
   case MessageType::Request:
     needApplyFilters = true;
     break;
   case MessageType::Stream_Init:
+    if (connection_manager_.streamLimitReached()) {
+      ENVOY_LOG(debug, "meta protocol request: too many streams, reject stream {}",
+                metadata->getStreamId());
+      connection_manager_.stats().stream_overflow_.inc();
+      sendLocalReply(
+          AppException(Error{ErrorType::OverLimit,
+                             fmt::format("meta protocol: too many streams, stream id: {}",
+                                         metadata->getStreamId())}),
+          false);
+      break;
+    }
     needApplyFilters = true;
     connection_manager_.newActiveStream(metadata->getStreamId());
     break;
@@ -326,12 +379,16 @@ void ActiveMessage::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedP
                 metadata->getStreamId());
     }
     break;
-    // todo we need a timeout mechanism to remove a stream
   default:
     break;
   }
 
-  metadata_ = metadata;
+  auto* method_stats = connection_manager_.methodStats();
+  if (method_stats != nullptr && (metadata->getMessageType() == MessageType::Request ||
+                                  metadata->getMessageType() == MessageType::Oneway)) {
+    method_stats_ = method_stats->local().requested(MethodStats::rpc(*metadata));
+    method_stats_->request_.inc();
+  }
   // Apply filters for request/response RPC and the first message in a stream. Skip filters for all
   // the following messages in an existing stream
   if (needApplyFilters) {
@@ -339,7 +396,17 @@ void ActiveMessage::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedP
       return filter->onMessageDecoded(metadata, mutation);
     };
 
+    auto* phase_stats = connection_manager_.phaseStats();
+    const MonotonicTime filters_start = phase_stats != nullptr
+                                            ? connection_manager_.timeSystem().monotonicTime()
+                                            : MonotonicTime();
     auto status = applyDecoderFilters(nullptr, FilterIterationStartState::CanStartFromCurrent);
+    // Only the synchronous part of the filter chain is measured, a paused chain is continued by
+    // the filter that paused it.
+    if (phase_stats != nullptr) {
+      MetaProtocolProxyPhaseStats::recordSince(phase_stats->decoder_filters_us_, filters_start,
+                                               connection_manager_.timeSystem());
+    }
     switch (status) {
     case FilterStatus::PauseIteration:
       ENVOY_LOG(debug, "meta protocol {} request: pause calling decoder filters, id is {}",
@@ -368,7 +435,29 @@ void ActiveMessage::onMessageDecoded(MetadataSharedPtr metadata, MutationSharedP
 }
 
 void ActiveMessage::setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) {
-  connection_manager_.getActiveStream(metadata_->getStreamId()).setUpstreamConn(std::move(conn));
+  if (!connection_manager_.streamExisted(metadata_->getStreamId())) {
+    // The stream has timed out or the downstream has closed while connecting to the upstream.
+    ENVOY_LOG(debug, "meta protocol: stream {} has been closed, drop the upstream connection",
+              metadata_->getStreamId());
+    conn->connection().close(Network::ConnectionCloseType::NoFlush);
+    return;
+  }
+  Stream& stream = connection_manager_.getActiveStream(metadata_->getStreamId());
+  auto& multiplexer = connection_manager_.streamMultiplexer();
+  if (multiplexer.enabled()) {
+    multiplexer.add(stream, std::move(conn));
+    return;
+  }
+  stream.setUpstreamConn(std::move(conn));
+}
+
+Tcp::ConnectionPool::ConnectionData*
+ActiveMessage::sharedStreamConnection(const std::string& host) {
+  auto& multiplexer = connection_manager_.streamMultiplexer();
+  if (!multiplexer.enabled() || !connection_manager_.streamExisted(metadata_->getStreamId())) {
+    return nullptr;
+  }
+  return multiplexer.attach(connection_manager_.getActiveStream(metadata_->getStreamId()), host);
 }
 
 void ActiveMessage::maybeDeferredDeleteMessage() {
@@ -471,6 +560,9 @@ void ActiveMessage::sendLocalReply(const DirectResponse& response, bool end_stre
   ASSERT(metadata_);
   // metadata_->setRequestId(request_id_);
   connection_manager_.sendLocalReply(*metadata_, response, end_stream);
+  if (method_stats_ != nullptr) {
+    method_stats_->local_response_.inc();
+  }
 
   if (end_stream) {
     return;
@@ -486,10 +578,27 @@ void ActiveMessage::startUpstreamResponse(Metadata& requestMetadata) {
 
   CodecPtr codec = connection_manager_.config().createCodec();
 
+  auto* phase_stats = connection_manager_.phaseStats();
+  if (phase_stats != nullptr && upstream_request_sent_ != MonotonicTime()) {
+    MetaProtocolProxyPhaseStats::recordSince(phase_stats->upstream_first_byte_us_,
+                                             upstream_request_sent_,
+                                             connection_manager_.timeSystem());
+  }
+
   // Create a response message decoder.
   response_decoder_ = std::make_unique<ActiveResponseDecoder>(
-      *this, connection_manager_.stats(), connection_manager_.connection(),
-      connection_manager_.config().applicationProtocol(), std::move(codec), requestMetadata);
+      *this, connection_manager_.stats(), phase_stats, connection_manager_.timeSystem(),
+      connection_manager_.connection(), connection_manager_.config().applicationProtocol(),
+      std::move(codec), requestMetadata);
+}
+
+void ActiveMessage::onUpstreamRequestSent(std::chrono::microseconds connection_wait) {
+  auto* phase_stats = connection_manager_.phaseStats();
+  if (phase_stats == nullptr) {
+    return;
+  }
+  phase_stats->upstream_cx_acquire_us_.recordValue(connection_wait.count());
+  upstream_request_sent_ = connection_manager_.timeSystem().monotonicTime();
 }
 
 UpstreamResponseStatus ActiveMessage::upstreamData(Buffer::Instance& buffer) {
@@ -31,6 +31,7 @@ class ActiveResponseDecoder : public ResponseDecoderCallbacks,
                               Logger::Loggable<Logger::Id::filter> {
 public:
   ActiveResponseDecoder(ActiveMessage& parent, MetaProtocolProxyStats& stats,
+                        MetaProtocolProxyPhaseStats* phase_stats, TimeSource& time_source,
                         Network::Connection& connection, std::string applicationProtocol,
                         CodecPtr&& codec, Metadata& requestMetadata);
   ~ActiveResponseDecoder() override = default;
@@ -51,12 +52,15 @@ private:
 
   ActiveMessage& parent_;
   MetaProtocolProxyStats& stats_;
+  MetaProtocolProxyPhaseStats* phase_stats_;
+  TimeSource& time_source_;
   Network::Connection& downstream_connection_;
   std::string application_protocol_;
   CodecPtr codec_;
   Metadata& request_metadata_;
   ResponseDecoderPtr decoder_;
   MetadataSharedPtr metadata_;
+  MonotonicTime decode_start_;
   bool complete_ : 1;
   UpstreamResponseStatus response_status_;
 };
@@ -101,10 +105,12 @@ public:
   void continueDecoding() override;
   void sendLocalReply(const DirectResponse& response, bool end_stream) override;
   void startUpstreamResponse(Metadata& requestMetadata) override;
+  void onUpstreamRequestSent(std::chrono::microseconds connection_wait) override;
   UpstreamResponseStatus upstreamData(Buffer::Instance& buffer) override;
   void resetDownstreamConnection() override;
   CodecPtr createCodec() override;
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override;
+  Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string& host) override;
 
   DecoderFilterSharedPtr handler() { return handle_; }
 
@@ -176,12 +182,14 @@ public:
   Route::RouteConstSharedPtr route() override;
   void sendLocalReply(const DirectResponse& response, bool end_stream) override;
   void startUpstreamResponse(Metadata& requestMetadata) override;
+  void onUpstreamRequestSent(std::chrono::microseconds connection_wait) override;
   UpstreamResponseStatus upstreamData(Buffer::Instance& buffer) override;
   void resetDownstreamConnection() override;
   CodecPtr createCodec() override;
   Event::Dispatcher& dispatcher() override;
   void resetStream() override;
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override;
+  Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string& host) override;
 
   void createFilterChain();
   FilterStatus applyDecoderFilters(ActiveMessageDecoderFilter* filter,
@@ -203,6 +211,10 @@ private:
 
   MetadataSharedPtr metadata_;
   Stats::TimespanPtr request_timer_;
+  // The stats of the RPC of the request, only set if the per RPC stats are enabled.
+  MetaProtocolProxyMethodStatsSharedPtr method_stats_;
+  // When the request was sent upstream, only set if the phase stats are enabled.
+  MonotonicTime upstream_request_sent_;
   ActiveResponseDecoderPtr response_decoder_;
 
   absl::optional<Route::RouteConstSharedPtr> cached_route_;
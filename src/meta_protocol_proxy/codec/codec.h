@@ -6,6 +6,8 @@
 #include "envoy/common/optref.h"
 #include "envoy/common/pure.h"
 
+#include "absl/types/optional.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
@@ -145,6 +147,22 @@ public:
    */
   virtual DecodeStatus decode(Buffer::Instance& buffer, Metadata& metadata) PURE;
 
+  /*
+   * decodes only the framing of the protocol message: the message type, the request or stream id
+   * and the origin message. It's used for the stream messages and the mirrored responses, which
+   * are forwarded or dropped without being routed, a codec can override it to skip the properties
+   * and headers of the message.
+   *
+   * @param buffer the currently buffered data.
+   * @param metadata saves the framing of the current message.
+   * @return DecodeStatus::DONE if a complete message was successfully consumed,
+   * DecodeStatus::WaitForData if more data is required.
+   * @throws EnvoyException if the data is not valid for this protocol.
+   */
+  virtual DecodeStatus decodeFrame(Buffer::Instance& buffer, Metadata& metadata) {
+    return decode(buffer, metadata);
+  }
+
   /*
    * encodes the protocol message.
    *
@@ -166,6 +184,18 @@ public:
    * @throws EnvoyException if the metadata is not valid for this protocol.
    */
   virtual void onError(const Metadata& metadata, const Error& error, Buffer::Instance& buffer) PURE;
+
+  /*
+   * peeks the length of the next message from its frame header, without consuming or parsing the
+   * message. It's used to reject a message larger than the configured max message size before the
+   * message is buffered.
+   *
+   * @param buffer the currently buffered data.
+   * @return the length of the whole message, or absl::nullopt if the frame header hasn't been
+   * received yet, the codec is in the middle of a message or the protocol doesn't frame messages.
+   * @throws EnvoyException if the frame header is not valid for this protocol.
+   */
+  virtual absl::optional<uint64_t> frameLength(Buffer::Instance&) { return absl::nullopt; }
 };
 
 using CodecPtr = std::unique_ptr<Codec>;
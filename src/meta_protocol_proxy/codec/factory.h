@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -13,6 +14,11 @@ namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
+/**
+ * Creates the codecs of a configuration.
+ */
+using CodecFactoryCb = std::function<CodecPtr()>;
+
 /**
  * Implemented by each application protocol and registered via Registry::registerFactory or the
  * convenience class RegisterFactory.
@@ -28,6 +34,20 @@ public:
    */
   virtual CodecPtr createCodec(const Protobuf::Message& config) PURE;
 
+  /**
+   * Create the factory of the codecs of a configuration, it's called once when the configuration
+   * is loaded. A codec whose configuration is expensive to process overrides it to process the
+   * configuration once and share the result with all its codecs.
+   * @param config the configuration of the codecs.
+   * @return CodecFactoryCb the factory of the codecs.
+   * @throw EnvoyException if the configuration is invalid.
+   */
+  virtual CodecFactoryCb createCodecFactory(const Protobuf::Message& config) {
+    std::shared_ptr<Protobuf::Message> codec_config(config.New());
+    codec_config->CopyFrom(config);
+    return [this, codec_config]() { return createCodec(*codec_config); };
+  }
+
   std::string category() const override { return "aeraki.meta_protocol.codec"; }
 };
 
@@ -32,6 +32,7 @@ public:
   bool getBool(std::string key) const override;
   uint32_t getUint32(std::string key) const override;
   PropertiesImplPtr clone() const;
+  void clear() { map_.clear(); }
 
 private:
   std::map<std::string, std::any> map_;
@@ -87,6 +88,24 @@ public:
   };
   const Http::HeaderMap& getHeaders() const { return *headers_; }
 
+  /**
+   * Reset the metadata for the next message, so that a metadata can be reused across the messages
+   * of a connection. The header map is only allocated again if it has been used.
+   */
+  void reset() {
+    properties_->clear();
+    if (!headers_->empty()) {
+      headers_ = Http::RequestHeaderMapImpl::create();
+    }
+    origin_message_.drain(origin_message_.length());
+    message_type_ = MessageType::Request;
+    response_status_ = ResponseStatus::Ok;
+    request_id_ = 0;
+    stream_id_ = 0;
+    header_size_ = 0;
+    body_size_ = 0;
+  }
+
 private:
   PropertiesImplPtr properties_;
   Buffer::OwnedImpl origin_message_;
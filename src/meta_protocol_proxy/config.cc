@@ -60,15 +60,40 @@ ConfigImpl::ConfigImpl(const MetaProtocolProxyConfig& config,
       stats_prefix_(
           fmt::format("meta_protocol.{}.{}.", config.application_protocol(), config.stat_prefix())),
       stats_(MetaProtocolProxyStats::generateStats(stats_prefix_, context_.scope())),
-      application_protocol_(config.application_protocol()), codecConfig_(config.codec()),
+      max_message_size_(config.max_message_size()),
+      application_protocol_(config.application_protocol()),
       route_config_provider_manager_(route_config_provider_manager) {
   ENVOY_LOG(trace, "********** MetaProtocolProxy ConfigImpl constructor ***********");
+  if (config.phase_histograms()) {
+    phase_stats_ = std::make_unique<MetaProtocolProxyPhaseStats>(
+        MetaProtocolProxyPhaseStats::generateStats(stats_prefix_ + "phase.", context_.scope()));
+  }
+  if (config.has_method_stats()) {
+    method_stats_ = std::make_unique<MethodStats>(context_.threadLocal(), context_.scope(),
+                                                  stats_prefix_ + "method.", config.method_stats());
+  }
+  createCodecFactory(config.codec());
   // check idle_timer config
   if (config.has_idle_timeout()) {
     const uint64_t timeout = DurationUtil::durationToMilliseconds(config.idle_timeout());
     ENVOY_LOG(debug, "debug for idle_timeout-{}", timeout);
     idle_timeout_ = std::chrono::milliseconds(timeout);
   }
+  if (config.has_stream_limits()) {
+    const auto& stream_limits = config.stream_limits();
+    if (stream_limits.has_idle_timeout()) {
+      stream_limits_.idle_timeout_ = std::chrono::milliseconds(
+          DurationUtil::durationToMilliseconds(stream_limits.idle_timeout()));
+    }
+    if (stream_limits.has_max_duration()) {
+      stream_limits_.max_duration_ = std::chrono::milliseconds(
+          DurationUtil::durationToMilliseconds(stream_limits.max_duration()));
+    }
+    stream_limits_.max_streams_ = stream_limits.max_streams();
+    stream_limits_.buffer_limit_ = stream_limits.buffer_limit_bytes();
+    stream_limits_.max_streams_per_upstream_connection_ =
+        stream_limits.max_streams_per_upstream_connection();
+  }
 
   switch (config.route_specifier_case()) {
   case aeraki::meta_protocol_proxy::v1alpha::MetaProtocolProxy::RouteSpecifierCase::kRds:
@@ -115,13 +140,15 @@ Route::RouteConstSharedPtr ConfigImpl::route(const Metadata& metadata,
   // return route_matcher_->route(metadata, random_value);
 }
 
-CodecPtr ConfigImpl::createCodec() {
+void ConfigImpl::createCodecFactory(const CodecConfig& codec_config) {
+  // The codec configuration is translated once, an invalid one rejects the whole configuration
+  // instead of failing each connection.
   auto& factory = Envoy::Config::Utility::getAndCheckFactoryByName<NamedCodecConfigFactory>(
-      codecConfig_.name());
+      codec_config.name());
   ProtobufTypes::MessagePtr message = factory.createEmptyConfigProto();
-  Envoy::Config::Utility::translateOpaqueConfig(codecConfig_.config(),
+  Envoy::Config::Utility::translateOpaqueConfig(codec_config.config(),
                                                 context_.messageValidationVisitor(), *message);
-  return factory.createCodec(*message);
+  codec_factory_ = factory.createCodecFactory(*message);
 }
 
 void ConfigImpl::registerFilter(const MetaProtocolFilterConfig& proto_config) {
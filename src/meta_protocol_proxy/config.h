@@ -7,8 +7,10 @@
 
 #include "source/extensions/filters/network/common/factory_base.h"
 #include "source/extensions/filters/network/well_known_names.h"
+#include "src/meta_protocol_proxy/codec/factory.h"
 #include "src/meta_protocol_proxy/conn_manager.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/method_stats.h"
 #include "src/meta_protocol_proxy/route/route_config_provider_manager.h"
 
 namespace Envoy {
@@ -77,25 +79,34 @@ public:
 
   // Config
   MetaProtocolProxyStats& stats() override { return stats_; }
+  MetaProtocolProxyPhaseStats* phaseStats() override { return phase_stats_.get(); }
+  MethodStats* methodStats() override { return method_stats_.get(); }
+  uint32_t maxMessageSize() override { return max_message_size_; }
   FilterChainFactory& filterFactory() override { return *this; }
   Route::Config& routerConfig() override { return *this; }
-  CodecPtr createCodec() override;
+  CodecPtr createCodec() override { return codec_factory_(); }
   std::string applicationProtocol() override { return application_protocol_; };
   absl::optional<std::chrono::milliseconds> idleTimeout() override { return idle_timeout_; };
+  const StreamLimits& streamLimits() override { return stream_limits_; }
 
 private:
   void registerFilter(const MetaProtocolFilterConfig& proto_config);
+  void createCodecFactory(const CodecConfig& codec_config);
 
   Server::Configuration::FactoryContext& context_;
   const std::string stats_prefix_;
   MetaProtocolProxyStats stats_;
+  std::unique_ptr<MetaProtocolProxyPhaseStats> phase_stats_;
+  MethodStatsPtr method_stats_;
+  const uint32_t max_message_size_;
   // Router::RouteMatcherPtr route_matcher_;
   std::string application_protocol_;
-  CodecConfig codecConfig_;
+  CodecFactoryCb codec_factory_;
   std::list<FilterFactoryCb> filter_factories_;
   Route::RouteConfigProviderSharedPtr route_config_provider_;
   Route::RouteConfigProviderManager& route_config_provider_manager_;
   absl::optional<std::chrono::milliseconds> idle_timeout_;
+  StreamLimits stream_limits_;
 };
 
 } // namespace MetaProtocolProxy
@@ -18,8 +18,11 @@ constexpr uint32_t BufferLimit = UINT32_MAX;
 
 ConnectionManager::ConnectionManager(Config& config, Random::RandomGenerator& random_generator,
                                      TimeSource& time_system)
-    : config_(config), time_system_(time_system), stats_(config_.stats()),
-      random_generator_(random_generator), codec_(config.createCodec()),
+    : stream_multiplexer_(*this, config.streamLimits().max_streams_per_upstream_connection_),
+      config_(config), time_system_(time_system), stats_(config_.stats()),
+      phase_stats_(config_.phaseStats()), method_stats_(config_.methodStats()),
+      max_message_size_(config_.maxMessageSize()), random_generator_(random_generator),
+      codec_(config.createCodec()),
       decoder_(std::make_unique<RequestDecoder>(*codec_, *this)) {}
 
 Network::FilterStatus ConnectionManager::onData(Buffer::Instance& data, bool end_stream) {
@@ -33,6 +36,7 @@ Network::FilterStatus ConnectionManager::onData(Buffer::Instance& data, bool end
 
     resetAllMessages(false);
     clearStream();
+    downstream_write_batcher_->flush();
     read_callbacks_->connection().close(Network::ConnectionCloseType::FlushWrite);
   }
 
@@ -54,6 +58,11 @@ void ConnectionManager::initializeReadFilterCallbacks(Network::ReadFilterCallbac
   read_callbacks_->connection().addConnectionCallbacks(*this);
   read_callbacks_->connection().enableHalfClose(true);
   read_callbacks_->connection().setBufferLimits(BufferLimit);
+  downstream_write_batcher_ = std::make_unique<WriteBatcher>(read_callbacks_->connection());
+  if (phase_stats_ != nullptr) {
+    downstream_write_batcher_->recordQueueTime(phase_stats_->downstream_write_queue_us_,
+                                               time_system_);
+  }
 }
 
 void ConnectionManager::onEvent(Network::ConnectionEvent event) {
@@ -63,22 +72,44 @@ void ConnectionManager::onEvent(Network::ConnectionEvent event) {
   } else if (event == Network::ConnectionEvent::RemoteClose) {
     disableIdleTimer();
     resetAllMessages(false);
+  } else {
+    return;
   }
+  clearStream();
+  request_buffer_.drain(request_buffer_.length());
+  updateBufferedStats();
 }
 
 void ConnectionManager::onAboveWriteBufferHighWatermark() {
   ENVOY_CONN_LOG(debug, "onAboveWriteBufferHighWatermark", read_callbacks_->connection());
   read_callbacks_->connection().readDisable(true);
+  downstream_write_batcher_->onAboveWriteBufferHighWatermark();
+  downstream_above_high_watermark_ = true;
+  // The streams write to the downstream whatever the upstream sends, stop reading the upstreams.
+  for (auto& stream : active_stream_map_) {
+    stream.second->onDownstreamAboveHighWatermark();
+  }
 }
 
 void ConnectionManager::onBelowWriteBufferLowWatermark() {
   ENVOY_CONN_LOG(debug, "onBelowWriteBufferLowWatermark", read_callbacks_->connection());
   read_callbacks_->connection().readDisable(false);
+  downstream_write_batcher_->onBelowWriteBufferLowWatermark();
+  downstream_above_high_watermark_ = false;
+  for (auto& stream : active_stream_map_) {
+    stream.second->onDownstreamBelowLowWatermark();
+  }
 }
 
 MessageHandler& ConnectionManager::newMessageHandler() {
   ENVOY_LOG(debug, "meta protocol: create the new decoder event handler");
 
+  // The message handler is requested once the codec has decoded the message.
+  if (phase_stats_ != nullptr) {
+    MetaProtocolProxyPhaseStats::recordSince(phase_stats_->downstream_decode_us_, decode_start_,
+                                             time_system_);
+  }
+
   ActiveMessagePtr new_message(std::make_unique<ActiveMessage>(*this));
   new_message->createFilterChain();
   LinkedList::moveIntoList(std::move(new_message), active_message_list_);
@@ -96,7 +127,7 @@ bool ConnectionManager::onHeartbeat(MetadataSharedPtr metadata) {
   Buffer::OwnedImpl response_buffer;
 
   heartbeat.encode(*metadata, *codec_, response_buffer);
-  read_callbacks_->connection().write(response_buffer, false);
+  downstream_write_batcher_->write(response_buffer, false);
   return false;
 }
 
@@ -115,8 +146,22 @@ void ConnectionManager::dispatch() {
     // 2. all the messages in the buffer have been processed, in this case, the buffer is already
     // empty.
     while (!underflow) {
+      if (max_message_size_ > 0 && !checkMessageSize(false)) {
+        return;
+      }
+      if (phase_stats_ != nullptr) {
+        decode_start_ = time_system_.monotonicTime();
+      }
+      const uint64_t length = request_buffer_.length();
       decoder_->onData(request_buffer_, underflow);
+      partial_message_bytes_ =
+          decoder_->decoding() ? partial_message_bytes_ + length - request_buffer_.length() : 0;
+    }
+    // A message is waiting for more data.
+    if (max_message_size_ > 0 && !checkMessageSize(true)) {
+      return;
     }
+    updateBufferedStats();
     return;
   } catch (const EnvoyException& ex) {
     ENVOY_CONN_LOG(error, "meta protocol error: {}", read_callbacks_->connection(), ex.what());
@@ -126,6 +171,40 @@ void ConnectionManager::dispatch() {
   resetAllMessages(true);
 }
 
+bool ConnectionManager::checkMessageSize(bool partial) {
+  // The frame header is peeked before the message is parsed. The codecs which don't frame their
+  // messages are checked on the bytes they have consumed from the message being decoded, the
+  // buffer may hold the next messages as well.
+  const absl::optional<uint64_t> frame_length = codec_->frameLength(request_buffer_);
+  const uint64_t message_size = frame_length.value_or(partial ? partial_message_bytes_ : 0);
+  if (message_size <= max_message_size_) {
+    return true;
+  }
+
+  ENVOY_CONN_LOG(warn, "meta protocol: message size {} exceeds the max message size {}",
+                 read_callbacks_->connection(), message_size, max_message_size_);
+  stats_.request_too_large_.inc();
+  read_callbacks_->connection().close(Network::ConnectionCloseType::NoFlush);
+  resetAllMessages(true);
+  return false;
+}
+
+void ConnectionManager::updateBufferedStats() {
+  const uint64_t buffered_bytes = request_buffer_.length();
+  if (buffered_bytes > buffered_bytes_) {
+    stats_.request_buffered_bytes_.add(buffered_bytes - buffered_bytes_);
+  } else {
+    stats_.request_buffered_bytes_.sub(buffered_bytes_ - buffered_bytes);
+  }
+  buffered_bytes_ = buffered_bytes;
+
+  const bool partial_frame = buffered_bytes > 0;
+  if (partial_frame != partial_frame_) {
+    partial_frame ? stats_.request_partial_frame_.inc() : stats_.request_partial_frame_.dec();
+    partial_frame_ = partial_frame;
+  }
+}
+
 void ConnectionManager::sendLocalReply(Metadata& metadata, const DirectResponse& response,
                                        bool end_stream) {
   if (read_callbacks_->connection().state() != Network::Connection::State::Open) {
@@ -138,7 +217,7 @@ void ConnectionManager::sendLocalReply(Metadata& metadata, const DirectResponse&
     Buffer::OwnedImpl buffer;
     result = response.encode(metadata, *codec_, buffer);
 
-    read_callbacks_->connection().write(buffer, end_stream);
+    downstream_write_batcher_->write(buffer, end_stream);
   } catch (const EnvoyException& ex) {
     ENVOY_CONN_LOG(error, "meta protocol error: {}", read_callbacks_->connection(), ex.what());
   }
@@ -164,9 +243,18 @@ void ConnectionManager::sendLocalReply(Metadata& metadata, const DirectResponse&
 
 Stream& ConnectionManager::newActiveStream(uint64_t stream_id) {
   ENVOY_CONN_LOG(debug, "meta protocol: create an active stream: {}", connection(), stream_id);
-  StreamPtr new_stream(std::make_unique<Stream>(stream_id, connection(), *this, *codec_));
-  active_stream_map_[stream_id] = std::move(new_stream);
-  return *active_stream_map_.find(stream_id)->second;
+  auto iter = active_stream_map_.find(stream_id);
+  if (iter != active_stream_map_.end()) {
+    // The client reuses the id of a stream it has given up on.
+    iter->second->close(true);
+  }
+  StreamPtr new_stream(
+      std::make_unique<Stream>(stream_id, connection(), *this, config_.streamLimits()));
+  Stream& stream = *new_stream;
+  active_stream_map_.emplace(stream_id, std::move(new_stream));
+  stats_.stream_total_.inc();
+  stats_.stream_active_.inc();
+  return stream;
 }
 
 Stream& ConnectionManager::getActiveStream(uint64_t stream_id) {
@@ -182,7 +270,24 @@ bool ConnectionManager::streamExisted(uint64_t stream_id) {
 
 void ConnectionManager::closeStream(uint64_t stream_id) {
   ENVOY_LOG(debug, "meta protocol: close stream {} ", stream_id);
-  active_stream_map_.erase(stream_id);
+  auto iter = active_stream_map_.find(stream_id);
+  if (iter == active_stream_map_.end()) {
+    return;
+  }
+  stats_.stream_active_.dec();
+  read_callbacks_->connection().dispatcher().deferredDelete(std::move(iter->second));
+  active_stream_map_.erase(iter);
+}
+
+void ConnectionManager::clearStream() {
+  while (!active_stream_map_.empty()) {
+    active_stream_map_.begin()->second->close(true);
+  }
+}
+
+bool ConnectionManager::streamLimitReached() const {
+  const uint32_t max_streams = config_.streamLimits().max_streams_;
+  return max_streams > 0 && active_stream_map_.size() >= max_streams;
 }
 
 void ConnectionManager::deferredDeleteMessage(ActiveMessage& message) {
@@ -13,11 +13,16 @@
 #include "src/meta_protocol_proxy/decoder.h"
 #include "src/meta_protocol_proxy/decoder_event_handler.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/method_stats.h"
 #include "src/meta_protocol_proxy/stats.h"
 #include "src/meta_protocol_proxy/route/rds.h"
 #include "src/meta_protocol_proxy/stream.h"
+#include "src/meta_protocol_proxy/stream_multiplexer.h"
+#include "src/meta_protocol_proxy/write_batcher.h"
 #include "envoy/event/timer.h"
 
+#include "absl/container/flat_hash_map.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
@@ -32,10 +37,28 @@ public:
 
   virtual FilterChainFactory& filterFactory() PURE;
   virtual MetaProtocolProxyStats& stats() PURE;
+  /**
+   * @return MetaProtocolProxyPhaseStats* the request phase histograms, or nullptr if they're
+   *         disabled.
+   */
+  virtual MetaProtocolProxyPhaseStats* phaseStats() PURE;
+  /**
+   * @return MethodStats* the per RPC stats, or nullptr if they're disabled.
+   */
+  virtual MethodStats* methodStats() PURE;
+  /**
+   * @return uint32_t the maximum size of a request message, or 0 if there is no limit.
+   */
+  virtual uint32_t maxMessageSize() PURE;
   virtual CodecPtr createCodec() PURE;
   virtual Route::Config& routerConfig() PURE;
   virtual std::string applicationProtocol() PURE;
   virtual absl::optional<std::chrono::milliseconds> idleTimeout() PURE;
+  /**
+   * @return const StreamLimits& the timeouts, the maximum number, the buffer limit and the
+   *         upstream connection sharing of the streams of a connection.
+   */
+  virtual const StreamLimits& streamLimits() PURE;
   /**
    * @return Route::RouteConfigProvider* the configuration provider used to acquire a route
    *         config for each request flow. Pointer ownership is _not_ transferred to the caller of
@@ -71,10 +94,15 @@ public:
   bool onHeartbeat(MetadataSharedPtr metadata) override;
 
   MetaProtocolProxyStats& stats() const { return stats_; }
+  MetaProtocolProxyPhaseStats* phaseStats() const { return phase_stats_; }
+  MethodStats* methodStats() const { return method_stats_; }
   Network::Connection& connection() const { return read_callbacks_->connection(); }
   TimeSource& timeSystem() const { return time_system_; }
   Random::RandomGenerator& randomGenerator() const { return random_generator_; }
   Config& config() const { return config_; }
+  WriteBatcher& downstreamWriteBatcher() const { return *downstream_write_batcher_; }
+  bool downstreamAboveHighWatermark() const { return downstream_above_high_watermark_; }
+  StreamMultiplexer& streamMultiplexer() { return stream_multiplexer_; }
 
   void deferredDeleteMessage(ActiveMessage& message);
   void sendLocalReply(Metadata& metadata, const DirectResponse& response, bool end_stream);
@@ -82,8 +110,11 @@ public:
   Stream& newActiveStream(uint64_t stream_id);
   Stream& getActiveStream(uint64_t stream_id);
   bool streamExisted(uint64_t stream_id);
+  // Removes a stream from the stream table, the stream is deleted at the end of the event loop
+  // iteration since it may be in the middle of a callback.
   void closeStream(uint64_t stream_id);
-  void clearStream() { active_stream_map_.clear(); }
+  void clearStream();
+  bool streamLimitReached() const;
 
   // This function is for testing only.
   std::list<ActiveMessagePtr>& getActiveMessagesForTest() { return active_message_list_; }
@@ -91,6 +122,10 @@ public:
 private:
   void dispatch();
   void resetAllMessages(bool local_reset);
+  // Closes the connection when the next message is larger than the max message size.
+  bool checkMessageSize(bool partial);
+  // Reports the bytes and the partial message buffered by the connection.
+  void updateBufferedStats();
 
   // This function is to deal with idle downstream's connection timeout.
   void onIdleTimeout();
@@ -101,16 +136,31 @@ private:
 
   Buffer::OwnedImpl request_buffer_;
   std::list<ActiveMessagePtr> active_message_list_;
-  std::map<uint64_t, StreamPtr> active_stream_map_;
+  absl::flat_hash_map<uint64_t, StreamPtr> active_stream_map_;
+  StreamMultiplexer stream_multiplexer_;
 
   Config& config_;
   TimeSource& time_system_;
   MetaProtocolProxyStats& stats_;
+  MetaProtocolProxyPhaseStats* phase_stats_;
+  MethodStats* method_stats_;
+  const uint64_t max_message_size_;
   Random::RandomGenerator& random_generator_;
 
   CodecPtr codec_;
   RequestDecoderPtr decoder_;
   Network::ReadFilterCallbacks* read_callbacks_{};
+  // Output queue of the downstream connection. The responses, heartbeats and local replies
+  // completed in the same dispatcher iteration are written to the downstream at once.
+  std::unique_ptr<WriteBatcher> downstream_write_batcher_;
+  // The start of the decoding of the current request, only set if the phase stats are enabled.
+  MonotonicTime decode_start_;
+  // The buffered bytes and partial message last added to the gauges.
+  uint64_t buffered_bytes_{};
+  bool partial_frame_{};
+  // The bytes the codec has consumed from the message it is decoding.
+  uint64_t partial_message_bytes_{};
+  bool downstream_above_high_watermark_{};
   // timer for idle timeout
   Event::TimerPtr idle_timer_;
 };
@@ -126,6 +126,11 @@ public:
   // if there is a state of the need to provide the reset interface call here.
   void reset();
 
+  /**
+   * @return bool whether a message is being decoded, waiting for more data.
+   */
+  bool decoding() const { return decode_started_; }
+
 protected:
   void start();
   void complete();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -138,6 +139,13 @@ public:
    */
   virtual void startUpstreamResponse(Metadata& requestMetadata) PURE;
 
+  /**
+   * Indicates that the request is being sent upstream, the wait for the first byte of the response
+   * starts now.
+   * @param connection_wait the time the filter waited for the upstream connection.
+   */
+  virtual void onUpstreamRequestSent(std::chrono::microseconds connection_wait) PURE;
+
   /**
    * Called with upstream response data.
    * @param data supplies the upstream's data
@@ -157,6 +165,15 @@ public:
    * @param conn supplies the upstream's connection
    */
   virtual void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) PURE;
+
+  /**
+   * Attach the streaming RPC to an upstream connection it can share with other streams, used by
+   * router before it acquires a connection from the pool.
+   * @param host supplies the address of the upstream host.
+   * @return Tcp::ConnectionPool::ConnectionData* the connection to send the stream init message
+   *         to, or nullptr if the stream needs a connection from the pool.
+   */
+  virtual Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string& host) PURE;
 };
 
 /**
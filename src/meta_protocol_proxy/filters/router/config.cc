@@ -3,7 +3,6 @@
 #include "envoy/registry/registry.h"
 
 #include "src/meta_protocol_proxy/filters/router/router_impl.h"
-#include "src/meta_protocol_proxy/filters/router/shadow_writer_impl.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -12,19 +11,17 @@ namespace MetaProtocolProxy {
 namespace Router {
 
 FilterFactoryCb RouterFilterConfig::createFilterFactoryFromProtoTyped(
-    const aeraki::meta_protocol_proxy::filters::router::v1alpha::Router&, const std::string&,
-    Server::Configuration::FactoryContext& context) {
-
-  auto shadow_writer = std::make_shared<ShadowWriterImpl>(
-      context.clusterManager(), context.mainThreadDispatcher(), context.threadLocal());
-
-  // This lambda captures the shadow_writer created above, thus shadowed requests won't be
-  // destructed after the main request is finished.
-  // The life span of shadow_writer is as long as the MetaProtocol ConfigImpl, see filter_factories_
-  // member of the MetaProtocol ConfigImpl
-  return [&context, shadow_writer](FilterChainFactoryCallbacks& callbacks) -> void {
-    callbacks.addFilter(
-        std::make_shared<Router>(context.clusterManager(), context.runtime(), *shadow_writer));
+    const aeraki::meta_protocol_proxy::filters::router::v1alpha::Router& proto_config,
+    const std::string& stat_prefix, Server::Configuration::FactoryContext& context) {
+
+  // The config lives as long as the filter factory, so do the shadow writer and the thread local
+  // objects it owns. This lambda captures the config, thus shadowed requests won't be destructed
+  // after the main request is finished.
+  // The life span of the filter factory is as long as the MetaProtocol ConfigImpl, see
+  // filter_factories_ member of the MetaProtocol ConfigImpl
+  auto config = std::make_shared<RouterConfig>(proto_config, stat_prefix, context);
+  return [config](FilterChainFactoryCallbacks& callbacks) -> void {
+    callbacks.addFilter(std::make_shared<Router>(*config));
   };
 }
 
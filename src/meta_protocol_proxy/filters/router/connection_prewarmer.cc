@@ -0,0 +1,344 @@
+#include "src/meta_protocol_proxy/filters/router/connection_prewarmer.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+namespace {
+
+uint32_t hostCount(Upstream::ThreadLocalCluster& cluster) {
+  uint32_t host_count = 0;
+  for (const auto& host_set : cluster.prioritySet().hostSetsPerPriority()) {
+    host_count += host_set->hosts().size();
+  }
+  return host_count;
+}
+
+} // namespace
+
+// class ClusterPrewarmer
+ClusterPrewarmer::~ClusterPrewarmer() {
+  for (auto& pending : pending_connections_) {
+    if (pending->handle_ != nullptr) {
+      pending->handle_->cancel(Tcp::ConnectionPool::CancelPolicy::Default);
+      pending->handle_ = nullptr;
+    }
+  }
+}
+
+void ClusterPrewarmer::add(Upstream::HostConstSharedPtr host, uint32_t connections,
+                           uint32_t ready) {
+  auto& missing = missing_connections_[host.get()];
+  missing.missing_ += connections;
+  missing.reusable_ += ready;
+  missing_ += connections;
+  hosts_.emplace_back(std::move(host), connections);
+}
+
+void ClusterPrewarmer::start() {
+  // A synchronous pool callback must not complete the prewarmer while the connections are being
+  // requested, the start itself is settled last.
+  unsettled_ = 1;
+  requestConnections();
+  onConnectionSettled();
+}
+
+void ClusterPrewarmer::requestConnections() {
+  // A connection handed out again from within the loop is requested again by the loop.
+  if (requesting_) {
+    return;
+  }
+  auto* cluster = parent_.clusterManager().getThreadLocalCluster(cluster_name_);
+  if (cluster == nullptr) {
+    parent_.stats().upstream_cx_prewarm_failure_.inc(missing_);
+    missing_ = 0;
+    return;
+  }
+
+  requesting_ = true;
+  // Every pick either opens a connection or is a miss, the misses are bounded so that a load
+  // balancer which keeps picking other hosts doesn't loop forever.
+  uint32_t misses = 0;
+  while (missing_ > 0 && misses < missing_) {
+    auto conn_pool_data = cluster->tcpConnPool(Upstream::ResourcePriority::Default, this);
+    if (!conn_pool_data) {
+      ENVOY_LOG(debug, "meta protocol router: no connection pool to prewarm cluster {}",
+                cluster_name_);
+      parent_.stats().upstream_cx_prewarm_failure_.inc(missing_);
+      missing_ = 0;
+      break;
+    }
+    auto iter = missing_connections_.find(conn_pool_data->host().get());
+    if (iter == missing_connections_.end() || iter->second.missing_ == 0) {
+      parent_.stats().upstream_cx_prewarm_miss_.inc();
+      misses++;
+      continue;
+    }
+
+    iter->second.missing_--;
+    missing_--;
+    unsettled_++;
+    pending_connections_.emplace_back(std::make_unique<PendingConnection>(*this));
+    auto& pending = *pending_connections_.back();
+    pending.handle_ = conn_pool_data->newConnection(pending);
+  }
+  requesting_ = false;
+  if (missing_ > 0) {
+    ENVOY_LOG(debug, "meta protocol router: {} connections of cluster {} not prewarmed", missing_,
+              cluster_name_);
+  }
+}
+
+void ClusterPrewarmer::onConnectionReused(const Upstream::HostDescription& host) {
+  // The pool has as many idle connections to hand out again as the host has prewarmed ones,
+  // they are held so that the pool opens a new connection next.
+  auto iter = missing_connections_.find(&host);
+  if (iter == missing_connections_.end() || iter->second.reusable_ == 0) {
+    return;
+  }
+  iter->second.reusable_--;
+  iter->second.missing_++;
+  missing_++;
+  requestConnections();
+}
+
+void ClusterPrewarmer::PendingConnection::onPoolFailure(
+    ConnectionPool::PoolFailureReason reason, absl::string_view,
+    Upstream::HostDescriptionConstSharedPtr host) {
+  handle_ = nullptr;
+  ENVOY_LOG(debug, "meta protocol router: failed to prewarm host {}, reason {}",
+            host != nullptr ? host->address()->asString() : "", static_cast<int>(reason));
+  parent_.parent_.stats().upstream_cx_prewarm_failure_.inc();
+  parent_.onConnectionSettled();
+}
+
+void ClusterPrewarmer::PendingConnection::onPoolReady(
+    Tcp::ConnectionPool::ConnectionDataPtr&& conn, Upstream::HostDescriptionConstSharedPtr host) {
+  handle_ = nullptr;
+  Network::Connection& connection = conn->connection();
+  parent_.ready_connections_.push_back(std::move(conn));
+  if (parent_.parent_.watch(parent_.cluster_name_, host, connection)) {
+    parent_.created_.inc();
+  } else {
+    parent_.onConnectionReused(*host);
+  }
+  parent_.onConnectionSettled();
+}
+
+void ClusterPrewarmer::onConnectionSettled() {
+  ASSERT(unsettled_ > 0);
+  if (--unsettled_ > 0) {
+    return;
+  }
+
+  ENVOY_LOG(debug, "meta protocol router: prewarmed {} connections to cluster {}",
+            ready_connections_.size(), cluster_name_);
+  // Releasing the connection data returns the connections to the pool.
+  ready_connections_.clear();
+  parent_.remove(*this);
+}
+
+// class PrewarmedConnection
+PrewarmedConnection::PrewarmedConnection(ThreadLocalConnectionPrewarmer& parent,
+                                         const std::string& cluster_name,
+                                         Upstream::HostDescriptionConstSharedPtr host,
+                                         Network::Connection& connection)
+    : parent_(parent), cluster_name_(cluster_name), host_(std::move(host)),
+      connection_(&connection) {
+  connection_->addConnectionCallbacks(*this);
+}
+
+PrewarmedConnection::~PrewarmedConnection() {
+  if (connection_ != nullptr) {
+    connection_->removeConnectionCallbacks(*this);
+  }
+}
+
+void PrewarmedConnection::onEvent(Network::ConnectionEvent event) {
+  if (event != Network::ConnectionEvent::RemoteClose &&
+      event != Network::ConnectionEvent::LocalClose) {
+    return;
+  }
+  // The connection is going away, its callbacks are dropped with it.
+  const Network::Connection& connection = *connection_;
+  connection_ = nullptr;
+  parent_.onConnectionClosed(connection, cluster_name_, host_);
+}
+
+// class ThreadLocalConnectionPrewarmer
+ThreadLocalConnectionPrewarmer::ThreadLocalConnectionPrewarmer(
+    Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
+    const ConnectionPrewarmConfig& config, RouterStats& stats)
+    : cm_(cm), dispatcher_(dispatcher),
+      clusters_(config.clusters().begin(), config.clusters().end()),
+      min_ready_connections_(config.min_ready_connections()), stats_(stats),
+      replenish_callback_(dispatcher.createSchedulableCallback([this]() { replenish(); })) {
+  cluster_update_handle_ = cm_.addThreadLocalClusterUpdateCallbacks(*this);
+  // The callbacks only tell the clusters added from now on.
+  for (const auto& cluster_name : clusters_) {
+    auto* cluster = cm_.getThreadLocalCluster(cluster_name);
+    if (cluster != nullptr) {
+      onClusterAddOrUpdate(*cluster);
+    }
+  }
+}
+
+ThreadLocalConnectionPrewarmer::~ThreadLocalConnectionPrewarmer() {
+  ENVOY_LOG(trace, "********** ThreadLocalConnectionPrewarmer destructed ***********");
+  member_update_handles_.clear();
+  prewarmers_.clear();
+  connections_.clear();
+}
+
+void ThreadLocalConnectionPrewarmer::onClusterAddOrUpdate(Upstream::ThreadLocalCluster& cluster) {
+  const std::string& cluster_name = cluster.info()->name();
+  if (!clusters_.contains(cluster_name)) {
+    return;
+  }
+
+  member_update_handles_[cluster_name] = cluster.prioritySet().addMemberUpdateCb(
+      [this, &cluster](const Upstream::HostVector& hosts_added,
+                       const Upstream::HostVector& hosts_removed) {
+        auto iter = hosts_.find(cluster.info()->name());
+        if (iter != hosts_.end()) {
+          for (const auto& host : hosts_removed) {
+            iter->second.erase(host.get());
+          }
+        }
+        prewarm(cluster, hosts_added, stats_.upstream_cx_prewarm_);
+      });
+
+  // The hosts which are prewarmed already are skipped.
+  Upstream::HostVector hosts;
+  for (const auto& host_set : cluster.prioritySet().hostSetsPerPriority()) {
+    hosts.insert(hosts.end(), host_set->hosts().begin(), host_set->hosts().end());
+  }
+  prewarm(cluster, hosts, stats_.upstream_cx_prewarm_);
+}
+
+void ThreadLocalConnectionPrewarmer::onClusterRemoval(const std::string& cluster_name) {
+  member_update_handles_.erase(cluster_name);
+  hosts_.erase(cluster_name);
+  replenished_clusters_.erase(cluster_name);
+}
+
+void ThreadLocalConnectionPrewarmer::prewarm(Upstream::ThreadLocalCluster& cluster,
+                                             const Upstream::HostVector& hosts,
+                                             Stats::Counter& created) {
+  const std::string& cluster_name = cluster.info()->name();
+  auto prewarmer =
+      std::make_unique<ClusterPrewarmer>(*this, cluster_name, hostCount(cluster), created);
+  auto& prewarmed_hosts = hosts_[cluster_name];
+  bool empty = true;
+  for (const auto& host : hosts) {
+    if (host->health() == Upstream::Host::Health::Unhealthy) {
+      continue;
+    }
+    auto& prewarmed = prewarmed_hosts[host.get()];
+    const uint32_t connections = prewarmed.ready_ + prewarmed.pending_;
+    if (connections >= min_ready_connections_) {
+      continue;
+    }
+    ENVOY_LOG(debug, "meta protocol router: prewarm {} connections to host {} of cluster {}",
+              min_ready_connections_ - connections, host->address()->asString(), cluster_name);
+    prewarmed.pending_ += min_ready_connections_ - connections;
+    prewarmer->add(host, min_ready_connections_ - connections, prewarmed.ready_);
+    empty = false;
+  }
+  if (empty) {
+    return;
+  }
+  LinkedList::moveIntoList(std::move(prewarmer), prewarmers_);
+  prewarmers_.front()->start();
+}
+
+void ThreadLocalConnectionPrewarmer::remove(ClusterPrewarmer& prewarmer) {
+  // The connections it didn't open are missing again.
+  auto iter = hosts_.find(prewarmer.clusterName());
+  if (iter != hosts_.end()) {
+    for (const auto& host : prewarmer.hosts()) {
+      auto prewarmed = iter->second.find(host.first.get());
+      if (prewarmed != iter->second.end()) {
+        ASSERT(prewarmed->second.pending_ >= host.second);
+        prewarmed->second.pending_ -= host.second;
+      }
+    }
+  }
+  dispatcher_.deferredDelete(prewarmer.removeFromList(prewarmers_));
+}
+
+bool ThreadLocalConnectionPrewarmer::watch(const std::string& cluster_name,
+                                           Upstream::HostDescriptionConstSharedPtr host,
+                                           Network::Connection& connection) {
+  auto& watched = connections_[&connection];
+  if (watched != nullptr) {
+    return false;
+  }
+  auto iter = hosts_.find(cluster_name);
+  if (iter != hosts_.end()) {
+    auto prewarmed = iter->second.find(host.get());
+    if (prewarmed != iter->second.end()) {
+      prewarmed->second.ready_++;
+    }
+  }
+  watched = std::make_unique<PrewarmedConnection>(*this, cluster_name, std::move(host), connection);
+  return true;
+}
+
+void ThreadLocalConnectionPrewarmer::onConnectionClosed(
+    const Network::Connection& connection, const std::string& cluster_name,
+    const Upstream::HostDescriptionConstSharedPtr& host) {
+  auto iter = hosts_.find(cluster_name);
+  if (iter != hosts_.end()) {
+    auto prewarmed = iter->second.find(host.get());
+    if (prewarmed != iter->second.end()) {
+      ASSERT(prewarmed->second.ready_ > 0);
+      prewarmed->second.ready_--;
+      replenished_clusters_.insert(cluster_name);
+      replenish_callback_->scheduleCallbackNextIteration();
+    }
+  }
+
+  // The watcher is still running.
+  auto connection_iter = connections_.find(&connection);
+  ASSERT(connection_iter != connections_.end());
+  dispatcher_.deferredDelete(std::move(connection_iter->second));
+  connections_.erase(connection_iter);
+}
+
+void ThreadLocalConnectionPrewarmer::replenish() {
+  absl::flat_hash_set<std::string> clusters;
+  clusters.swap(replenished_clusters_);
+  for (const auto& cluster_name : clusters) {
+    auto* cluster = cm_.getThreadLocalCluster(cluster_name);
+    if (cluster == nullptr) {
+      continue;
+    }
+
+    // Only the hosts which are still healthy members of the cluster get their connections back.
+    Upstream::HostVector hosts;
+    for (const auto& host_set : cluster->prioritySet().hostSetsPerPriority()) {
+      hosts.insert(hosts.end(), host_set->hosts().begin(), host_set->hosts().end());
+    }
+    prewarm(*cluster, hosts, stats_.upstream_cx_prewarm_replenish_);
+  }
+}
+
+// class ConnectionPrewarmer
+ConnectionPrewarmer::ConnectionPrewarmer(Upstream::ClusterManager& cm,
+                                         ThreadLocal::SlotAllocator& tls,
+                                         const ConnectionPrewarmConfig& config, RouterStats& stats)
+    : tls_(tls.allocateSlot()) {
+  tls_->set([&cm, config, &stats](Event::Dispatcher& dispatcher)
+                -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalConnectionPrewarmer>(cm, dispatcher, config, stats);
+  });
+}
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/common/callback.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/dispatcher.h"
+#include "envoy/event/schedulable_cb.h"
+#include "envoy/network/connection.h"
+#include "envoy/tcp/conn_pool.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/cluster_manager.h"
+#include "envoy/upstream/thread_local_cluster.h"
+
+#include "source/common/common/linked_object.h"
+#include "source/common/common/logger.h"
+#include "source/common/upstream/load_balancer_impl.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "api/meta_protocol_proxy/filters/router/v1alpha/router.pb.h"
+#include "src/meta_protocol_proxy/filters/router/stats.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+using ConnectionPrewarmConfig =
+    aeraki::meta_protocol_proxy::filters::router::v1alpha::ConnectionPrewarm;
+
+class ThreadLocalConnectionPrewarmer;
+
+/**
+ * ClusterPrewarmer opens a number of connections to some hosts of a cluster through the cluster's
+ * tcp connection pools. The pools are picked by the load balancer, which is asked to pick again
+ * the hosts which have their connections already, a pick which still lands on such a host is a
+ * miss. The connections are held until all of them are settled, so that they are distinct, and
+ * are then handed back to the pools where they wait for the requests. A pool hands out its idle
+ * connections first, a prewarmed connection handed out again is held as well and another one is
+ * requested in its place.
+ */
+class ClusterPrewarmer : public Upstream::LoadBalancerContextBase,
+                         public Event::DeferredDeletable,
+                         public LinkedObject<ClusterPrewarmer>,
+                         Logger::Loggable<Logger::Id::filter> {
+public:
+  ClusterPrewarmer(ThreadLocalConnectionPrewarmer& parent, const std::string& cluster_name,
+                   uint32_t host_count, Stats::Counter& created)
+      : parent_(parent), cluster_name_(cluster_name), host_count_(host_count), created_(created) {}
+  ~ClusterPrewarmer() override;
+
+  /**
+   * Add connections to open to a host.
+   * @param connections supplies the number of connections to open.
+   * @param ready supplies the number of prewarmed connections the host has already, which its
+   *        pool may hand out again.
+   */
+  void add(Upstream::HostConstSharedPtr host, uint32_t connections, uint32_t ready);
+
+  /**
+   * Open the connections.
+   */
+  void start();
+
+  const std::string& clusterName() const { return cluster_name_; }
+
+  /**
+   * @return the connections added to open, by host.
+   */
+  const std::vector<std::pair<Upstream::HostConstSharedPtr, uint32_t>>& hosts() const {
+    return hosts_;
+  }
+
+  // Upstream::LoadBalancerContextBase
+  // Any host which misses connections is fine, so a single round of the host list is enough for
+  // the load balancer to find one.
+  bool shouldSelectAnotherHost(const Upstream::Host& host) override {
+    return missingConnections(host) == 0;
+  }
+  uint32_t hostSelectionRetryCount() const override { return host_count_; }
+
+private:
+  struct PendingConnection : public Tcp::ConnectionPool::Callbacks {
+    PendingConnection(ClusterPrewarmer& parent) : parent_(parent) {}
+
+    // Tcp::ConnectionPool::Callbacks
+    void onPoolFailure(ConnectionPool::PoolFailureReason reason, absl::string_view,
+                       Upstream::HostDescriptionConstSharedPtr host) override;
+    void onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn,
+                     Upstream::HostDescriptionConstSharedPtr host) override;
+
+    ClusterPrewarmer& parent_;
+    Tcp::ConnectionPool::Cancellable* handle_{};
+  };
+
+  struct MissingConnections {
+    // The connections still to open.
+    uint32_t missing_{};
+    // The prewarmed connections the pool may still hand out again.
+    uint32_t reusable_{};
+  };
+
+  uint32_t missingConnections(const Upstream::HostDescription& host) const {
+    auto iter = missing_connections_.find(&host);
+    return iter != missing_connections_.end() ? iter->second.missing_ : 0;
+  }
+  void requestConnections();
+  void onConnectionReused(const Upstream::HostDescription& host);
+  void onConnectionSettled();
+
+  ThreadLocalConnectionPrewarmer& parent_;
+  const std::string cluster_name_;
+  const uint32_t host_count_;
+  Stats::Counter& created_;
+  absl::flat_hash_map<const Upstream::HostDescription*, MissingConnections> missing_connections_;
+  std::vector<std::pair<Upstream::HostConstSharedPtr, uint32_t>> hosts_;
+  std::vector<std::unique_ptr<PendingConnection>> pending_connections_;
+  std::vector<Tcp::ConnectionPool::ConnectionDataPtr> ready_connections_;
+  uint32_t missing_{};
+  uint32_t unsettled_{};
+  bool requesting_{};
+};
+
+using ClusterPrewarmerPtr = std::unique_ptr<ClusterPrewarmer>;
+
+/**
+ * PrewarmedConnection watches a prewarmed connection once it is back in the pool, so that another
+ * one is opened to the host when it closes.
+ */
+class PrewarmedConnection : public Network::ConnectionCallbacks, public Event::DeferredDeletable {
+public:
+  PrewarmedConnection(ThreadLocalConnectionPrewarmer& parent, const std::string& cluster_name,
+                      Upstream::HostDescriptionConstSharedPtr host,
+                      Network::Connection& connection);
+  ~PrewarmedConnection() override;
+
+  // Network::ConnectionCallbacks
+  void onEvent(Network::ConnectionEvent event) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+private:
+  ThreadLocalConnectionPrewarmer& parent_;
+  const std::string cluster_name_;
+  Upstream::HostDescriptionConstSharedPtr host_;
+  Network::Connection* connection_;
+};
+
+using PrewarmedConnectionPtr = std::unique_ptr<PrewarmedConnection>;
+
+/**
+ * ThreadLocalConnectionPrewarmer watches the prewarmed clusters on a worker, it keeps the
+ * configured number of connections open to every healthy host of them. It counts the connections
+ * of each host which are open or being opened, and only opens the missing ones when a host is
+ * added or a prewarmed connection closes.
+ */
+class ThreadLocalConnectionPrewarmer : public ThreadLocal::ThreadLocalObject,
+                                       public Upstream::ClusterUpdateCallbacks,
+                                       Logger::Loggable<Logger::Id::filter> {
+public:
+  ThreadLocalConnectionPrewarmer(Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
+                                 const ConnectionPrewarmConfig& config, RouterStats& stats);
+  ~ThreadLocalConnectionPrewarmer() override;
+
+  // Upstream::ClusterUpdateCallbacks
+  void onClusterAddOrUpdate(Upstream::ThreadLocalCluster& cluster) override;
+  void onClusterRemoval(const std::string& cluster_name) override;
+
+  void remove(ClusterPrewarmer& prewarmer);
+  /**
+   * Watch a connection handed out to a prewarmer.
+   * @return true if the connection is a new one, false if it is prewarmed already.
+   */
+  bool watch(const std::string& cluster_name, Upstream::HostDescriptionConstSharedPtr host,
+             Network::Connection& connection);
+  void onConnectionClosed(const Network::Connection& connection, const std::string& cluster_name,
+                          const Upstream::HostDescriptionConstSharedPtr& host);
+  Upstream::ClusterManager& clusterManager() { return cm_; }
+  RouterStats& stats() { return stats_; }
+
+private:
+  struct PrewarmedHost {
+    // The prewarmed connections which are open.
+    uint32_t ready_{};
+    // The connections being opened.
+    uint32_t pending_{};
+  };
+
+  using PrewarmedHosts = absl::flat_hash_map<const Upstream::HostDescription*, PrewarmedHost>;
+
+  void prewarm(Upstream::ThreadLocalCluster& cluster, const Upstream::HostVector& hosts,
+               Stats::Counter& created);
+  void replenish();
+
+  Upstream::ClusterManager& cm_;
+  Event::Dispatcher& dispatcher_;
+  const absl::flat_hash_set<std::string> clusters_;
+  const uint32_t min_ready_connections_;
+  RouterStats& stats_;
+  Upstream::ClusterUpdateCallbacksHandlePtr cluster_update_handle_;
+  absl::flat_hash_map<std::string, Common::CallbackHandlePtr> member_update_handles_;
+  std::list<ClusterPrewarmerPtr> prewarmers_;
+  // The pool may hand out a prewarmed connection again, it's only watched once.
+  absl::flat_hash_map<const Network::Connection*, PrewarmedConnectionPtr> connections_;
+  // The prewarmed hosts, by cluster.
+  absl::flat_hash_map<std::string, PrewarmedHosts> hosts_;
+  // The clusters which lost prewarmed connections. They are opened again on the next iteration of
+  // the event loop rather than from the close event of the connection pool.
+  absl::flat_hash_set<std::string> replenished_clusters_;
+  Event::SchedulableCallbackPtr replenish_callback_;
+};
+
+/**
+ * ConnectionPrewarmer is shared by all the workers, each worker prewarms its own connection pools.
+ */
+class ConnectionPrewarmer : Logger::Loggable<Logger::Id::filter> {
+public:
+  ConnectionPrewarmer(Upstream::ClusterManager& cm, ThreadLocal::SlotAllocator& tls,
+                      const ConnectionPrewarmConfig& config, RouterStats& stats);
+
+private:
+  ThreadLocal::SlotPtr tls_;
+};
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
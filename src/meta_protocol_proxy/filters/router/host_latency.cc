@@ -0,0 +1,95 @@
+#include "src/meta_protocol_proxy/filters/router/host_latency.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+namespace {
+
+constexpr double DefaultEwmaWeight = 0.2;
+constexpr double DefaultSlowHostFactor = 3.0;
+constexpr uint32_t DefaultMinHosts = 3;
+// The median of a cluster is refreshed after this number of samples.
+constexpr uint32_t MedianUpdateInterval = 100;
+
+} // namespace
+
+ThreadLocalHostLatency::ThreadLocalHostLatency(const LatencyOutlierConfig& config)
+    : ewma_weight_(config.ewma_weight() > 0 ? config.ewma_weight() : DefaultEwmaWeight),
+      slow_host_factor_(config.slow_host_factor() > 0 ? config.slow_host_factor()
+                                                      : DefaultSlowHostFactor),
+      min_hosts_(config.min_hosts() > 0 ? config.min_hosts() : DefaultMinHosts) {}
+
+void ThreadLocalHostLatency::record(const Upstream::HostDescriptionConstSharedPtr& host,
+                                    std::chrono::microseconds latency) {
+  auto& cluster = clusters_[host->cluster().name()];
+  auto& entry = cluster.hosts_[host.get()];
+  const double sample = static_cast<double>(latency.count());
+  if (entry.host_ == nullptr) {
+    entry.host_ = host;
+    entry.ewma_us_ = sample;
+  } else {
+    entry.ewma_us_ += ewma_weight_ * (sample - entry.ewma_us_);
+  }
+
+  if (++cluster.samples_since_update_ >= MedianUpdateInterval || cluster.median_us_ == 0) {
+    updateMedian(cluster);
+  }
+}
+
+bool ThreadLocalHostLatency::isSlow(const Upstream::HostDescription& host) const {
+  auto cluster_iter = clusters_.find(host.cluster().name());
+  if (cluster_iter == clusters_.end()) {
+    return false;
+  }
+  const auto& cluster = cluster_iter->second;
+  if (cluster.hosts_.size() < min_hosts_ || cluster.median_us_ == 0) {
+    return false;
+  }
+  auto iter = cluster.hosts_.find(&host);
+  return iter != cluster.hosts_.end() &&
+         iter->second.ewma_us_ > slow_host_factor_ * cluster.median_us_;
+}
+
+void ThreadLocalHostLatency::updateMedian(ClusterEntry& cluster) {
+  cluster.samples_since_update_ = 0;
+
+  std::vector<double> averages;
+  averages.reserve(cluster.hosts_.size());
+  for (auto iter = cluster.hosts_.begin(); iter != cluster.hosts_.end();) {
+    // Nobody else holds the host once it has been removed from the cluster and has no request in
+    // flight, forget about it.
+    if (iter->second.host_.use_count() == 1) {
+      cluster.hosts_.erase(iter++);
+      continue;
+    }
+    averages.push_back(iter->second.ewma_us_);
+    ++iter;
+  }
+
+  if (averages.empty()) {
+    cluster.median_us_ = 0;
+    return;
+  }
+  auto middle = averages.begin() + averages.size() / 2;
+  std::nth_element(averages.begin(), middle, averages.end());
+  cluster.median_us_ = *middle;
+}
+
+HostLatency::HostLatency(ThreadLocal::SlotAllocator& tls, const LatencyOutlierConfig& config)
+    : tls_(tls.allocateSlot()), eject_(config.eject()) {
+  tls_->set([config](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalHostLatency>(config);
+  });
+}
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/host_description.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "api/meta_protocol_proxy/filters/router/v1alpha/router.pb.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+using LatencyOutlierConfig = aeraki::meta_protocol_proxy::filters::router::v1alpha::LatencyOutlier;
+
+/**
+ * ThreadLocalHostLatency keeps an exponentially weighted moving average of the response time of
+ * each upstream host on a worker, and tells the hosts whose average exceeds a multiple of the
+ * median of their cluster.
+ */
+class ThreadLocalHostLatency : public ThreadLocal::ThreadLocalObject {
+public:
+  ThreadLocalHostLatency(const LatencyOutlierConfig& config);
+
+  void record(const Upstream::HostDescriptionConstSharedPtr& host,
+              std::chrono::microseconds latency);
+
+  /**
+   * @return bool whether the host is slower than the configured multiple of its cluster median.
+   */
+  bool isSlow(const Upstream::HostDescription& host) const;
+
+private:
+  struct HostEntry {
+    // Also tells whether the host is still in use, see updateMedian.
+    Upstream::HostDescriptionConstSharedPtr host_;
+    double ewma_us_{};
+  };
+
+  struct ClusterEntry {
+    absl::flat_hash_map<const Upstream::HostDescription*, HostEntry> hosts_;
+    double median_us_{};
+    uint32_t samples_since_update_{};
+  };
+
+  void updateMedian(ClusterEntry& cluster);
+
+  const double ewma_weight_;
+  const double slow_host_factor_;
+  const uint32_t min_hosts_;
+  absl::flat_hash_map<std::string, ClusterEntry> clusters_;
+};
+
+/**
+ * HostLatency is shared by all the workers, each of them owns its averages.
+ */
+class HostLatency {
+public:
+  HostLatency(ThreadLocal::SlotAllocator& tls, const LatencyOutlierConfig& config);
+
+  ThreadLocalHostLatency& local() { return tls_->getTyped<ThreadLocalHostLatency>(); }
+  bool eject() const { return eject_; }
+
+private:
+  ThreadLocal::SlotPtr tls_;
+  const bool eject_;
+};
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,109 @@
+#include "src/meta_protocol_proxy/filters/router/outstanding_requests.h"
+
+#include <algorithm>
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+void ThreadLocalOutstandingRequests::addCluster(Upstream::ThreadLocalCluster& cluster) {
+  auto& entry = clusters_[cluster.info().get()];
+  if (entry.info_ != nullptr) {
+    return;
+  }
+  entry.info_ = cluster.info();
+  entry.host_count_ = hostCount(cluster.prioritySet());
+  // The cluster outlives the entry only while it isn't updated, the handle is then left behind
+  // with the entry of the former cluster.
+  const Upstream::PrioritySet& priority_set = cluster.prioritySet();
+  entry.member_update_handle_ = cluster.prioritySet().addMemberUpdateCb(
+      [&entry, &priority_set](const Upstream::HostVector&, const Upstream::HostVector&) {
+        entry.host_count_ = hostCount(priority_set);
+      });
+}
+
+void ThreadLocalOutstandingRequests::inc(const Upstream::HostDescriptionConstSharedPtr& host) {
+  auto& entry = hosts_[host.get()];
+  if (entry.host_ == nullptr) {
+    entry.host_ = host;
+    auto& cluster = clusters_[&host->cluster()];
+    cluster.hosts_++;
+    entry.cluster_ = &cluster;
+    if (hosts_.size() >= sweep_size_) {
+      sweep();
+    }
+  }
+  entry.outstanding_++;
+  entry.cluster_->outstanding_++;
+}
+
+void ThreadLocalOutstandingRequests::dec(const Upstream::HostDescription& host) {
+  auto iter = hosts_.find(&host);
+  if (iter == hosts_.end() || iter->second.outstanding_ == 0) {
+    return;
+  }
+  iter->second.outstanding_--;
+  ASSERT(iter->second.cluster_->outstanding_ > 0);
+  iter->second.cluster_->outstanding_--;
+}
+
+uint32_t ThreadLocalOutstandingRequests::get(const Upstream::HostDescription& host) const {
+  auto iter = hosts_.find(&host);
+  return iter == hosts_.end() ? 0 : iter->second.outstanding_;
+}
+
+bool ThreadLocalOutstandingRequests::aboveAverage(const Upstream::HostDescription& host) const {
+  auto iter = hosts_.find(&host);
+  if (iter == hosts_.end() || iter->second.outstanding_ == 0) {
+    return false;
+  }
+  const uint64_t outstanding = iter->second.outstanding_;
+  const ClusterEntry& cluster = *iter->second.cluster_;
+  return cluster.host_count_ > 0 && outstanding * cluster.host_count_ > cluster.outstanding_;
+}
+
+void ThreadLocalOutstandingRequests::sweep() {
+  // The host is only referenced by its entry once it has been removed from its cluster and its
+  // connections are closed.
+  for (auto iter = hosts_.begin(); iter != hosts_.end();) {
+    const HostEntry& entry = iter->second;
+    if (entry.outstanding_ == 0 && entry.host_.use_count() == 1) {
+      entry.cluster_->hosts_--;
+      hosts_.erase(iter++);
+    } else {
+      ++iter;
+    }
+  }
+  for (auto iter = clusters_.begin(); iter != clusters_.end();) {
+    const ClusterEntry& entry = iter->second;
+    if (entry.hosts_ == 0 && (entry.info_ == nullptr || entry.info_.use_count() == 1)) {
+      clusters_.erase(iter++);
+    } else {
+      ++iter;
+    }
+  }
+  sweep_size_ = std::max(MinSweepSize, 2 * hosts_.size());
+}
+
+OutstandingRequests::OutstandingRequests(ThreadLocal::SlotAllocator& tls)
+    : tls_(tls.allocateSlot()) {
+  tls_->set([](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalOutstandingRequests>();
+  });
+}
+
+uint32_t hostCount(const Upstream::PrioritySet& priority_set) {
+  uint32_t count = 0;
+  for (const auto& host_set : priority_set.hostSetsPerPriority()) {
+    count += host_set->hosts().size();
+  }
+  return count;
+}
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/callback.h"
+#include "envoy/thread_local/thread_local.h"
+#include "envoy/upstream/host_description.h"
+#include "envoy/upstream/thread_local_cluster.h"
+#include "envoy/upstream/upstream.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+/**
+ * ThreadLocalOutstandingRequests counts the meta protocol requests in flight to each upstream host
+ * on a worker. Unlike the TCP connection count, this is the real RPC concurrency of a host once
+ * requests share the upstream connections. The entry of a host and of its cluster are resolved on
+ * the first request to the host and kept, they are swept once the host is gone.
+ */
+class ThreadLocalOutstandingRequests : public ThreadLocal::ThreadLocalObject {
+public:
+  /**
+   * Track the host count of a cluster, before its hosts get requests.
+   */
+  void addCluster(Upstream::ThreadLocalCluster& cluster);
+
+  void inc(const Upstream::HostDescriptionConstSharedPtr& host);
+  void dec(const Upstream::HostDescription& host);
+
+  /**
+   * @return uint32_t the requests in flight to the host.
+   */
+  uint32_t get(const Upstream::HostDescription& host) const;
+
+  /**
+   * @return bool whether the host has more requests in flight than the average of the hosts in its
+   *         cluster.
+   */
+  bool aboveAverage(const Upstream::HostDescription& host) const;
+
+private:
+  struct ClusterEntry {
+    // Keeps the cluster alive so that its address can't be reused by another cluster as the key.
+    Upstream::ClusterInfoConstSharedPtr info_;
+    Common::CallbackHandlePtr member_update_handle_;
+    uint32_t host_count_{};
+    // The host entries of the cluster.
+    uint32_t hosts_{};
+    uint64_t outstanding_{};
+  };
+
+  struct HostEntry {
+    // Keeps the host alive so that its address can't be reused by another host as the key.
+    Upstream::HostDescriptionConstSharedPtr host_;
+    ClusterEntry* cluster_{};
+    uint32_t outstanding_{};
+  };
+
+  // Removes the entries of the hosts and clusters which are only kept alive by them.
+  void sweep();
+
+  // The sweep runs each time the host entries double, and not below this count.
+  static constexpr size_t MinSweepSize = 64;
+
+  absl::flat_hash_map<const Upstream::HostDescription*, HostEntry> hosts_;
+  // The host entries point to their cluster entry, which must not move.
+  absl::node_hash_map<const Upstream::ClusterInfo*, ClusterEntry> clusters_;
+  size_t sweep_size_{MinSweepSize};
+};
+
+/**
+ * OutstandingRequests is shared by all the workers, each of them owns its counters.
+ */
+class OutstandingRequests {
+public:
+  OutstandingRequests(ThreadLocal::SlotAllocator& tls);
+
+  ThreadLocalOutstandingRequests& local() {
+    return tls_->getTyped<ThreadLocalOutstandingRequests>();
+  }
+
+private:
+  ThreadLocal::SlotPtr tls_;
+};
+
+/**
+ * @return uint32_t the number of hosts in all the priorities of the priority set.
+ */
+uint32_t hostCount(const Upstream::PrioritySet& priority_set);
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -8,6 +8,8 @@
 
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/filters/router/outstanding_requests.h"
+#include "src/meta_protocol_proxy/filters/router/stats.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -33,6 +35,42 @@ public:
   virtual CodecPtr createCodec() PURE;
   virtual void resetStream() PURE;
   virtual void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) PURE;
+  virtual Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string& host) PURE;
+
+  /**
+   * @return ConnectionData* an upstream connection to the host which the request shares with other
+   *         requests of the owner, or nullptr if the request needs a connection of its own.
+   */
+  virtual Tcp::ConnectionPool::ConnectionData*
+  sharedRequestConnection(const std::string& host) PURE;
+
+  /**
+   * @return bool whether the connection acquired for a request is handed over to the owner with
+   *         setUpstreamConnection once the request is written, to be shared with its following
+   *         requests.
+   */
+  virtual bool sharesRequestConnections() const PURE;
+
+  /**
+   * Called when the upstream connection is ready and the request is about to be written to it.
+   */
+  virtual void onUpstreamRequestSent() PURE;
+
+  /**
+   * Called when the connection pool fails to provide a connection for the request.
+   * @param reason supplies the reason of the failure.
+   */
+  virtual void onUpstreamPoolFailure(ConnectionPool::PoolFailureReason reason) PURE;
+
+  /**
+   * @return RouterStats& the router stats.
+   */
+  virtual RouterStats& stats() PURE;
+
+  /**
+   * @return ThreadLocalOutstandingRequests& the in-flight requests per host of the worker.
+   */
+  virtual ThreadLocalOutstandingRequests& outstandingRequests() PURE;
 
 protected:
   struct PrepareUpstreamRequestResult {
@@ -53,6 +91,7 @@ protected:
     }
 
     cluster_ = cluster->info();
+    outstandingRequests().addCluster(*cluster);
     ENVOY_LOG(debug, "meta protocol router: cluster {} match for request '{}'", cluster_->name(),
               metadata->getRequestId());
 
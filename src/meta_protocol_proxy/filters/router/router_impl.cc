@@ -2,6 +2,8 @@
 
 #include "envoy/upstream/thread_local_cluster.h"
 
+#include "absl/container/inlined_vector.h"
+
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
 
@@ -11,6 +13,25 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Router {
 
+RouterConfig::RouterConfig(const RouterProto& config, const std::string& stat_prefix,
+                           Server::Configuration::FactoryContext& context)
+    : cluster_manager_(context.clusterManager()), runtime_(context.runtime()),
+      stats_(RouterStats::generateStats(stat_prefix, context.scope())),
+      least_outstanding_requests_(config.least_outstanding_requests()),
+      outstanding_requests_(context.threadLocal()) {
+  if (config.has_latency_outlier()) {
+    host_latency_ = std::make_unique<HostLatency>(context.threadLocal(), config.latency_outlier());
+  }
+  shadow_writer_ =
+      std::make_unique<ShadowWriterImpl>(cluster_manager_, context.mainThreadDispatcher(),
+                                         context.threadLocal(), stats_, outstanding_requests_,
+                                         config.mirror_queue());
+  if (config.has_prewarm()) {
+    prewarmer_ = std::make_unique<ConnectionPrewarmer>(cluster_manager_, context.threadLocal(),
+                                                       config.prewarm(), stats_);
+  }
+}
+
 // ---- DecoderFilter ---- handle request path
 void Router::onDestroy() {
   // close the upstream connection if the upstream request has not been completed because there may
@@ -45,6 +66,7 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
   }
 
   route_entry_ = route_->routeEntry();
+  route_entry_->routeStats().rq_total_.inc();
   const std::string& cluster_name = route_entry_->clusterName();
 
   auto prepare_result = prepareUpstreamRequest(cluster_name, request_metadata_, this);
@@ -52,34 +74,43 @@ FilterStatus Router::onMessageDecoded(MetadataSharedPtr request_metadata,
     decoder_filter_callbacks_->sendLocalReply(prepare_result.exception.value(), false);
     return FilterStatus::AbortIteration;
   }
+  route_entry_->clusterStats().upstream_rq_total_.inc();
   auto& conn_pool_data = prepare_result.conn_pool_data.value();
 
   ENVOY_STREAM_LOG(debug, "meta protocol router: decoding request", *decoder_filter_callbacks_);
 
-  // Save the clone for request mirroring
-  auto metadata_clone = request_metadata_->clone();
+  // Pick the mirror clusters before the upstream request drains the original message, the message
+  // is only cloned if it's mirrored.
+  absl::InlinedVector<const std::string*, 2> mirror_clusters;
+  const auto& policies = route_entry_->requestMirrorPolicies();
+  for (const auto& policy : policies) {
+    // todo replace with rand generator of conn mgr
+    if (policy->shouldShadow(config_.runtime(), rand())) {
+      mirror_clusters.push_back(&policy->clusterName());
+    }
+  }
+  MetadataSharedPtr metadata_clone =
+      mirror_clusters.empty() ? nullptr : request_metadata_->clone();
 
   route_entry_->requestMutation(request_mutation);
   upstream_request_ =
       std::make_unique<UpstreamRequest>(*this, conn_pool_data, request_metadata_, request_mutation);
+  upstream_request_start_ = decoder_filter_callbacks_->dispatcher().timeSource().monotonicTime();
   auto filter_status = upstream_request_->start();
 
   // Prepare connections for shadow routers, if there are mirror policies configured and currently
   // enabled.
-  const auto& policies = route_entry_->requestMirrorPolicies();
-  ENVOY_LOG(debug, "meta protocol router: requestMirrorPolicies size:{}", policies.size());
-
-  if (!policies.empty()) {
-    for (const auto& policy : policies) {
-      if (policy->shouldShadow(runtime_, rand())) { // todo replace with rand generator of conn mgr
-        // We can reuse the same metadata for each request because its original message will be
-        // drained in the request
-        ENVOY_LOG(debug, "meta protocol router: mirror request size:{}",
-                  metadata_clone->originMessage().length());
-        shadow_writer_.submit(policy->clusterName(), metadata_clone->clone(), request_mutation,
-                              *decoder_filter_callbacks_);
-      }
-    }
+  ENVOY_LOG(debug, "meta protocol router: requestMirrorPolicies size:{}, mirrored:{}",
+            policies.size(), mirror_clusters.size());
+
+  for (size_t i = 0; i < mirror_clusters.size(); i++) {
+    // The original message of the metadata is drained by the mirrored request, so every mirror but
+    // the last one takes a copy of the clone.
+    ENVOY_LOG(debug, "meta protocol router: mirror request size:{}",
+              metadata_clone->originMessage().length());
+    auto metadata = i + 1 < mirror_clusters.size() ? metadata_clone->clone() : metadata_clone;
+    config_.shadowWriter().submit(*mirror_clusters[i], metadata, request_mutation,
+                                  *decoder_filter_callbacks_);
   }
 
   return filter_status;
@@ -99,9 +130,24 @@ FilterStatus Router::onMessageEncoded(MetadataSharedPtr metadata, MutationShared
   ENVOY_STREAM_LOG(trace, "meta protocol router: response status: {}", *encoder_filter_callbacks_,
                    metadata->getResponseStatus());
 
+  const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      decoder_filter_callbacks_->dispatcher().timeSource().monotonicTime() -
+      upstream_request_start_);
+  const uint64_t latency_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+  const auto& cluster_stats = route_entry_->clusterStats();
+  route_entry_->routeStats().upstream_rq_time_.recordValue(latency_ms);
+  cluster_stats.upstream_rq_time_.recordValue(latency_ms);
+  const bool slow_host = recordLatency(latency);
+
   switch (metadata->getResponseStatus()) {
   case ResponseStatus::Ok:
     if (metadata->getMessageType() == MessageType::Error) {
+      cluster_stats.upstream_rsp_exception_.inc();
+    } else {
+      cluster_stats.upstream_rsp_success_.inc();
+    }
+    if (metadata->getMessageType() == MessageType::Error || slow_host) {
       upstream_request_->upstreamHost()->outlierDetector().putResult(
           Upstream::Outlier::Result::ExtOriginRequestFailed);
     } else {
@@ -110,6 +156,7 @@ FilterStatus Router::onMessageEncoded(MetadataSharedPtr metadata, MutationShared
     }
     break;
   case ResponseStatus::Error:
+    cluster_stats.upstream_rsp_error_.inc();
     upstream_request_->upstreamHost()->outlierDetector().putResult(
         Upstream::Outlier::Result::ExtOriginRequestFailed);
     break;
@@ -121,6 +168,54 @@ FilterStatus Router::onMessageEncoded(MetadataSharedPtr metadata, MutationShared
 }
 // ---- EncoderFilter ---
 
+bool Router::recordLatency(std::chrono::microseconds latency) {
+  HostLatency* host_latency = config_.hostLatency();
+  if (host_latency == nullptr || upstream_request_->upstreamHost() == nullptr) {
+    return false;
+  }
+
+  auto& local = host_latency->local();
+  local.record(upstream_request_->upstreamHost(), latency);
+  if (!local.isSlow(*upstream_request_->upstreamHost())) {
+    return false;
+  }
+
+  ENVOY_STREAM_LOG(debug, "meta protocol router: slow response from {}, {} us",
+                   *encoder_filter_callbacks_,
+                   upstream_request_->upstreamHost()->address()->asString(), latency.count());
+  config_.stats().upstream_rq_slow_host_.inc();
+  // Only a success is turned into a failure, so the outlier detector ejects the slow host through
+  // its consecutive failure and success rate checks.
+  return host_latency->eject();
+}
+
+// ---- RequestOwner ----
+void Router::onUpstreamRequestSent() {
+  decoder_filter_callbacks_->onUpstreamRequestSent(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          decoder_filter_callbacks_->dispatcher().timeSource().monotonicTime() -
+          upstream_request_start_));
+}
+
+void Router::onUpstreamPoolFailure(ConnectionPool::PoolFailureReason reason) {
+  const auto& stats = route_entry_->routeStats();
+  switch (reason) {
+  case ConnectionPool::PoolFailureReason::Overflow:
+    stats.upstream_rq_pool_overflow_.inc();
+    break;
+  case ConnectionPool::PoolFailureReason::LocalConnectionFailure:
+    stats.upstream_rq_pool_local_cx_failure_.inc();
+    break;
+  case ConnectionPool::PoolFailureReason::RemoteConnectionFailure:
+    stats.upstream_rq_pool_remote_cx_failure_.inc();
+    break;
+  case ConnectionPool::PoolFailureReason::Timeout:
+    stats.upstream_rq_pool_timeout_.inc();
+    break;
+  }
+}
+// ---- RequestOwner ----
+
 // ---- Tcp::ConnectionPool::UpstreamCallbacks ----
 void Router::onUpstreamData(Buffer::Instance& data, bool end_stream) {
   // We shouldn't get more data after a response is completed, otherwise it's a codec issue
@@ -195,6 +290,18 @@ absl::optional<uint64_t> Router::computeHashKey() {
 const Network::Connection* Router::downstreamConnection() const {
   return decoder_filter_callbacks_ != nullptr ? decoder_filter_callbacks_->connection() : nullptr;
 }
+
+bool Router::shouldSelectAnotherHost(const Upstream::Host& host) {
+  // Steer away from the hosts with more requests in flight than the average of the cluster, so the
+  // load balancer picks from the RPC concurrency rather than the connection count.
+  if (config_.leastOutstandingRequests() &&
+      config_.outstandingRequests().local().aboveAverage(host)) {
+    return true;
+  }
+  // Deprioritize the hosts that respond much slower than the others.
+  HostLatency* host_latency = config_.hostLatency();
+  return host_latency != nullptr && host_latency->local().isSlow(host);
+}
 // ---- Upstream::LoadBalancerContextBase ----
 
 void Router::cleanUpstreamRequest() {
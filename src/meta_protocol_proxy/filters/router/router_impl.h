@@ -3,12 +3,18 @@
 #include <memory>
 
 #include "envoy/buffer/buffer.h"
+#include "envoy/server/filter_config.h"
 #include "envoy/tcp/conn_pool.h"
 
 #include "source/common/upstream/load_balancer_impl.h"
 
+#include "api/meta_protocol_proxy/filters/router/v1alpha/router.pb.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
+#include "src/meta_protocol_proxy/filters/router/connection_prewarmer.h"
+#include "src/meta_protocol_proxy/filters/router/host_latency.h"
+#include "src/meta_protocol_proxy/filters/router/outstanding_requests.h"
 #include "src/meta_protocol_proxy/filters/router/router.h"
+#include "src/meta_protocol_proxy/filters/router/shadow_writer_impl.h"
 #include "src/meta_protocol_proxy/filters/router/upstream_request.h"
 #include "src/meta_protocol_proxy/route/route.h"
 
@@ -18,14 +24,51 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Router {
 
+// The hosts the load balancer may pick in turn before a host that is busier or slower than the
+// others is accepted anyway.
+constexpr uint32_t HostSelectionRetryCount = 2;
+
+using RouterProto = aeraki::meta_protocol_proxy::filters::router::v1alpha::Router;
+
+/**
+ * RouterConfig holds the router filter configuration and the objects shared by all the routers
+ * created from it.
+ */
+class RouterConfig {
+public:
+  RouterConfig(const RouterProto& config, const std::string& stat_prefix,
+               Server::Configuration::FactoryContext& context);
+
+  Upstream::ClusterManager& clusterManager() { return cluster_manager_; }
+  Runtime::Loader& runtime() { return runtime_; }
+  RouterStats& stats() { return stats_; }
+  ShadowWriter& shadowWriter() { return *shadow_writer_; }
+  OutstandingRequests& outstandingRequests() { return outstanding_requests_; }
+  bool leastOutstandingRequests() const { return least_outstanding_requests_; }
+  // nullptr if the latency outlier detection is disabled.
+  HostLatency* hostLatency() { return host_latency_.get(); }
+
+private:
+  Upstream::ClusterManager& cluster_manager_;
+  Runtime::Loader& runtime_;
+  RouterStats stats_;
+  const bool least_outstanding_requests_;
+  // The thread local objects are allocated a slot before the shadow writer, so they outlive the
+  // shadow requests when the workers shut down.
+  OutstandingRequests outstanding_requests_;
+  std::unique_ptr<HostLatency> host_latency_;
+  std::unique_ptr<ShadowWriterImpl> shadow_writer_;
+  std::unique_ptr<ConnectionPrewarmer> prewarmer_;
+};
+
+using RouterConfigSharedPtr = std::shared_ptr<RouterConfig>;
+
 class Router : public Tcp::ConnectionPool::UpstreamCallbacks,
                public Upstream::LoadBalancerContextBase,
                public RequestOwner,
                public CodecFilter {
 public:
-  Router(Upstream::ClusterManager& cluster_manager, Runtime::Loader& runtime,
-         ShadowWriter& shadow_writer)
-      : RequestOwner(cluster_manager), runtime_(runtime), shadow_writer_(shadow_writer) {}
+  Router(RouterConfig& config) : RequestOwner(config.clusterManager()), config_(config) {}
   ~Router() override { ENVOY_LOG(trace, "********** Router destructed ***********"); };
 
   // DecoderFilter
@@ -42,6 +85,12 @@ public:
   absl::optional<uint64_t> computeHashKey() override;
   const Envoy::Router::MetadataMatchCriteria* metadataMatchCriteria() override { return nullptr; }
   const Network::Connection* downstreamConnection() const override;
+  bool shouldSelectAnotherHost(const Upstream::Host& host) override;
+  uint32_t hostSelectionRetryCount() const override {
+    return config_.leastOutstandingRequests() || config_.hostLatency() != nullptr
+               ? HostSelectionRetryCount
+               : 0;
+  }
 
   // Tcp::ConnectionPool::UpstreamCallbacks
   void onUpstreamData(Buffer::Instance& data, bool end_stream) override;
@@ -60,6 +109,19 @@ public:
   void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override {
     decoder_filter_callbacks_->setUpstreamConnection(std::move(conn));
   };
+  Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string& host) override {
+    return decoder_filter_callbacks_->sharedStreamConnection(host);
+  }
+  Tcp::ConnectionPool::ConnectionData* sharedRequestConnection(const std::string&) override {
+    return nullptr;
+  }
+  bool sharesRequestConnections() const override { return false; }
+  void onUpstreamRequestSent() override;
+  void onUpstreamPoolFailure(ConnectionPool::PoolFailureReason reason) override;
+  RouterStats& stats() override { return config_.stats(); }
+  ThreadLocalOutstandingRequests& outstandingRequests() override {
+    return config_.outstandingRequests().local();
+  }
 
   // This function is for testing only.
   // Envoy::Buffer::Instance& upstreamRequestBufferForTest() { return upstream_request_buffer_; }
@@ -67,6 +129,9 @@ public:
 private:
   void cleanUpstreamRequest();
   bool upstreamRequestFinished() { return upstream_request_ == nullptr; };
+  // Records the response time of the upstream host, returns true if the response should be
+  // reported as a failure to the outlier detector because the host is too slow.
+  bool recordLatency(std::chrono::microseconds latency);
 
   DecoderFilterCallbacks* decoder_filter_callbacks_{};
   EncoderFilterCallbacks* encoder_filter_callbacks_{};
@@ -77,9 +142,8 @@ private:
   std::unique_ptr<UpstreamRequest> upstream_request_;
   MetadataSharedPtr request_metadata_;
 
-  // member variables for traffic mirroring
-  Runtime::Loader& runtime_;
-  ShadowWriter& shadow_writer_;
+  RouterConfig& config_;
+  MonotonicTime upstream_request_start_;
 };
 
 } // namespace Router
@@ -1,7 +1,12 @@
 #include "src/meta_protocol_proxy/filters/router/shadow_writer_impl.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "envoy/upstream/thread_local_cluster.h"
 
+#include "source/common/protobuf/utility.h"
+
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
 
@@ -11,28 +16,252 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 namespace Router {
 
+namespace {
+
+constexpr uint32_t DefaultMaxInFlightMirrors = 128;
+constexpr uint32_t DefaultMaxPendingMirrors = 128;
+constexpr uint64_t DefaultMirrorTimeoutMs = 10000;
+
+} // namespace
+
+ActiveRouters::ActiveRouters(Event::Dispatcher& dispatcher, const MirrorQueueConfig& config,
+                             RouterStats& stats)
+    : dispatcher_(dispatcher),
+      max_in_flight_(config.max_in_flight() > 0 ? config.max_in_flight()
+                                                : DefaultMaxInFlightMirrors),
+      max_pending_(config.max_pending() > 0 ? config.max_pending() : DefaultMaxPendingMirrors),
+      drop_oldest_(config.overflow_policy() == MirrorQueueConfig::DROP_OLDEST),
+      timeout_(PROTOBUF_GET_MS_OR_DEFAULT(config, timeout, DefaultMirrorTimeoutMs)),
+      max_requests_per_connection_(config.max_requests_per_connection()), stats_(stats) {}
+
+ActiveRouters::~ActiveRouters() {
+  ENVOY_LOG(trace, "********** ActiveRouters destructed ***********");
+  // The queued routers are dropped first so that removing the active ones doesn't start them.
+  stats_.mirror_rq_pending_.sub(pending_routers_.size());
+  pending_routers_.clear();
+  while (!active_routers_.empty()) {
+    active_routers_.front()->cleanup(true);
+  }
+}
+
+bool ActiveRouters::admit() const {
+  return drop_oldest_ || active_routers_.size() < max_in_flight_ ||
+         pending_routers_.size() < max_pending_;
+}
+
+void ActiveRouters::submit(std::unique_ptr<ShadowRouterImpl>&& router) {
+  if (active_routers_.size() < max_in_flight_) {
+    start(std::move(router));
+    return;
+  }
+
+  if (pending_routers_.size() >= max_pending_) {
+    ASSERT(drop_oldest_);
+    ENVOY_LOG(debug, "meta protocol shadow router: mirror queue is full, drop the oldest request");
+    pending_routers_.pop_front();
+    stats_.mirror_rq_pending_.dec();
+    stats_.mirror_rq_dropped_.inc();
+  }
+  pending_routers_.push_back(std::move(router));
+  stats_.mirror_rq_pending_.inc();
+  stats_.mirror_rq_queued_.inc();
+}
+
+void ActiveRouters::start(std::unique_ptr<ShadowRouterImpl>&& router) {
+  // The router is listed before its request starts, the request may complete and remove it right
+  // away if a pooled connection is ready.
+  auto& shadow_router = *router;
+  LinkedList::moveIntoList(std::move(router), active_routers_);
+  stats_.mirror_rq_active_.inc();
+  if (!shadow_router.createUpstreamRequest()) {
+    shadow_router.removeFromList(active_routers_);
+    stats_.mirror_rq_active_.dec();
+  }
+}
+
+void ActiveRouters::remove(ShadowRouterImpl& router) {
+  ENVOY_LOG(trace, "********** remove shadow router from active routers ***********");
+  dispatcher_.deferredDelete(router.removeFromList(active_routers_));
+  stats_.mirror_rq_active_.dec();
+
+  while (!pending_routers_.empty() && active_routers_.size() < max_in_flight_) {
+    auto next = std::move(pending_routers_.front());
+    pending_routers_.pop_front();
+    stats_.mirror_rq_pending_.dec();
+    start(std::move(next));
+  }
+}
+
+Tcp::ConnectionPool::ConnectionData* ActiveRouters::attach(ShadowRouterImpl& router,
+                                                           const std::string& host) {
+  auto iter = connections_.find(host);
+  if (iter == connections_.end()) {
+    return nullptr;
+  }
+  for (auto& connection : iter->second) {
+    if (!connection->closed() && connection->requests() < max_requests_per_connection_) {
+      connection->addRequest(router);
+      stats_.mirror_rq_multiplexed_.inc();
+      return &connection->connectionData();
+    }
+  }
+  return nullptr;
+}
+
+void ActiveRouters::share(ShadowRouterImpl& router,
+                          Tcp::ConnectionPool::ConnectionDataPtr conn_data, CodecPtr codec) {
+  const std::string host =
+      conn_data->connection().connectionInfoProvider().remoteAddress()->asString();
+  auto connection =
+      std::make_unique<MirrorConnection>(*this, host, std::move(conn_data), std::move(codec));
+  connection->addRequest(router);
+  connections_[host].push_back(std::move(connection));
+  stats_.mirror_upstream_cx_shared_.inc();
+}
+
+void ActiveRouters::removeConnection(MirrorConnection& connection) {
+  auto iter = connections_.find(connection.host());
+  ASSERT(iter != connections_.end());
+  auto& connections = iter->second;
+  for (auto it = connections.begin(); it != connections.end(); ++it) {
+    if (it->get() == &connection) {
+      stats_.mirror_upstream_cx_shared_.dec();
+      // The connection may be in the middle of a callback.
+      dispatcher_.deferredDelete(std::move(*it));
+      connections.erase(it);
+      break;
+    }
+  }
+  if (connections.empty()) {
+    connections_.erase(iter);
+  }
+}
+
+MirrorConnection::MirrorConnection(ActiveRouters& parent, const std::string& host,
+                                   Tcp::ConnectionPool::ConnectionDataPtr conn_data,
+                                   CodecPtr codec)
+    : parent_(parent), host_(host), conn_data_(std::move(conn_data)), codec_(std::move(codec)) {
+  conn_data_->addUpstreamCallbacks(*this);
+}
+
+MirrorConnection::~MirrorConnection() {
+  // The worker is going away with requests still on the connection.
+  if (conn_data_ != nullptr) {
+    closed_ = true;
+    conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+}
+
+void MirrorConnection::onUpstreamData(Buffer::Instance& data, bool end_stream) {
+  while (data.length() > 0) {
+    frame_.reset();
+    frame_.setMessageType(MessageType::Response);
+    try {
+      if (codec_->decodeFrame(data, frame_) == DecodeStatus::WaitForData) {
+        break;
+      }
+    } catch (const EnvoyException& ex) {
+      ENVOY_LOG(error, "meta protocol shadow router: response error from {}: {}", host_,
+                ex.what());
+      closeRequests(true);
+      return;
+    }
+    if (frame_.getMessageType() == MessageType::Heartbeat) {
+      continue;
+    }
+    const uint64_t request_id = frame_.getRequestId();
+    auto iter = std::find_if(requests_.begin(), requests_.end(), [request_id](const auto* router) {
+      return router->requestId() == request_id;
+    });
+    if (iter == requests_.end()) {
+      ENVOY_LOG(debug, "meta protocol shadow router: drop the response {} from {}", request_id,
+                host_);
+      continue;
+    }
+    (*iter)->onMirrorResponse();
+    if (conn_data_ == nullptr) {
+      // The last request has completed and the connection has gone back to the pool.
+      data.drain(data.length());
+      return;
+    }
+  }
+
+  if (end_stream) {
+    closeRequests(false);
+  }
+}
+
+void MirrorConnection::onEvent(Network::ConnectionEvent event) {
+  if (event == Network::ConnectionEvent::RemoteClose ||
+      event == Network::ConnectionEvent::LocalClose) {
+    closeRequests(false);
+  }
+}
+
+void MirrorConnection::addRequest(ShadowRouterImpl& router) {
+  requests_.push_back(&router);
+  router.setMirrorConnection(*this);
+}
+
+void MirrorConnection::removeRequest(ShadowRouterImpl& router, bool completed) {
+  if (closed_) {
+    return;
+  }
+  requests_.remove(&router);
+  abandoned_ = abandoned_ || !completed;
+  if (!requests_.empty()) {
+    return;
+  }
+
+  closed_ = true;
+  if (abandoned_) {
+    conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+  conn_data_.reset();
+  parent_.removeConnection(*this);
+}
+
+void MirrorConnection::closeRequests(bool close) {
+  if (closed_) {
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol shadow router: the shared connection to {} has been closed",
+            host_);
+  closed_ = true;
+  auto conn_data = std::move(conn_data_);
+  if (close) {
+    conn_data->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+  std::vector<ShadowRouterImpl*> requests(requests_.begin(), requests_.end());
+  requests_.clear();
+  for (ShadowRouterImpl* router : requests) {
+    router->onMirrorConnectionClosed();
+  }
+  parent_.removeConnection(*this);
+}
+
 void ShadowWriterImpl::submit(const std::string& cluster_name, MetadataSharedPtr request_metadata,
                               MutationSharedPtr request_mutation, CodecFactory& codec_factory) {
-  auto shadow_router = std::make_unique<ShadowRouterImpl>(*this, cluster_name, request_metadata,
-                                                          request_mutation, codec_factory);
-  ENVOY_LOG(debug, "meta protocol shadow router: send request to mirror host: {}", cluster_name);
-  const bool created = shadow_router->createUpstreamRequest();
-  if (!created) {
+  stats_.mirror_rq_total_.inc();
+  auto& active_routers = tls_->getTyped<ActiveRouters>();
+  if (!active_routers.admit()) {
+    ENVOY_LOG(debug, "meta protocol shadow router: mirror queue is full, drop the request to {}",
+              cluster_name);
+    stats_.mirror_rq_dropped_.inc();
     return;
   }
 
-  auto& active_routers = tls_->getTyped<ActiveRouters>().activeRouters();
-
-  LinkedList::moveIntoList(std::move(shadow_router), active_routers);
-  return;
+  ENVOY_LOG(debug, "meta protocol shadow router: send request to mirror host: {}", cluster_name);
+  active_routers.submit(std::make_unique<ShadowRouterImpl>(
+      *this, active_routers, cluster_name, request_metadata, request_mutation, codec_factory));
 }
 
-ShadowRouterImpl::ShadowRouterImpl(ShadowWriterImpl& parent, const std::string& cluster_name,
-                                   MetadataSharedPtr metadata, MutationSharedPtr mutation,
-                                   CodecFactory& codec_factory)
-    : RequestOwner(parent.clusterManager()), parent_(parent), cluster_name_(cluster_name),
-      metadata_(metadata), mutation_(mutation), codec_(codec_factory.createCodec()),
-      decoder_(NullResponseDecoder(codec_factory.createCodec())) {}
+ShadowRouterImpl::ShadowRouterImpl(ShadowWriterImpl& parent, ActiveRouters& routers,
+                                   const std::string& cluster_name, MetadataSharedPtr metadata,
+                                   MutationSharedPtr mutation, CodecFactory& codec_factory)
+    : RequestOwner(parent.clusterManager()), parent_(parent), routers_(routers),
+      cluster_name_(cluster_name), metadata_(metadata), mutation_(mutation),
+      connection_codec_(codec_factory.createCodec()), decoder_(codec_factory.createCodec()) {}
 
 bool ShadowRouterImpl::createUpstreamRequest() {
   auto prepare_result = prepareUpstreamRequest(cluster_name_, metadata_, this);
@@ -42,20 +271,92 @@ bool ShadowRouterImpl::createUpstreamRequest() {
 
   auto& conn_pool_data = prepare_result.conn_pool_data.value();
 
+  timeout_timer_ = routers_.dispatcher().createTimer([this]() { onTimeout(); });
+  timeout_timer_->enableTimer(routers_.timeout());
   upstream_request_ =
       std::make_unique<UpstreamRequest>(*this, conn_pool_data, metadata_, mutation_);
   upstream_request_->start();
   return true;
 }
 
-void ShadowRouterImpl::cleanup() {
+void ShadowRouterImpl::cleanup(bool close) {
   if (removed_) {
     return;
   }
   removed_ = true;
 
-  upstream_request_->releaseUpStreamConnection(false);
-  parent_.remove(*this);
+  timeout_timer_->disableTimer();
+  if (cleanup_callback_ != nullptr) {
+    cleanup_callback_->cancel();
+  }
+  if (mirror_connection_ != nullptr) {
+    mirror_connection_->removeRequest(*this, upstream_request_->responseCompleted());
+    mirror_connection_ = nullptr;
+  }
+  upstream_request_->releaseUpStreamConnection(close);
+  routers_.remove(*this);
+}
+
+void ShadowRouterImpl::deferredCleanup() {
+  if (removed_) {
+    return;
+  }
+  if (cleanup_callback_ == nullptr) {
+    cleanup_callback_ = routers_.dispatcher().createSchedulableCallback([this]() { cleanup(); });
+  }
+  cleanup_callback_->scheduleCallbackCurrentIteration();
+}
+
+void ShadowRouterImpl::onTimeout() {
+  ENVOY_LOG(debug, "meta protocol shadow router: no response from {} in {}ms", cluster_name_,
+            routers_.timeout().count());
+  routers_.stats().mirror_rq_timeout_.inc();
+  cleanup(true);
+}
+
+void ShadowRouterImpl::onMirrorResponse() {
+  upstream_request_->onResponseComplete();
+  cleanup();
+}
+
+void ShadowRouterImpl::onMirrorConnectionClosed() {
+  mirror_connection_ = nullptr;
+  cleanup();
+}
+
+void ShadowRouterImpl::resetStream() {
+  if (upstream_request_ != nullptr) {
+    upstream_request_->releaseUpStreamConnection(true);
+  }
+  deferredCleanup();
+}
+
+void ShadowRouterImpl::setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) {
+  // A stream init message isn't followed by the messages of its stream, the connection is dropped.
+  if (!removed_ && metadata_->getMessageType() == MessageType::Request) {
+    routers_.share(*this, std::move(conn), std::move(connection_codec_));
+  }
+}
+
+Tcp::ConnectionPool::ConnectionData*
+ShadowRouterImpl::sharedRequestConnection(const std::string& host) {
+  return routers_.sharesConnections() ? routers_.attach(*this, host) : nullptr;
+}
+
+bool ShadowRouterImpl::sharesRequestConnections() const { return routers_.sharesConnections(); }
+
+void ShadowRouterImpl::onUpstreamRequestSent() {
+  // No response is coming for a oneway request, its connection goes back to the pool once the
+  // request is written.
+  if (metadata_->getMessageType() == MessageType::Oneway) {
+    deferredCleanup();
+  }
+}
+
+RouterStats& ShadowRouterImpl::stats() { return parent_.stats_; }
+
+ThreadLocalOutstandingRequests& ShadowRouterImpl::outstandingRequests() {
+  return parent_.outstanding_requests_.local();
 }
 
 bool ShadowRouterImpl::requestInProgress() { return !upstream_request_->requestCompleted(); }
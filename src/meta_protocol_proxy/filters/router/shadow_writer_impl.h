@@ -1,8 +1,13 @@
 #pragma once
 
+#include <chrono>
+#include <list>
 #include <memory>
+#include <string>
 
 #include "envoy/buffer/buffer.h"
+#include "envoy/event/schedulable_cb.h"
+#include "envoy/event/timer.h"
 #include "envoy/tcp/conn_pool.h"
 #include "envoy/upstream/thread_local_cluster.h"
 
@@ -11,6 +16,9 @@
 #include "source/common/buffer/buffer_impl.h"
 #include "source/common/upstream/load_balancer_impl.h"
 
+#include "absl/container/flat_hash_map.h"
+#include "api/meta_protocol_proxy/filters/router/v1alpha/router.pb.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
 #include "src/meta_protocol_proxy/decoder.h"
 #include "src/meta_protocol_proxy/filters/filter.h"
 #include "src/meta_protocol_proxy/filters/router/router.h"
@@ -64,6 +72,8 @@ public:
   bool onHeartbeat(MetadataSharedPtr) override { return true; } // Ignore the heartBeat from
                                                                 // upstream
 
+  Codec& codec() { return *codec_; }
+
 private:
   CodecPtr codec_;
   ResponseDecoderPtr decoder_;
@@ -71,6 +81,32 @@ private:
 };
 using NullResponseDecoderPtr = std::unique_ptr<NullResponseDecoder>;
 
+/**
+ * BorrowedCodec lends the codec of a shadow router to its upstream request, so one codec encodes
+ * the mirrored request and then decodes the response instead of a codec for each.
+ */
+class BorrowedCodec : public Codec {
+public:
+  BorrowedCodec(Codec& codec) : codec_(codec) {}
+
+  // Codec
+  DecodeStatus decode(Buffer::Instance& buffer, Metadata& metadata) override {
+    return codec_.decode(buffer, metadata);
+  }
+  void encode(const Metadata& metadata, const Mutation& mutation,
+              Buffer::Instance& buffer) override {
+    codec_.encode(metadata, mutation, buffer);
+  }
+  void onError(const Metadata& metadata, const Error& error, Buffer::Instance& buffer) override {
+    codec_.onError(metadata, error, buffer);
+  }
+
+private:
+  Codec& codec_;
+};
+
+class ActiveRouters;
+class MirrorConnection;
 class ShadowWriterImpl;
 
 class ShadowRouterImpl : public ShadowRouterHandle,
@@ -80,16 +116,35 @@ class ShadowRouterImpl : public ShadowRouterHandle,
                          public Event::DeferredDeletable,
                          public LinkedObject<ShadowRouterImpl> {
 public:
-  ShadowRouterImpl(ShadowWriterImpl& parent, const std::string& cluster_name,
-                   MetadataSharedPtr metadata, MutationSharedPtr mutation,
-                   CodecFactory& codec_factory);
+  ShadowRouterImpl(ShadowWriterImpl& parent, ActiveRouters& routers,
+                   const std::string& cluster_name, MetadataSharedPtr metadata,
+                   MutationSharedPtr mutation, CodecFactory& codec_factory);
   ~ShadowRouterImpl() override {
     ENVOY_LOG(trace, "********** ShadowRouter destructed ***********");
   };
 
   bool createUpstreamRequest();
   // void maybeCleanup();
-  void cleanup();
+  /**
+   * Remove the router from the active routers, which frees its slot for the next mirrored request.
+   * @param close supplies whether the upstream connection is closed instead of going back to the
+   *        pool, since the response of an unfinished request may still come.
+   */
+  void cleanup(bool close = false);
+
+  uint64_t requestId() const { return metadata_->getRequestId(); }
+
+  /**
+   * Called by the shared connection carrying the request when the response has been received.
+   */
+  void onMirrorResponse();
+
+  /**
+   * Called when the shared connection carrying the request is closed.
+   */
+  void onMirrorConnectionClosed();
+
+  void setMirrorConnection(MirrorConnection& connection) { mirror_connection_ = &connection; }
 
   // ShadowRouterHandle
   RequestOwner& requestOwner() override { return *this; }
@@ -101,13 +156,18 @@ public:
     (void)response;
     (void)end_stream;
   };
-  CodecPtr createCodec() override { return std::move(codec_); };
-  void resetStream() override { // TODO
-    if (upstream_request_ != nullptr) {
-      upstream_request_->releaseUpStreamConnection(true);
-    }
+  CodecPtr createCodec() override { return std::make_unique<BorrowedCodec>(decoder_.codec()); };
+  void resetStream() override;
+  void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override;
+  Tcp::ConnectionPool::ConnectionData* sharedStreamConnection(const std::string&) override {
+    return nullptr;
   }
-  void setUpstreamConnection(Tcp::ConnectionPool::ConnectionDataPtr conn) override { (void)conn; };
+  Tcp::ConnectionPool::ConnectionData* sharedRequestConnection(const std::string& host) override;
+  bool sharesRequestConnections() const override;
+  void onUpstreamRequestSent() override;
+  void onUpstreamPoolFailure(ConnectionPool::PoolFailureReason) override { deferredCleanup(); }
+  RouterStats& stats() override;
+  ThreadLocalOutstandingRequests& outstandingRequests() override;
 
   // Tcp::ConnectionPool::UpstreamCallbacks
   void onUpstreamData(Buffer::Instance& data, bool end_stream) override;
@@ -123,6 +183,10 @@ private:
   using ConverterCallback = std::function<FilterStatus()>;
 
   void writeRequest();
+  // The router may be deep in the callbacks of its upstream request, it's removed at the end of the
+  // dispatcher iteration.
+  void deferredCleanup();
+  void onTimeout();
   bool requestInProgress();
   bool requestStarted() const;
   void flushPendingCallbacks();
@@ -130,6 +194,7 @@ private:
                          const std::function<void()>& on_save = {});
 
   ShadowWriterImpl& parent_;
+  ActiveRouters& routers_;
   const std::string cluster_name_;
   MetadataSharedPtr metadata_;
   MutationSharedPtr mutation_;
@@ -142,42 +207,147 @@ private:
 
   std::list<ConverterCallback> pending_callbacks_;
   bool removed_{};
+  Event::TimerPtr timeout_timer_;
+  Event::SchedulableCallbackPtr cleanup_callback_;
+  // The shared connection carrying the request, if any.
+  MirrorConnection* mirror_connection_{};
+  // The codec of the connection once it's shared, made up front since the filter which created the
+  // router may be gone by the time the connection is ready.
+  CodecPtr connection_codec_;
 
-  CodecPtr codec_;
   NullResponseDecoder decoder_;
 };
 
+/**
+ * MirrorConnection is an upstream connection carrying several mirrored requests of a worker at
+ * the same time. Its responses are only decoded to find the request they complete, by request id.
+ */
+class MirrorConnection : public Tcp::ConnectionPool::UpstreamCallbacks,
+                         public Event::DeferredDeletable,
+                         Logger::Loggable<Logger::Id::filter> {
+public:
+  MirrorConnection(ActiveRouters& parent, const std::string& host,
+                   Tcp::ConnectionPool::ConnectionDataPtr conn_data, CodecPtr codec);
+  ~MirrorConnection() override;
+
+  // Tcp::ConnectionPool::UpstreamCallbacks
+  void onUpstreamData(Buffer::Instance& data, bool end_stream) override;
+  void onEvent(Network::ConnectionEvent event) override;
+  void onAboveWriteBufferHighWatermark() override {}
+  void onBelowWriteBufferLowWatermark() override {}
+
+  Tcp::ConnectionPool::ConnectionData& connectionData() { return *conn_data_; }
+  const std::string& host() const { return host_; }
+  uint64_t requests() const { return requests_.size(); }
+  bool closed() const { return closed_; }
+
+  void addRequest(ShadowRouterImpl& router);
+
+  /**
+   * Detach a request, the connection goes back to the pool once it carries no request.
+   * @param router supplies the router of the request.
+   * @param completed supplies whether the response has been received. The connection is closed
+   *        instead of going back to the pool if a request has been given up on, since its response
+   *        may still come.
+   */
+  void removeRequest(ShadowRouterImpl& router, bool completed);
+
+private:
+  void closeRequests(bool close);
+
+  ActiveRouters& parent_;
+  const std::string host_;
+  Tcp::ConnectionPool::ConnectionDataPtr conn_data_;
+  CodecPtr codec_;
+  // Reused for each response of the connection.
+  MetadataImpl frame_;
+  // In the order they have been written, there are only a few of them.
+  std::list<ShadowRouterImpl*> requests_;
+  bool abandoned_{false};
+  bool closed_{false};
+};
+
+using MirrorConnectionPtr = std::unique_ptr<MirrorConnection>;
+
+using MirrorQueueConfig = aeraki::meta_protocol_proxy::filters::router::v1alpha::MirrorQueue;
+
+/**
+ * ActiveRouters holds the shadow routers of a worker. At most max_in_flight of them are sent
+ * upstream at the same time, the others wait in a bounded queue and are dropped by the overflow
+ * policy once the queue is full. A router is removed when its response comes, when its upstream
+ * request fails or times out, or right after its request is written if it's oneway.
+ *
+ * With max_requests_per_connection above 1, the mirrored requests to the same host share upstream
+ * connections instead of taking a connection each.
+ */
 class ActiveRouters : public ThreadLocal::ThreadLocalObject,
                       public Logger::Loggable<Logger::Id::filter> {
 public:
-  ActiveRouters(Event::Dispatcher& dispatcher) : dispatcher_(dispatcher) {}
+  ActiveRouters(Event::Dispatcher& dispatcher, const MirrorQueueConfig& config,
+                RouterStats& stats);
   // clean shadow router when dispatcher worker threads are destroyed
-  ~ActiveRouters() override {
-    ENVOY_LOG(trace, "********** ActiveRouters destructed ***********");
-    while (!active_routers_.empty()) {
-      auto& router = active_routers_.front();
-      router->resetStream();
-      remove(*router);
-    }
-  }
-
-  std::list<std::unique_ptr<ShadowRouterImpl>>& activeRouters() { return active_routers_; }
-
-  void remove(ShadowRouterImpl& router) {
-    ENVOY_LOG(trace, "********** remove shadow router from active routers ***********");
-    dispatcher_.deferredDelete(router.removeFromList(active_routers_));
-  }
+  ~ActiveRouters() override;
+
+  /**
+   * @return bool whether a new mirrored request would be accepted, only the drop newest policy
+   *         rejects a request.
+   */
+  bool admit() const;
+
+  /**
+   * Send the shadow router's request upstream, or queue it if max_in_flight requests are in
+   * flight.
+   */
+  void submit(std::unique_ptr<ShadowRouterImpl>&& router);
+
+  void remove(ShadowRouterImpl& router);
+
+  /**
+   * Attach a request to a shared connection to the host which has room for another request.
+   * @return Tcp::ConnectionPool::ConnectionData* the connection to write the request to, or nullptr
+   *         if a new connection is needed.
+   */
+  Tcp::ConnectionPool::ConnectionData* attach(ShadowRouterImpl& router, const std::string& host);
+
+  /**
+   * Share a new upstream connection, starting with the request it has been acquired for.
+   */
+  void share(ShadowRouterImpl& router, Tcp::ConnectionPool::ConnectionDataPtr conn_data,
+             CodecPtr codec);
+
+  /**
+   * Forget a connection which carries no request anymore, it's deleted at the end of the event loop
+   * iteration.
+   */
+  void removeConnection(MirrorConnection& connection);
+
+  bool sharesConnections() const { return max_requests_per_connection_ > 1; }
+  Event::Dispatcher& dispatcher() { return dispatcher_; }
+  std::chrono::milliseconds timeout() const { return timeout_; }
+  RouterStats& stats() { return stats_; }
 
 private:
+  void start(std::unique_ptr<ShadowRouterImpl>&& router);
+
   Event::Dispatcher& dispatcher_;
+  const uint32_t max_in_flight_;
+  const uint32_t max_pending_;
+  const bool drop_oldest_;
+  const std::chrono::milliseconds timeout_;
+  const uint32_t max_requests_per_connection_;
+  RouterStats& stats_;
   std::list<std::unique_ptr<ShadowRouterImpl>> active_routers_;
+  std::list<std::unique_ptr<ShadowRouterImpl>> pending_routers_;
+  absl::flat_hash_map<std::string, std::list<MirrorConnectionPtr>> connections_;
 };
 
 class ShadowWriterImpl : public ShadowWriter, Logger::Loggable<Logger::Id::filter> {
 public:
   ShadowWriterImpl(Upstream::ClusterManager& cm, Event::Dispatcher& dispatcher,
-                   ThreadLocal::SlotAllocator& tls)
-      : cm_(cm), dispatcher_(dispatcher), tls_(tls.allocateSlot()) {
+                   ThreadLocal::SlotAllocator& tls, RouterStats& stats,
+                   OutstandingRequests& outstanding_requests, const MirrorQueueConfig& config)
+      : cm_(cm), dispatcher_(dispatcher), tls_(tls.allocateSlot()), stats_(stats),
+        outstanding_requests_(outstanding_requests) {
     // Since ShadowWriter is shared across all the dispatcher worker threads, it isn't thread-safe
     // to just store shadow routers directly inside ShadowWriter.
     // We use a thread-local store for shadow writers. Each dispatcher worker thread holds an
@@ -186,8 +356,9 @@ public:
     //                                                  ---> Shadow routers list for worker thread 1
     // Router Config(Global) ---> ShadowWriter(Global)  ---> Shadow routers list for worker thread 2
     //                                                  ---> Shadow routers list for worker thread 3
-    tls_->set([](Event::Dispatcher& dispatcher) -> ThreadLocal::ThreadLocalObjectSharedPtr {
-      return std::make_shared<ActiveRouters>(dispatcher);
+    tls_->set([config, &stats](Event::Dispatcher& dispatcher)
+                  -> ThreadLocal::ThreadLocalObjectSharedPtr {
+      return std::make_shared<ActiveRouters>(dispatcher, config, stats);
     });
   }
 
@@ -195,8 +366,6 @@ public:
     ENVOY_LOG(trace, "********** remove shadow writer from Router Config ***********");
   }
 
-  void remove(ShadowRouterImpl& router) { tls_->getTyped<ActiveRouters>().remove(router); }
-
   // Router::ShadowWriter
   Upstream::ClusterManager& clusterManager() override { return cm_; }
   Event::Dispatcher& dispatcher() override { return dispatcher_; }
@@ -209,6 +378,8 @@ private:
   Upstream::ClusterManager& cm_;
   Event::Dispatcher& dispatcher_;
   ThreadLocal::SlotPtr tls_;
+  RouterStats& stats_;
+  OutstandingRequests& outstanding_requests_;
 };
 
 } // namespace Router
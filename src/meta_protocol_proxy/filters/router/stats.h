@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+
+/**
+ * All meta protocol router stats. @see stats_macros.h
+ */
+#define ALL_ROUTER_STATS(COUNTER, GAUGE)                                                           \
+  COUNTER(mirror_rq_total)                                                                         \
+  COUNTER(mirror_rq_queued)                                                                        \
+  COUNTER(mirror_rq_dropped)                                                                       \
+  COUNTER(mirror_rq_timeout)                                                                       \
+  COUNTER(mirror_rq_multiplexed)                                                                   \
+  GAUGE(mirror_rq_active, Accumulate)                                                              \
+  GAUGE(mirror_rq_pending, Accumulate)                                                             \
+  GAUGE(mirror_upstream_cx_shared, Accumulate)                                                     \
+  COUNTER(upstream_cx_prewarm)                                                                     \
+  COUNTER(upstream_cx_prewarm_failure)                                                             \
+  COUNTER(upstream_cx_prewarm_miss)                                                                \
+  COUNTER(upstream_cx_prewarm_replenish)                                                           \
+  COUNTER(upstream_rq_pool_hit)                                                                    \
+  COUNTER(upstream_rq_pool_miss)                                                                   \
+  COUNTER(upstream_rq_encode_unmodified)                                                           \
+  COUNTER(upstream_rq_rewritten)                                                                   \
+  COUNTER(upstream_rq_slow_host)
+
+/**
+ * Struct definition for all meta protocol router stats. @see stats_macros.h
+ */
+struct RouterStats {
+  ALL_ROUTER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_GAUGE_STRUCT)
+
+  static RouterStats generateStats(const std::string& prefix, Stats::Scope& scope) {
+    const std::string final_prefix = prefix + "router.";
+    return RouterStats{ALL_ROUTER_STATS(POOL_COUNTER_PREFIX(scope, final_prefix),
+                                        POOL_GAUGE_PREFIX(scope, final_prefix))};
+  }
+};
+
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
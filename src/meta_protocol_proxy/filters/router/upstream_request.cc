@@ -4,6 +4,7 @@
 
 #include "src/meta_protocol_proxy/app_exception.h"
 #include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/write_batcher.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -15,11 +16,24 @@ UpstreamRequest::UpstreamRequest(RequestOwner& parent, Upstream::TcpPoolData& po
                                  MetadataSharedPtr& metadata, MutationSharedPtr& mutation)
     : parent_(parent), conn_pool_(pool), metadata_(metadata), mutation_(mutation),
       request_complete_(false), response_started_(false), response_complete_(false),
-      stream_reset_(false) {
+      stream_reset_(false), outstanding_(false) {
   upstream_request_buffer_.move(metadata->originMessage(), metadata->originMessage().length());
 }
 
 FilterStatus UpstreamRequest::start() {
+  const MessageType message_type = metadata_->getMessageType();
+  if ((message_type == MessageType::Stream_Init || message_type == MessageType::Request) &&
+      conn_pool_.host() != nullptr) {
+    const std::string& host = conn_pool_.host()->address()->asString();
+    auto* shared_conn = message_type == MessageType::Stream_Init
+                            ? parent_.sharedStreamConnection(host)
+                            : parent_.sharedRequestConnection(host);
+    if (shared_conn != nullptr) {
+      onSharedConnection(*shared_conn, conn_pool_.host());
+      return FilterStatus::ContinueIteration;
+    }
+  }
+
   Tcp::ConnectionPool::Cancellable* handle = conn_pool_.newConnection(*this);
   if (handle) {
     // Pause while we wait for a connection.
@@ -52,6 +66,7 @@ void UpstreamRequest::onUpstreamConnectionEvent(Network::ConnectionEvent event)
 
 void UpstreamRequest::releaseUpStreamConnection(bool close) {
   stream_reset_ = true;
+  onRequestFinished();
 
   // we're still waiting for the connection pool to create an upstream connection
   if (conn_pool_handle_) {
@@ -79,19 +94,33 @@ void UpstreamRequest::releaseUpStreamConnection(bool close) {
   }
 }
 
-void UpstreamRequest::encodeData(Buffer::Instance& data) {
-  ASSERT(conn_data_);
+void UpstreamRequest::encodeData(Buffer::Instance& data,
+                                 Tcp::ConnectionPool::ConnectionData& conn_data) {
   ASSERT(!conn_pool_handle_);
 
   ENVOY_LOG(trace, "proxying {} bytes", data.length());
   auto codec = parent_.createCodec();
+  // The slices read from the downstream socket are handed to the upstream as they are unless the
+  // codec has to rebuild the message, e.g. to apply the mutation. The message is taken as
+  // unmodified when its first slice and its length are, a codec may still have rewritten it in
+  // place.
+  const void* front_slice = data.frontSlice().mem_;
+  const uint64_t length = data.length();
   codec->encode(*metadata_, *mutation_, data);
-  conn_data_->connection().write(data, false);
+  if (data.frontSlice().mem_ == front_slice && data.length() == length) {
+    parent_.stats().upstream_rq_encode_unmodified_.inc();
+  } else {
+    parent_.stats().upstream_rq_rewritten_.inc();
+  }
+  // Requests sharing the upstream connection in the same dispatcher iteration are coalesced into
+  // one write.
+  WriteBatcher::upstream(conn_data).write(data, false);
 }
 
 void UpstreamRequest::onPoolFailure(ConnectionPool::PoolFailureReason reason, absl::string_view,
                                     Upstream::HostDescriptionConstSharedPtr host) {
   conn_pool_handle_ = nullptr;
+  parent_.onUpstreamPoolFailure(reason);
 
   // Mimic an upstream reset.
   onUpstreamHostSelected(host);
@@ -121,12 +150,23 @@ void UpstreamRequest::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn_
 
   // Only invoke continueDecoding if we'd previously stopped the filter chain.
   bool continue_decoding = conn_pool_handle_ != nullptr;
+  // A connection handed over synchronously was ready in the pool, otherwise the request had to wait
+  // for a new connection.
+  if (continue_decoding) {
+    parent_.stats().upstream_rq_pool_miss_.inc();
+  } else {
+    parent_.stats().upstream_rq_pool_hit_.inc();
+  }
 
   onUpstreamHostSelected(host);
   host->outlierDetector().putResult(Upstream::Outlier::Result::LocalOriginConnectSuccess);
+  parent_.outstandingRequests().inc(host);
+  outstanding_ = true;
 
   conn_data_ = std::move(conn_data);
-  if (metadata_->getMessageType() == MessageType::Request) {
+  const bool shared = metadata_->getMessageType() == MessageType::Request &&
+                      parent_.sharesRequestConnections();
+  if (metadata_->getMessageType() == MessageType::Request && !shared) {
     conn_data_->addUpstreamCallbacks(parent_.upstreamCallbacks());
   }
   conn_pool_handle_ = nullptr;
@@ -136,8 +176,9 @@ void UpstreamRequest::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn_
       Metadata::HEADER_REAL_SERVER_ADDRESS,
       conn_data_->connection().connectionInfoProvider().remoteAddress()->asString());
 
+  parent_.onUpstreamRequestSent();
   onRequestStart(continue_decoding);
-  encodeData(upstream_request_buffer_);
+  encodeData(upstream_request_buffer_, *conn_data_);
 
   if (metadata_->getMessageType() == MessageType::Stream_Init) {
     // For streaming requests, we handle the following server response message in the stream
@@ -145,6 +186,30 @@ void UpstreamRequest::onPoolReady(Tcp::ConnectionPool::ConnectionDataPtr&& conn_
     // todo change to a more appreciate method name, maybe clearMessage()
     parent_.resetStream();
     parent_.setUpstreamConnection(std::move(conn_data_));
+  } else if (shared) {
+    // The owner reads the response from the connection, which carries its following requests too.
+    parent_.setUpstreamConnection(std::move(conn_data_));
+  }
+  request_complete_ = true;
+}
+
+void UpstreamRequest::onSharedConnection(Tcp::ConnectionPool::ConnectionData& conn_data,
+                                         Upstream::HostDescriptionConstSharedPtr host) {
+  ENVOY_LOG(debug, "meta protocol upstream request: the request shares an upstream connection");
+
+  onUpstreamHostSelected(host);
+  parent_.outstandingRequests().inc(host);
+  outstanding_ = true;
+  metadata_->putString(
+      Metadata::HEADER_REAL_SERVER_ADDRESS,
+      conn_data.connection().connectionInfoProvider().remoteAddress()->asString());
+
+  parent_.onUpstreamRequestSent();
+  onRequestStart(false);
+  encodeData(upstream_request_buffer_, conn_data);
+  if (metadata_->getMessageType() == MessageType::Stream_Init) {
+    // The following stream messages go through the shared connection of the stream.
+    parent_.resetStream();
   }
   request_complete_ = true;
 }
@@ -160,9 +225,17 @@ void UpstreamRequest::onRequestStart(bool continue_decoding) {
 
 void UpstreamRequest::onResponseComplete() {
   response_complete_ = true;
+  onRequestFinished();
   conn_data_.reset();
 }
 
+void UpstreamRequest::onRequestFinished() {
+  if (outstanding_) {
+    outstanding_ = false;
+    parent_.outstandingRequests().dec(*upstream_host_);
+  }
+}
+
 void UpstreamRequest::onUpstreamHostSelected(Upstream::HostDescriptionConstSharedPtr host) {
   ENVOY_LOG(debug, "meta protocol upstream request: selected upstream {}",
             host->address()->asString());
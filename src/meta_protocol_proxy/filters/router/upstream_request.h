@@ -33,7 +33,7 @@ public:
   FilterStatus start();
   void onUpstreamConnectionEvent(Network::ConnectionEvent event);
   void releaseUpStreamConnection(const bool close);
-  void encodeData(Buffer::Instance& data);
+  void encodeData(Buffer::Instance& data, Tcp::ConnectionPool::ConnectionData& conn_data);
   void onRequestStart(bool continue_decoding);
   void onRequestComplete();
   void onResponseComplete();
@@ -46,6 +46,12 @@ public:
   Upstream::HostDescriptionConstSharedPtr upstreamHost() { return upstream_host_; };
 
 private:
+  void onRequestFinished();
+  // Sends the request or stream init message over an upstream connection shared with other
+  // requests or streams.
+  void onSharedConnection(Tcp::ConnectionPool::ConnectionData& conn_data,
+                          Upstream::HostDescriptionConstSharedPtr host);
+
   RequestOwner& parent_;
   Upstream::TcpPoolData& conn_pool_;
   MetadataSharedPtr metadata_;
@@ -60,6 +66,7 @@ private:
   bool response_started_ : 1;
   bool response_complete_ : 1;
   bool stream_reset_ : 1;
+  bool outstanding_ : 1;
 };
 
 } // namespace Router
@@ -0,0 +1,208 @@
+#include "src/meta_protocol_proxy/method_stats.h"
+
+#include <algorithm>
+#include <any>
+#include <utility>
+#include <vector>
+
+#include "source/common/common/macros.h"
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+namespace {
+
+constexpr uint32_t DefaultMaxMethods = 32;
+// The RPCs which get stats by default, as a multiple of the RPCs a worker keeps the stats of.
+constexpr uint32_t DefaultMaxStatNamesFactor = 4;
+// The candidates are considered for the table after this number of requests.
+constexpr uint64_t RebalanceInterval = 1024;
+// A candidate is only promoted if it has certainly been requested this many times since the last
+// rebalance, so that the names which only come once, e.g. random ones, never get stats.
+constexpr uint64_t MinCandidateHits = 8;
+
+const std::string& interfaceKey() { CONSTRUCT_ON_FIRST_USE(std::string, "interface"); }
+const std::string& serviceNameKey() { CONSTRUCT_ON_FIRST_USE(std::string, "service_name"); }
+const std::string& methodKey() { CONSTRUCT_ON_FIRST_USE(std::string, "method"); }
+const std::string& methodNameKey() { CONSTRUCT_ON_FIRST_USE(std::string, "method_name"); }
+
+// The dots separate the elements of a stat name and the colons its tags.
+std::string sanitize(absl::string_view name) {
+  return absl::StrReplaceAll(name, {{".", "_"}, {":", "_"}});
+}
+
+// Views the string in the metadata instead of copying it.
+absl::string_view stringOf(const Metadata& metadata, const std::string& key) {
+  const auto value = metadata.get(key);
+  if (!value.has_value()) {
+    return {};
+  }
+  const auto* string = std::any_cast<std::string>(&value.ref());
+  return string != nullptr ? absl::string_view(*string) : absl::string_view();
+}
+
+absl::string_view firstOf(const Metadata& metadata, const std::string& key,
+                          const std::string& fallback) {
+  const absl::string_view value = stringOf(metadata, key);
+  return value.empty() ? stringOf(metadata, fallback) : value;
+}
+
+} // namespace
+
+MethodStatNames::MethodStatNames(Stats::Scope& scope, const std::string& prefix,
+                                 uint32_t max_names)
+    : scope_(scope), prefix_(prefix), max_names_(max_names) {}
+
+MetaProtocolProxyMethodStatsSharedPtr MethodStatNames::get(const RpcView& rpc) {
+  Thread::LockGuard lock(mutex_);
+  auto iter = stats_.find(rpc);
+  if (iter != stats_.end()) {
+    return iter->second;
+  }
+  if (stats_.size() >= max_names_) {
+    return nullptr;
+  }
+
+  const std::string name =
+      rpc.service_.empty()
+          ? absl::StrCat(prefix_, sanitize(rpc.method_), ".")
+          : absl::StrCat(prefix_, sanitize(rpc.service_), ".", sanitize(rpc.method_), ".");
+  auto stats = std::make_shared<MetaProtocolProxyMethodStats>(
+      MetaProtocolProxyMethodStats::generateStats(name, scope_));
+  stats_.emplace(rpc, stats);
+  return stats;
+}
+
+ThreadLocalMethodStats::ThreadLocalMethodStats(MethodStatNamesSharedPtr names,
+                                               uint32_t max_methods,
+                                               MetaProtocolProxyMethodStatsSharedPtr other)
+    : names_(std::move(names)), max_methods_(max_methods), other_(std::move(other)) {
+  methods_.reserve(max_methods_);
+  candidates_.reserve(max_methods_);
+}
+
+MetaProtocolProxyMethodStatsSharedPtr ThreadLocalMethodStats::requested(const RpcView& rpc) {
+  if (rpc.method_.empty()) {
+    return other_;
+  }
+
+  MetaProtocolProxyMethodStatsSharedPtr stats;
+  auto iter = methods_.find(rpc);
+  if (iter != methods_.end()) {
+    iter->second.hits_++;
+    stats = iter->second.stats_;
+  } else {
+    // Even while the table has room, an RPC has to be requested often enough to get a place.
+    countCandidate(rpc);
+    stats = other_;
+  }
+
+  if (++requests_since_rebalance_ >= RebalanceInterval) {
+    rebalance();
+  }
+  return stats;
+}
+
+void ThreadLocalMethodStats::countCandidate(const RpcView& rpc) {
+  auto iter = candidates_.find(rpc);
+  if (iter != candidates_.end()) {
+    iter->second.hits_++;
+    return;
+  }
+  if (candidates_.size() < max_methods_) {
+    candidates_.emplace(rpc, Candidate{1, 0});
+    return;
+  }
+
+  // The sketch is full, the newcomer replaces the least requested candidate and inherits its
+  // count, which is then the bound of the overestimation of the newcomer. The entry of the evicted
+  // candidate is reused, so that its strings keep their capacity.
+  auto min = std::min_element(candidates_.begin(), candidates_.end(),
+                              [](const auto& lhs, const auto& rhs) {
+                                return lhs.second.hits_ < rhs.second.hits_;
+                              });
+  const uint64_t min_hits = min->second.hits_;
+  auto node = candidates_.extract(min);
+  node.key().service_.assign(rpc.service_.data(), rpc.service_.size());
+  node.key().method_.assign(rpc.method_.data(), rpc.method_.size());
+  node.mapped() = Candidate{min_hits + 1, min_hits};
+  candidates_.insert(std::move(node));
+}
+
+void ThreadLocalMethodStats::rebalance() {
+  requests_since_rebalance_ = 0;
+
+  std::vector<std::pair<const Rpc*, uint64_t>> promotions;
+  promotions.reserve(candidates_.size());
+  for (const auto& candidate : candidates_) {
+    const uint64_t hits = candidate.second.hits_ - candidate.second.error_;
+    if (hits >= MinCandidateHits) {
+      promotions.emplace_back(&candidate.first, hits);
+    }
+  }
+  std::sort(promotions.begin(), promotions.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+
+  // A candidate takes a free place of the table, or the place of the least requested RPC of the
+  // table if it has certainly been requested more often. It stays in the "other" bucket if no more
+  // RPCs may get stats.
+  for (const auto& promotion : promotions) {
+    if (methods_.size() >= max_methods_) {
+      auto min = std::min_element(methods_.begin(), methods_.end(),
+                                  [](const auto& lhs, const auto& rhs) {
+                                    return lhs.second.hits_ < rhs.second.hits_;
+                                  });
+      if (promotion.second <= min->second.hits_) {
+        break;
+      }
+      auto stats = names_->get(promotion.first->view());
+      if (stats == nullptr) {
+        continue;
+      }
+      methods_.erase(min);
+      methods_.emplace(*promotion.first, Method{std::move(stats), promotion.second});
+      continue;
+    }
+    auto stats = names_->get(promotion.first->view());
+    if (stats != nullptr) {
+      methods_.emplace(*promotion.first, Method{std::move(stats), promotion.second});
+    }
+  }
+  candidates_.clear();
+
+  // Age the counts so that the table follows the changes of the traffic.
+  for (auto& method : methods_) {
+    method.second.hits_ /= 2;
+  }
+}
+
+MethodStats::MethodStats(ThreadLocal::SlotAllocator& tls, Stats::Scope& scope,
+                         const std::string& prefix, const MethodStatsConfig& config)
+    : tls_(tls.allocateSlot()) {
+  const uint32_t max_methods = config.max_methods() > 0 ? config.max_methods() : DefaultMaxMethods;
+  const uint32_t max_stat_names = config.max_stat_names() > 0
+                                      ? config.max_stat_names()
+                                      : max_methods * DefaultMaxStatNamesFactor;
+  auto names = std::make_shared<MethodStatNames>(scope, prefix, max_stat_names);
+  auto other = std::make_shared<MetaProtocolProxyMethodStats>(
+      MetaProtocolProxyMethodStats::generateStats(prefix + "other.", scope));
+  tls_->set([names, max_methods,
+             other](Event::Dispatcher&) -> ThreadLocal::ThreadLocalObjectSharedPtr {
+    return std::make_shared<ThreadLocalMethodStats>(names, max_methods, other);
+  });
+}
+
+RpcView MethodStats::rpc(const Metadata& metadata) {
+  return {firstOf(metadata, interfaceKey(), serviceNameKey()),
+          firstOf(metadata, methodKey(), methodNameKey())};
+}
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "envoy/stats/scope.h"
+#include "envoy/thread_local/thread_local.h"
+
+#include "source/common/common/thread.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
+#include "api/meta_protocol_proxy/v1alpha/meta_protocol_proxy.pb.h"
+#include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/stats.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+using MethodStatsConfig = aeraki::meta_protocol_proxy::v1alpha::MethodStats;
+
+/**
+ * The RPC of a request, the views point into the metadata of the request. The service is empty if
+ * the codec only tells the method.
+ */
+struct RpcView {
+  absl::string_view service_;
+  absl::string_view method_;
+};
+
+/**
+ * An RPC kept by the tables, it's looked up by an RpcView without building a string.
+ */
+struct Rpc {
+  Rpc(const RpcView& rpc) : service_(rpc.service_), method_(rpc.method_) {}
+
+  RpcView view() const { return {service_, method_}; }
+
+  std::string service_;
+  std::string method_;
+};
+
+struct RpcHash {
+  using is_transparent = void;
+
+  size_t operator()(const RpcView& rpc) const {
+    return absl::Hash<std::pair<absl::string_view, absl::string_view>>()(
+        {rpc.service_, rpc.method_});
+  }
+  size_t operator()(const Rpc& rpc) const { return (*this)(rpc.view()); }
+};
+
+struct RpcEq {
+  using is_transparent = void;
+
+  static bool equal(const RpcView& lhs, const RpcView& rhs) {
+    return lhs.service_ == rhs.service_ && lhs.method_ == rhs.method_;
+  }
+  template <class L, class R> bool operator()(const L& lhs, const R& rhs) const {
+    return equal(view(lhs), view(rhs));
+  }
+
+private:
+  static RpcView view(const RpcView& rpc) { return rpc; }
+  static RpcView view(const Rpc& rpc) { return rpc.view(); }
+};
+
+template <class T> using RpcMap = absl::flat_hash_map<Rpc, T, RpcHash, RpcEq>;
+
+/**
+ * MethodStatNames creates the stats of the RPCs for all the workers, up to a maximum number of
+ * RPCs. It's only used when an RPC is promoted to the table of a worker, which is rare.
+ */
+class MethodStatNames {
+public:
+  MethodStatNames(Stats::Scope& scope, const std::string& prefix, uint32_t max_names);
+
+  /**
+   * @return the stats of the RPC, or nullptr if it has no stats and the maximum number of RPCs
+   *         have stats already.
+   */
+  MetaProtocolProxyMethodStatsSharedPtr get(const RpcView& rpc);
+
+private:
+  Stats::Scope& scope_;
+  const std::string prefix_;
+  const uint32_t max_names_;
+  Thread::MutexBasicLockable mutex_;
+  RpcMap<MetaProtocolProxyMethodStatsSharedPtr> stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+using MethodStatNamesSharedPtr = std::shared_ptr<MethodStatNames>;
+
+/**
+ * ThreadLocalMethodStats hands out the stats of the most requested RPCs of a worker. The RPCs
+ * which don't have a place in the table share the stats of the "other" bucket, while a fixed size
+ * space-saving sketch counts their requests so that an RPC which becomes popular takes the place
+ * of the least requested one.
+ */
+class ThreadLocalMethodStats : public ThreadLocal::ThreadLocalObject {
+public:
+  ThreadLocalMethodStats(MethodStatNamesSharedPtr names, uint32_t max_methods,
+                         MetaProtocolProxyMethodStatsSharedPtr other);
+
+  /**
+   * Count a request of an RPC.
+   * @param rpc supplies the RPC, @see MethodStats::rpc.
+   * @return the stats of the RPC, or the stats of the "other" bucket if the RPC isn't in the table.
+   */
+  MetaProtocolProxyMethodStatsSharedPtr requested(const RpcView& rpc);
+
+private:
+  struct Method {
+    MetaProtocolProxyMethodStatsSharedPtr stats_;
+    uint64_t hits_{};
+  };
+
+  // A candidate has been requested at least hits_ - error_ times since the last rebalance.
+  struct Candidate {
+    uint64_t hits_{};
+    uint64_t error_{};
+  };
+
+  void countCandidate(const RpcView& rpc);
+  void rebalance();
+
+  const MethodStatNamesSharedPtr names_;
+  const uint32_t max_methods_;
+  const MetaProtocolProxyMethodStatsSharedPtr other_;
+  RpcMap<Method> methods_;
+  RpcMap<Candidate> candidates_;
+  uint64_t requests_since_rebalance_{};
+};
+
+/**
+ * MethodStats is shared by all the workers, each of them owns its table of RPCs. The stats are
+ * emitted under <prefix>method.<RPC>., the stats of an RPC evicted from a table stay in the store
+ * and keep going if the RPC comes back. At most max_stat_names RPCs ever get stats, the requests
+ * of the others are counted in the "other" bucket.
+ */
+class MethodStats {
+public:
+  MethodStats(ThreadLocal::SlotAllocator& tls, Stats::Scope& scope, const std::string& prefix,
+              const MethodStatsConfig& config);
+
+  ThreadLocalMethodStats& local() { return tls_->getTyped<ThreadLocalMethodStats>(); }
+
+  /**
+   * @return RpcView the RPC of a request: the service (the Dubbo interface or the bRPC service
+   *         name) and the method, the method is empty if the codec doesn't tell it.
+   */
+  static RpcView rpc(const Metadata& metadata);
+
+private:
+  ThreadLocal::SlotPtr tls_;
+};
+
+using MethodStatsPtr = std::unique_ptr<MethodStats>;
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
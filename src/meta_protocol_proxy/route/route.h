@@ -7,6 +7,7 @@
 
 #include "src/meta_protocol_proxy/codec/codec.h"
 #include "src/meta_protocol_proxy/route/hash_policy.h"
+#include "src/meta_protocol_proxy/route/route_stats.h"
 
 namespace Envoy {
 namespace Extensions {
@@ -75,6 +76,17 @@ public:
    */
   virtual const std::vector<std::shared_ptr<RequestMirrorPolicy>>&
   requestMirrorPolicies() const PURE;
+
+  /**
+   * @return const RouteStats& the stats of the route, they're resolved when the route is loaded.
+   */
+  virtual const RouteStats& routeStats() const PURE;
+
+  /**
+   * @return const ClusterStats& the stats of the upstream cluster, they're resolved when the route
+   * is loaded.
+   */
+  virtual const ClusterStats& clusterStats() const PURE;
 };
 
 using RouteEntryPtr = std::shared_ptr<RouteEntry>;
@@ -31,20 +31,26 @@ bool RequestMirrorPolicyImpl::shouldShadow(Runtime::Loader& runtime, uint64_t st
 }
 
 RouteEntryImplBase::RouteEntryImplBase(
-    const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route)
+    const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route,
+    const std::string& stat_prefix, Stats::Scope& scope)
     : cluster_name_(route.route().cluster()),
       config_headers_(Http::HeaderUtility::buildHeaderDataVector(route.match().metadata())),
-      mirror_policies_(buildMirrorPolicies(route.route())) {
+      mirror_policies_(buildMirrorPolicies(route.route())),
+      route_stats_(RouteStats::generateStats(stat_prefix, scope)) {
   if (route.route().cluster_specifier_case() ==
       aeraki::meta_protocol_proxy::config::route::v1alpha::RouteAction::ClusterSpecifierCase::
           kWeightedClusters) {
     total_cluster_weight_ = 0UL;
     for (const auto& cluster : route.route().weighted_clusters().clusters()) {
-      weighted_clusters_.emplace_back(std::make_shared<WeightedClusterEntry>(*this, cluster));
+      weighted_clusters_.emplace_back(
+          std::make_shared<WeightedClusterEntry>(*this, cluster, scope));
       total_cluster_weight_ += weighted_clusters_.back()->clusterWeight();
     }
     ENVOY_LOG(debug, "meta protocol route matcher: weighted_clusters_size {}",
               weighted_clusters_.size());
+  } else {
+    cluster_stats_ =
+        std::make_unique<const ClusterStats>(ClusterStats::generateStats(cluster_name_, scope));
   }
 
   for (const auto& keyValue : route.request_mutation()) {
@@ -128,13 +134,16 @@ bool RouteEntryImplBase::headersMatch(const Metadata& metadata) const {
 }
 
 RouteEntryImplBase::WeightedClusterEntry::WeightedClusterEntry(const RouteEntryImplBase& parent,
-                                                               const WeightedCluster& cluster)
+                                                               const WeightedCluster& cluster,
+                                                               Stats::Scope& scope)
     : parent_(parent), cluster_name_(cluster.name()),
-      cluster_weight_(PROTOBUF_GET_WRAPPED_REQUIRED(cluster, weight)) {}
+      cluster_weight_(PROTOBUF_GET_WRAPPED_REQUIRED(cluster, weight)),
+      cluster_stats_(ClusterStats::generateStats(cluster_name_, scope)) {}
 
 RouteEntryImpl::RouteEntryImpl(
-    const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route)
-    : RouteEntryImplBase(route) {}
+    const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route,
+    const std::string& stat_prefix, Stats::Scope& scope)
+    : RouteEntryImplBase(route, stat_prefix, scope) {}
 
 RouteEntryImpl::~RouteEntryImpl() = default;
 
@@ -147,13 +156,18 @@ RouteConstSharedPtr RouteEntryImpl::matches(const Metadata& metadata, uint64_t r
   return clusterEntry(random_value);
 }
 
-RouteMatcherImpl::RouteMatcherImpl(
-    const RouteConfig& config,
-    Server::Configuration::ServerFactoryContext&) { // TODO remove ServerFactoryContext parameter
+RouteMatcherImpl::RouteMatcherImpl(const RouteConfig& config,
+                                   Server::Configuration::ServerFactoryContext& context) {
   using aeraki::meta_protocol_proxy::config::route::v1alpha::RouteMatch;
 
-  for (const auto& route : config.routes()) {
-    routes_.emplace_back(std::make_shared<RouteEntryImpl>(route));
+  // The stats are resolved here so that the router doesn't look them up by name for each request,
+  // the routes without a name are told by their position.
+  for (int i = 0; i < config.routes_size(); i++) {
+    const auto& route = config.routes(i);
+    const std::string stat_prefix =
+        fmt::format("meta_protocol.route.{}.{}.", config.name(),
+                    route.name().empty() ? fmt::format("route_{}", i) : route.name());
+    routes_.emplace_back(std::make_shared<RouteEntryImpl>(route, stat_prefix, context.scope()));
   }
   ENVOY_LOG(debug, "meta protocol route matcher: routes list size {}", routes_.size());
 }
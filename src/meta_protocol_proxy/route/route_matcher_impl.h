@@ -10,6 +10,7 @@
 
 #include "api/meta_protocol_proxy/config/route/v1alpha/route.pb.h"
 
+#include "source/common/common/assert.h"
 #include "source/common/common/logger.h"
 #include "source/common/common/matchers.h"
 #include "source/common/http/header_utility.h"
@@ -47,7 +48,8 @@ class RouteEntryImplBase : public RouteEntry,
                            public std::enable_shared_from_this<RouteEntryImplBase>,
                            public Logger::Loggable<Logger::Id::filter> {
 public:
-  RouteEntryImplBase(const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route);
+  RouteEntryImplBase(const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route,
+                     const std::string& stat_prefix, Stats::Scope& scope);
   ~RouteEntryImplBase() override = default;
 
   // Router::RouteEntry
@@ -61,6 +63,13 @@ public:
   const std::vector<std::shared_ptr<RequestMirrorPolicy>>& requestMirrorPolicies() const override {
     return mirror_policies_;
   }
+  const RouteStats& routeStats() const override { return route_stats_; }
+  // A route with weighted clusters is never returned itself, clusterEntry returns one of its
+  // weighted clusters, which have their own stats.
+  const ClusterStats& clusterStats() const override {
+    ASSERT(cluster_stats_ != nullptr);
+    return *cluster_stats_;
+  }
 
   // Router::Route
   const RouteEntry* routeEntry() const override;
@@ -75,7 +84,8 @@ private:
   class WeightedClusterEntry : public RouteEntry, public Route {
   public:
     using WeightedCluster = envoy::config::route::v3::WeightedCluster::ClusterWeight;
-    WeightedClusterEntry(const RouteEntryImplBase& parent, const WeightedCluster& cluster);
+    WeightedClusterEntry(const RouteEntryImplBase& parent, const WeightedCluster& cluster,
+                         Stats::Scope& scope);
 
     uint64_t clusterWeight() const { return cluster_weight_; }
 
@@ -96,6 +106,8 @@ private:
     requestMirrorPolicies() const override {
       return parent_.requestMirrorPolicies();
     }
+    const RouteStats& routeStats() const override { return parent_.routeStats(); }
+    const ClusterStats& clusterStats() const override { return cluster_stats_; }
 
     // Router::Route
     const RouteEntry* routeEntry() const override { return this; }
@@ -105,6 +117,7 @@ private:
     const std::string cluster_name_;
     const uint64_t cluster_weight_;
     Envoy::Router::MetadataMatchCriteriaConstPtr metadata_match_criteria_;
+    const ClusterStats cluster_stats_;
   };
 
   using WeightedClusterEntrySharedPtr = std::shared_ptr<WeightedClusterEntry>;
@@ -136,13 +149,17 @@ private:
   Envoy::Router::MetadataMatchCriteriaConstPtr metadata_match_criteria_;
   std::unique_ptr<const HashPolicy> hash_policy_;
   const std::vector<std::shared_ptr<RequestMirrorPolicy>> mirror_policies_;
+  const RouteStats route_stats_;
+  // Only set if the route has a single cluster, @see clusterStats.
+  std::unique_ptr<const ClusterStats> cluster_stats_;
 };
 
 using RouteEntryImplBaseConstSharedPtr = std::shared_ptr<const RouteEntryImplBase>;
 
 class RouteEntryImpl : public RouteEntryImplBase {
 public:
-  RouteEntryImpl(const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route);
+  RouteEntryImpl(const aeraki::meta_protocol_proxy::config::route::v1alpha::Route& route,
+                 const std::string& stat_prefix, Stats::Scope& scope);
   ~RouteEntryImpl() override;
 
   // RoutEntryImplBase
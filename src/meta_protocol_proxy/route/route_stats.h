@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+
+#include "envoy/stats/scope.h"
+#include "envoy/stats/stats_macros.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Route {
+
+/**
+ * The stats of a route, emitted under meta_protocol.route.<route_config>.<route>.
+ * @see stats_macros.h
+ */
+#define ALL_ROUTE_STATS(COUNTER, HISTOGRAM)                                                        \
+  COUNTER(rq_total)                                                                                \
+  COUNTER(upstream_rq_pool_overflow)                                                               \
+  COUNTER(upstream_rq_pool_local_cx_failure)                                                       \
+  COUNTER(upstream_rq_pool_remote_cx_failure)                                                      \
+  COUNTER(upstream_rq_pool_timeout)                                                                \
+  HISTOGRAM(upstream_rq_time, Milliseconds)
+
+/**
+ * Struct definition for the stats of a route. @see stats_macros.h
+ */
+struct RouteStats {
+  ALL_ROUTE_STATS(GENERATE_COUNTER_STRUCT, GENERATE_HISTOGRAM_STRUCT)
+
+  static RouteStats generateStats(const std::string& prefix, Stats::Scope& scope) {
+    return RouteStats{
+        ALL_ROUTE_STATS(POOL_COUNTER_PREFIX(scope, prefix), POOL_HISTOGRAM_PREFIX(scope, prefix))};
+  }
+};
+
+/**
+ * The stats of an upstream cluster of the routes, emitted under meta_protocol.cluster.<cluster>.
+ * The response stats tell the response status of the application protocol, an exception is a
+ * successful response carrying an application error. @see stats_macros.h
+ */
+#define ALL_ROUTE_CLUSTER_STATS(COUNTER, HISTOGRAM)                                                \
+  COUNTER(upstream_rq_total)                                                                       \
+  COUNTER(upstream_rsp_success)                                                                    \
+  COUNTER(upstream_rsp_exception)                                                                  \
+  COUNTER(upstream_rsp_error)                                                                      \
+  HISTOGRAM(upstream_rq_time, Milliseconds)
+
+/**
+ * Struct definition for the stats of an upstream cluster. @see stats_macros.h
+ */
+struct ClusterStats {
+  ALL_ROUTE_CLUSTER_STATS(GENERATE_COUNTER_STRUCT, GENERATE_HISTOGRAM_STRUCT)
+
+  static ClusterStats generateStats(const std::string& cluster_name, Stats::Scope& scope) {
+    const std::string prefix = "meta_protocol.cluster." + cluster_name + ".";
+    return ClusterStats{ALL_ROUTE_CLUSTER_STATS(POOL_COUNTER_PREFIX(scope, prefix),
+                                                POOL_HISTOGRAM_PREFIX(scope, prefix))};
+  }
+};
+
+} // namespace Route
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
+#include "envoy/common/time.h"
 #include "envoy/stats/scope.h"
 #include "envoy/stats/stats_macros.h"
 
@@ -26,6 +28,7 @@ namespace MetaProtocolProxy {
   COUNTER(request_oneway)                                                                          \
   COUNTER(request_twoway)                                                                          \
   COUNTER(request_stream)                                                                          \
+  COUNTER(request_too_large)                                                                       \
   COUNTER(response)                                                                                \
   COUNTER(response_business_exception)                                                             \
   COUNTER(response_decoding_error)                                                                 \
@@ -33,7 +36,21 @@ namespace MetaProtocolProxy {
   COUNTER(response_error)                                                                          \
   COUNTER(response_error_caused_connection_close)                                                  \
   COUNTER(response_success)                                                                        \
+  COUNTER(stream_flow_control_paused_reading)                                                      \
+  COUNTER(stream_flow_control_resumed_reading)                                                     \
+  COUNTER(stream_idle_timeout)                                                                     \
+  COUNTER(stream_max_duration_reached)                                                             \
+  COUNTER(stream_multiplexed)                                                                      \
+  COUNTER(stream_overflow)                                                                         \
+  COUNTER(stream_total)                                                                            \
+  COUNTER(stream_upstream_close)                                                                   \
   GAUGE(request_active, Accumulate)                                                                \
+  GAUGE(request_buffered_bytes, Accumulate)                                                        \
+  GAUGE(request_partial_frame, Accumulate)                                                         \
+  GAUGE(stream_active, Accumulate)                                                                 \
+  GAUGE(stream_upstream_cx_shared, Accumulate)                                                     \
+  HISTOGRAM(request_size_bytes, Bytes)                                                             \
+  HISTOGRAM(response_size_bytes, Bytes)                                                            \
   HISTOGRAM(request_time_ms, Milliseconds)                                                         \
   COUNTER(idle_timeout)                                                                            
 
@@ -51,6 +68,67 @@ struct MetaProtocolProxyStats {
   }
 };
 
+/**
+ * The microsecond latency of the phases of a request, they're only recorded if enabled in the
+ * config since each phase costs two clock reads. @see stats_macros.h
+ */
+#define ALL_META_PROTOCOL_PROXY_PHASE_STATS(HISTOGRAM)                                             \
+  HISTOGRAM(downstream_decode_us, Microseconds)                                                    \
+  HISTOGRAM(decoder_filters_us, Microseconds)                                                      \
+  HISTOGRAM(upstream_cx_acquire_us, Microseconds)                                                  \
+  HISTOGRAM(upstream_first_byte_us, Microseconds)                                                  \
+  HISTOGRAM(upstream_response_decode_us, Microseconds)                                             \
+  HISTOGRAM(upstream_response_encode_us, Microseconds)                                             \
+  HISTOGRAM(downstream_write_queue_us, Microseconds)
+
+/**
+ * Struct definition for the request phase stats. @see stats_macros.h
+ */
+struct MetaProtocolProxyPhaseStats {
+  ALL_META_PROTOCOL_PROXY_PHASE_STATS(GENERATE_HISTOGRAM_STRUCT)
+
+  static MetaProtocolProxyPhaseStats generateStats(const std::string& prefix,
+                                                   Stats::Scope& scope) {
+    return MetaProtocolProxyPhaseStats{
+        ALL_META_PROTOCOL_PROXY_PHASE_STATS(POOL_HISTOGRAM_PREFIX(scope, prefix))};
+  }
+
+  /**
+   * Record the microseconds elapsed since the start of a phase.
+   */
+  static void recordSince(Stats::Histogram& histogram, MonotonicTime start,
+                          TimeSource& time_source) {
+    histogram.recordValue(std::chrono::duration_cast<std::chrono::microseconds>(
+                              time_source.monotonicTime() - start)
+                              .count());
+  }
+};
+
+/**
+ * The stats of a single RPC, @see MethodStats for how their number is bounded. @see stats_macros.h
+ */
+#define ALL_META_PROTOCOL_PROXY_METHOD_STATS(COUNTER, HISTOGRAM)                                   \
+  COUNTER(request)                                                                                 \
+  COUNTER(response_success)                                                                        \
+  COUNTER(response_error)                                                                          \
+  COUNTER(local_response)                                                                          \
+  HISTOGRAM(request_time_ms, Milliseconds)
+
+/**
+ * Struct definition for the stats of an RPC. @see stats_macros.h
+ */
+struct MetaProtocolProxyMethodStats {
+  ALL_META_PROTOCOL_PROXY_METHOD_STATS(GENERATE_COUNTER_STRUCT, GENERATE_HISTOGRAM_STRUCT)
+
+  static MetaProtocolProxyMethodStats generateStats(const std::string& prefix,
+                                                    Stats::Scope& scope) {
+    return MetaProtocolProxyMethodStats{ALL_META_PROTOCOL_PROXY_METHOD_STATS(
+        POOL_COUNTER_PREFIX(scope, prefix), POOL_HISTOGRAM_PREFIX(scope, prefix))};
+  }
+};
+
+using MetaProtocolProxyMethodStatsSharedPtr = std::shared_ptr<MetaProtocolProxyMethodStats>;
+
 } // namespace MetaProtocolProxy
 } // namespace NetworkFilters
 } // namespace Extensions
@@ -1,6 +1,8 @@
 #include "src/meta_protocol_proxy/stream.h"
 #include "src/meta_protocol_proxy/conn_manager.h"
 #include "src/meta_protocol_proxy/codec_impl.h"
+#include "src/meta_protocol_proxy/stream_multiplexer.h"
+#include "src/meta_protocol_proxy/write_batcher.h"
 
 #include "envoy/network/connection.h"
 
@@ -10,14 +12,45 @@ namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
 Stream::Stream(uint64_t stream_id, Network::Connection& downstream_conn,
-               ConnectionManager& connection_manager, Codec& codec)
+               ConnectionManager& connection_manager, const StreamLimits& limits)
     : stream_id_(stream_id), downstream_conn_(downstream_conn),
-      connection_manager_(connection_manager), codec_(codec){};
+      connection_manager_(connection_manager), codec_(connection_manager.config().createCodec()),
+      time_source_(connection_manager.timeSystem()), idle_timeout_(limits.idle_timeout_),
+      last_activity_(time_source_.monotonicTime()), buffer_limit_(limits.buffer_limit_) {
+  if (buffer_limit_ > 0) {
+    credits_ = std::make_shared<Credits>(Credits{this, 0});
+  }
+  if (idle_timeout_.has_value()) {
+    idle_timer_ = downstream_conn_.dispatcher().createTimer([this]() { onIdleTimeout(); });
+    idle_timer_->enableTimer(idle_timeout_.value());
+  }
+  if (limits.max_duration_.has_value()) {
+    max_duration_timer_ =
+        downstream_conn_.dispatcher().createTimer([this]() { onMaxDuration(); });
+    max_duration_timer_->enableTimer(limits.max_duration_.value());
+  }
+}
 
-void Stream::send2upstream(Buffer::Instance& data) {
+Stream::~Stream() {
+  ENVOY_LOG(trace, "meta protocol: stream {} destroyed", stream_id_);
+  // The stream is only destructed without being closed along with the connection manager.
+  closed_ = true;
+  if (credits_ != nullptr) {
+    credits_->stream_ = nullptr;
+  }
   if (upstream_conn_data_ != nullptr) {
+    upstream_conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+}
+
+void Stream::send2upstream(Buffer::Instance& data) {
+  onActivity();
+  auto* conn_data = upstreamConnData();
+  if (conn_data != nullptr) {
     ENVOY_LOG(debug, "meta protocol: send downstream request to stream {}", stream_id_);
-    upstream_conn_data_->connection().write(data, false);
+    // Go through the connection's batcher so the stream frames keep their order with the
+    // stream init request.
+    WriteBatcher::upstream(*conn_data).write(data, false);
   } else {
     ENVOY_LOG(error, "meta protocol: no upstream connection for stream {}, can't send message",
               stream_id_);
@@ -27,46 +60,229 @@ void Stream::send2upstream(Buffer::Instance& data) {
 void Stream::send2downstream(Buffer::Instance& data, bool end_stream) {
   ENVOY_LOG(debug, "meta protocol: send upstream response to stream {}", stream_id_);
   while (data.length() > 0) {
-    auto metadata = std::make_unique<MetadataImpl>();
-    metadata->setMessageType(MessageType::Response);
-    DecodeStatus status = codec_.decode(data, *metadata);
+    frame_.reset();
+    frame_.setMessageType(MessageType::Response);
+    DecodeStatus status = codec_->decodeFrame(data, frame_);
     if (status == DecodeStatus::WaitForData) {
       ENVOY_LOG(debug, "meta protocol: response wait for data {}", stream_id_);
       return;
     }
-    downstream_conn_.write(metadata->originMessage(), end_stream);
-    if (metadata->getMessageType() == MessageType::Stream_Close_One_Way) {
-      ENVOY_LOG(debug, "meta protocol: close server side stream {}", stream_id_);
-      closeServerStream();
-    }
-    if (metadata->getMessageType() == MessageType::Stream_Close_Two_Way) {
-      ENVOY_LOG(debug, "meta protocol: close the entire stream {}", stream_id_);
-      closeClientStream();
-      closeServerStream();
-    }
-    // According to tRPC protocol, a server close frame means the stream is closed.
-    if (end_stream || (server_closed_)) {
-      clear();
+    if (!onUpstreamFrame(frame_, end_stream)) {
+      data.drain(data.length());
+      return;
     }
   }
 }
 
-void Stream::clear() {
+bool Stream::onUpstreamFrame(Metadata& metadata, bool end_stream) {
+  onActivity();
+  if (downstream_conn_.state() != Network::Connection::State::Open) {
+    ENVOY_LOG(debug, "meta protocol: downstream has closed, drop the response of stream {}",
+              stream_id_);
+    return false;
+  }
+  if (credits_ != nullptr) {
+    consumeCredits(metadata.originMessage());
+  }
+  connection_manager_.downstreamWriteBatcher().write(metadata.originMessage(), end_stream);
+  if (metadata.getMessageType() == MessageType::Stream_Close_One_Way) {
+    ENVOY_LOG(debug, "meta protocol: close server side stream {}", stream_id_);
+    closeServerStream();
+  }
+  if (metadata.getMessageType() == MessageType::Stream_Close_Two_Way) {
+    ENVOY_LOG(debug, "meta protocol: close the entire stream {}", stream_id_);
+    closeClientStream();
+    closeServerStream();
+  }
+  // According to tRPC protocol, a server close frame means the stream is closed.
+  if (end_stream || (server_closed_)) {
+    close(end_stream);
+    return false;
+  }
+  return true;
+}
+
+void Stream::close(bool reset_upstream) {
+  if (closed_) {
+    return;
+  }
   ENVOY_LOG(debug, "meta protocol: close the entire stream {}", stream_id_);
-  upstream_conn_data_->connection().removeConnectionCallbacks(*this);
-  // In theory, we don't have to reset the unique prt, since it will be deleted automatically after
-  // stream being deleted from the connection manager. Just do it for safety.
-  upstream_conn_data_.reset();
+  // Closing the upstream connection raises a close event, which is ignored once closed_ is set.
+  closed_ = true;
+  if (idle_timer_ != nullptr) {
+    idle_timer_->disableTimer();
+  }
+  if (max_duration_timer_ != nullptr) {
+    max_duration_timer_->disableTimer();
+  }
+  if (credits_ != nullptr) {
+    credits_->stream_ = nullptr;
+  }
+  if (downstream_paused_) {
+    downstream_paused_ = false;
+    if (downstream_conn_.state() == Network::Connection::State::Open) {
+      downstream_conn_.readDisable(false);
+    }
+  }
+  if (shared_conn_ != nullptr) {
+    // The other streams keep using the connection.
+    resumeUpstream();
+    shared_conn_->removeStream(stream_id_, !reset_upstream);
+    shared_conn_ = nullptr;
+  } else if (upstream_conn_data_ != nullptr) {
+    if (reset_upstream) {
+      upstream_conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+    } else {
+      resumeUpstream();
+    }
+    // The connection goes back to the pool if the stream has completed.
+    upstream_conn_data_.reset();
+  }
   connection_manager_.closeStream(stream_id_);
 }
 
 void Stream::setUpstreamConn(Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data) {
   upstream_conn_data_ = std::move(upstream_conn_data);
   upstream_conn_data_->addUpstreamCallbacks(*this);
+  onUpstreamReady();
+}
+
+void Stream::setSharedConn(SharedStreamConnection& shared_conn) {
+  shared_conn_ = &shared_conn;
+  onUpstreamReady();
+}
+
+void Stream::onUpstreamReady() {
+  if (connection_manager_.downstreamAboveHighWatermark()) {
+    downstream_congested_ = true;
+  }
+  // The stream may have been paused before it got its upstream connection.
+  for (const bool paused : {downstream_congested_, credits_exhausted_}) {
+    if (paused) {
+      upstreamConnData()->connection().readDisable(true);
+    }
+  }
+}
+
+Tcp::ConnectionPool::ConnectionData* Stream::upstreamConnData() {
+  if (shared_conn_ != nullptr) {
+    return &shared_conn_->connectionData();
+  }
+  return upstream_conn_data_.get();
+}
+
+void Stream::onAboveWriteBufferHighWatermark() {
+  WriteBatcher::upstream(*upstream_conn_data_).onAboveWriteBufferHighWatermark();
+  pauseDownstream(true);
+}
+
+void Stream::onBelowWriteBufferLowWatermark() {
+  pauseDownstream(false);
+  WriteBatcher::upstream(*upstream_conn_data_).onBelowWriteBufferLowWatermark();
+}
+
+void Stream::pauseDownstream(bool pause) {
+  if (downstream_paused_ == pause || closed_) {
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol: the upstream of stream {} is {} its watermark", stream_id_,
+            pause ? "above" : "below");
+  downstream_paused_ = pause;
+  downstream_conn_.readDisable(pause);
+  if (pause) {
+    connection_manager_.stats().stream_flow_control_paused_reading_.inc();
+  } else {
+    connection_manager_.stats().stream_flow_control_resumed_reading_.inc();
+  }
+}
+
+void Stream::consumeCredits(Buffer::Instance& frame) {
+  const uint64_t length = frame.length();
+  credits_->in_flight_ += length;
+  // The tracker is called once the frame has been written to the socket, or dropped.
+  frame.addDrainTracker([credits = credits_, length]() {
+    credits->in_flight_ -= length;
+    if (credits->stream_ != nullptr) {
+      credits->stream_->onCreditsReturned();
+    }
+  });
+  if (credits_->in_flight_ >= buffer_limit_) {
+    ENVOY_LOG(debug, "meta protocol: stream {} has {} bytes in flight, pause the upstream",
+              stream_id_, credits_->in_flight_);
+    pauseUpstream(credits_exhausted_, true);
+  }
+}
+
+void Stream::onCreditsReturned() {
+  // Resume at half of the limit so that the upstream isn't toggled for each frame.
+  if (credits_exhausted_ && credits_->in_flight_ <= buffer_limit_ / 2) {
+    pauseUpstream(credits_exhausted_, false);
+  }
+}
+
+void Stream::pauseUpstream(bool& reason, bool pause) {
+  if (reason == pause || closed_) {
+    return;
+  }
+  reason = pause;
+  auto* conn_data = upstreamConnData();
+  if (conn_data == nullptr || conn_data->connection().state() != Network::Connection::State::Open) {
+    return;
+  }
+  conn_data->connection().readDisable(pause);
+  if (pause) {
+    connection_manager_.stats().stream_flow_control_paused_reading_.inc();
+  } else {
+    connection_manager_.stats().stream_flow_control_resumed_reading_.inc();
+  }
+}
+
+void Stream::resumeUpstream() {
+  // A connection released to the pool or shared with other streams must be readable.
+  auto& connection = upstreamConnData()->connection();
+  for (bool* reason : {&downstream_congested_, &credits_exhausted_}) {
+    if (*reason && connection.state() == Network::Connection::State::Open) {
+      connection.readDisable(false);
+    }
+    *reason = false;
+  }
+}
+
+void Stream::onEvent(Network::ConnectionEvent event) {
+  if (event == Network::ConnectionEvent::RemoteClose ||
+      event == Network::ConnectionEvent::LocalClose) {
+    onUpstreamClose();
+  }
+}
+
+void Stream::onUpstreamClose() {
+  if (closed_) {
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol: the upstream connection of stream {} has been closed",
+            stream_id_);
+  connection_manager_.stats().stream_upstream_close_.inc();
+  upstream_conn_data_.reset();
+  shared_conn_ = nullptr;
+  close(false);
+}
+
+void Stream::onIdleTimeout() {
+  const auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(
+      time_source_.monotonicTime() - last_activity_);
+  if (idle < idle_timeout_.value()) {
+    idle_timer_->enableTimer(idle_timeout_.value() - idle);
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol: stream {} idle timeout", stream_id_);
+  connection_manager_.stats().stream_idle_timeout_.inc();
+  close(true);
 }
 
-void Stream::onEvent(Network::ConnectionEvent) {
-  // todo clean stream resource when connection has been closed
+void Stream::onMaxDuration() {
+  ENVOY_LOG(debug, "meta protocol: stream {} max duration reached", stream_id_);
+  connection_manager_.stats().stream_max_duration_reached_.inc();
+  close(true);
 }
 
 } // namespace  MetaProtocolProxy
@@ -1,49 +1,149 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
+
+#include "envoy/common/time.h"
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/event/timer.h"
 #include "envoy/network/connection.h"
 #include "source/common/buffer/buffer_impl.h"
 #include "source/common/common/logger.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
 #include "src/meta_protocol_proxy/route/route.h"
 
+#include "absl/types/optional.h"
+
 namespace Envoy {
 namespace Extensions {
 namespace NetworkFilters {
 namespace MetaProtocolProxy {
 
 class ConnectionManager;
+class SharedStreamConnection;
+
+/**
+ * The limits of the streams of a downstream connection.
+ */
+struct StreamLimits {
+  // A stream without any message in either direction for this long is closed.
+  absl::optional<std::chrono::milliseconds> idle_timeout_;
+  // A stream is closed once it has lasted this long.
+  absl::optional<std::chrono::milliseconds> max_duration_;
+  // The maximum number of concurrent streams, 0 means no limit.
+  uint32_t max_streams_{};
+  // The bytes a stream may have written to the downstream and not sent yet, 0 means no limit.
+  uint32_t buffer_limit_{};
+  // The streams sharing an upstream connection, 0 or 1 means a connection per stream.
+  uint32_t max_streams_per_upstream_connection_{};
+};
 
 // Stream tracks a streaming RPC, multiple requests and responses can be sent inside a stream.
-class Stream : Tcp::ConnectionPool::UpstreamCallbacks,
-               Event::DeferredDeletable,
+class Stream : public Tcp::ConnectionPool::UpstreamCallbacks,
+               public Event::DeferredDeletable,
                Logger::Loggable<Logger::Id::filter> {
 public:
   Stream(uint64_t stream_id, Network::Connection& downstream_conn,
-         ConnectionManager& connection_manager, Codec& codec);
-  ~Stream() = default;
+         ConnectionManager& connection_manager, const StreamLimits& limits);
+  ~Stream() override;
 
   // UpstreamCallbacks
   void onUpstreamData(Buffer::Instance& data, bool end_stream) override {
     send2downstream(data, end_stream);
-  } // todo: we need to close the stream
+  }
   void onEvent(Network::ConnectionEvent event) override;
-  void onAboveWriteBufferHighWatermark() override {}
-  void onBelowWriteBufferLowWatermark() override {}
+  void onAboveWriteBufferHighWatermark() override;
+  void onBelowWriteBufferLowWatermark() override;
 
   void send2upstream(Buffer::Instance& data);
   void send2downstream(Buffer::Instance& data, bool end_stream);
   void setUpstreamConn(Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data);
+  void setSharedConn(SharedStreamConnection& shared_conn);
+  uint64_t streamId() const { return stream_id_; }
   void closeClientStream() { client_closed_ = true; }
   void closeServerStream() { server_closed_ = true; }
 
+  /**
+   * The write buffer of the downstream connection has gone above its high watermark, stop reading
+   * the upstream until it goes below its low watermark.
+   */
+  void onDownstreamAboveHighWatermark() { pauseUpstream(downstream_congested_, true); }
+  void onDownstreamBelowLowWatermark() { pauseUpstream(downstream_congested_, false); }
+
+  /**
+   * Stop reading the downstream while the write buffer of the upstream connection is above its
+   * high watermark.
+   */
+  void pauseDownstream(bool pause);
+
+  /**
+   * Forward a frame of the upstream to the downstream.
+   * @param metadata supplies the decoded frame.
+   * @param end_stream supplies whether the upstream has closed the connection.
+   * @return bool whether the stream is still open.
+   */
+  bool onUpstreamFrame(Metadata& metadata, bool end_stream);
+
+  /**
+   * The upstream connection of the stream has been closed.
+   */
+  void onUpstreamClose();
+
+  /**
+   * Removes the stream from the connection manager, the upstream connection is closed if the
+   * stream hasn't completed, otherwise it's released to the pool.
+   * @param reset_upstream supplies whether the stream hasn't completed.
+   */
+  void close(bool reset_upstream);
+
 private:
-  void clear();
+  // The bytes of the stream written to the downstream and not sent yet. The drain trackers of the
+  // written frames share it, since the frames may still be buffered when the stream is deleted.
+  struct Credits {
+    Stream* stream_;
+    uint64_t in_flight_{};
+  };
+  using CreditsSharedPtr = std::shared_ptr<Credits>;
+
+  void consumeCredits(Buffer::Instance& frame);
+  void onCreditsReturned();
+  // Each reason to stop reading the upstream holds one read disable of the upstream connection.
+  void pauseUpstream(bool& reason, bool pause);
+  void resumeUpstream();
+  // Replays the pauses which happened before the stream got its upstream connection.
+  void onUpstreamReady();
+  Tcp::ConnectionPool::ConnectionData* upstreamConnData();
+  void onActivity() { last_activity_ = time_source_.monotonicTime(); }
+  void onIdleTimeout();
+  void onMaxDuration();
+
   uint64_t stream_id_;
+  // The upstream connection of the stream, either owned or shared with other streams.
   Tcp::ConnectionPool::ConnectionDataPtr upstream_conn_data_;
+  SharedStreamConnection* shared_conn_{};
   Network::Connection& downstream_conn_;
   ConnectionManager& connection_manager_;
-  Codec& codec_;
+  // The stream decodes the upstream messages with its own codec, the codec of the connection
+  // manager may be in the middle of a downstream message.
+  CodecPtr codec_;
+  // Reused for each upstream message of the stream.
+  MetadataImpl frame_;
+  TimeSource& time_source_;
+  const absl::optional<std::chrono::milliseconds> idle_timeout_;
+  // The idle timer isn't moved for each message, it checks the last activity when it fires.
+  Event::TimerPtr idle_timer_;
+  Event::TimerPtr max_duration_timer_;
+  MonotonicTime last_activity_;
   bool client_closed_{false};
   bool server_closed_{false};
+  bool closed_{false};
+  const uint64_t buffer_limit_;
+  CreditsSharedPtr credits_;
+  // The reasons the upstream connection is read disabled for.
+  bool downstream_congested_{false};
+  bool credits_exhausted_{false};
+  // Whether the downstream connection is read disabled since the upstream one is congested.
+  bool downstream_paused_{false};
 };
 
 using StreamPtr = std::unique_ptr<Stream>;
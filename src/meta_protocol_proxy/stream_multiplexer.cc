@@ -0,0 +1,171 @@
+#include "src/meta_protocol_proxy/stream_multiplexer.h"
+
+#include <vector>
+
+#include "src/meta_protocol_proxy/conn_manager.h"
+#include "src/meta_protocol_proxy/write_batcher.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+SharedStreamConnection::SharedStreamConnection(StreamMultiplexer& parent, const std::string& host,
+                                               Tcp::ConnectionPool::ConnectionDataPtr conn_data,
+                                               CodecPtr codec)
+    : parent_(parent), host_(host), conn_data_(std::move(conn_data)), codec_(std::move(codec)) {
+  conn_data_->addUpstreamCallbacks(*this);
+}
+
+SharedStreamConnection::~SharedStreamConnection() {
+  // The connection manager is going away with streams still on the connection.
+  if (conn_data_ != nullptr) {
+    closed_ = true;
+    conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+}
+
+void SharedStreamConnection::onUpstreamData(Buffer::Instance& data, bool end_stream) {
+  while (data.length() > 0) {
+    frame_.reset();
+    frame_.setMessageType(MessageType::Response);
+    if (codec_->decodeFrame(data, frame_) == DecodeStatus::WaitForData) {
+      break;
+    }
+    auto iter = streams_.find(frame_.getStreamId());
+    if (iter == streams_.end()) {
+      ENVOY_LOG(debug, "meta protocol: drop the frame of closed stream {} from {}",
+                frame_.getStreamId(), host_);
+      continue;
+    }
+    iter->second->onUpstreamFrame(frame_, false);
+    if (conn_data_ == nullptr) {
+      // The last stream has completed and the connection has gone back to the pool.
+      data.drain(data.length());
+      return;
+    }
+  }
+
+  if (end_stream) {
+    closeStreams();
+  }
+}
+
+void SharedStreamConnection::onEvent(Network::ConnectionEvent event) {
+  if (event == Network::ConnectionEvent::RemoteClose ||
+      event == Network::ConnectionEvent::LocalClose) {
+    closeStreams();
+  }
+}
+
+void SharedStreamConnection::onAboveWriteBufferHighWatermark() {
+  WriteBatcher::upstream(*conn_data_).onAboveWriteBufferHighWatermark();
+  for (auto& stream : streams_) {
+    stream.second->pauseDownstream(true);
+  }
+}
+
+void SharedStreamConnection::onBelowWriteBufferLowWatermark() {
+  for (auto& stream : streams_) {
+    stream.second->pauseDownstream(false);
+  }
+  WriteBatcher::upstream(*conn_data_).onBelowWriteBufferLowWatermark();
+}
+
+void SharedStreamConnection::addStream(Stream& stream) {
+  streams_[stream.streamId()] = &stream;
+  stream.setSharedConn(*this);
+}
+
+void SharedStreamConnection::removeStream(uint64_t stream_id, bool completed) {
+  if (closed_) {
+    return;
+  }
+  streams_.erase(stream_id);
+  abandoned_ = abandoned_ || !completed;
+  if (!streams_.empty()) {
+    return;
+  }
+
+  closed_ = true;
+  if (abandoned_) {
+    conn_data_->connection().close(Network::ConnectionCloseType::NoFlush);
+  }
+  conn_data_.reset();
+  parent_.remove(*this);
+}
+
+void SharedStreamConnection::closeStreams() {
+  if (closed_) {
+    return;
+  }
+  ENVOY_LOG(debug, "meta protocol: the shared stream connection to {} has been closed", host_);
+  closed_ = true;
+  conn_data_.reset();
+  std::vector<Stream*> streams;
+  streams.reserve(streams_.size());
+  for (auto& stream : streams_) {
+    streams.push_back(stream.second);
+  }
+  streams_.clear();
+  for (Stream* stream : streams) {
+    stream->onUpstreamClose();
+  }
+  parent_.remove(*this);
+}
+
+StreamMultiplexer::StreamMultiplexer(ConnectionManager& connection_manager,
+                                     uint32_t max_streams_per_connection)
+    : connection_manager_(connection_manager),
+      max_streams_per_connection_(max_streams_per_connection) {}
+
+Tcp::ConnectionPool::ConnectionData* StreamMultiplexer::attach(Stream& stream,
+                                                               const std::string& host) {
+  auto iter = connections_.find(host);
+  if (iter == connections_.end()) {
+    return nullptr;
+  }
+  for (auto& connection : iter->second) {
+    if (!connection->closed() && connection->streams() < max_streams_per_connection_) {
+      ENVOY_LOG(debug, "meta protocol: stream {} shares an upstream connection to {}",
+                stream.streamId(), host);
+      connection->addStream(stream);
+      connection_manager_.stats().stream_multiplexed_.inc();
+      return &connection->connectionData();
+    }
+  }
+  return nullptr;
+}
+
+void StreamMultiplexer::add(Stream& stream, Tcp::ConnectionPool::ConnectionDataPtr conn_data) {
+  const std::string host =
+      conn_data->connection().connectionInfoProvider().remoteAddress()->asString();
+  auto connection = std::make_unique<SharedStreamConnection>(
+      *this, host, std::move(conn_data), connection_manager_.config().createCodec());
+  connection->addStream(stream);
+  connections_[host].push_back(std::move(connection));
+  connection_manager_.stats().stream_upstream_cx_shared_.inc();
+}
+
+void StreamMultiplexer::remove(SharedStreamConnection& connection) {
+  auto iter = connections_.find(connection.host());
+  ASSERT(iter != connections_.end());
+  auto& connections = iter->second;
+  for (auto it = connections.begin(); it != connections.end(); ++it) {
+    if (it->get() == &connection) {
+      connection_manager_.stats().stream_upstream_cx_shared_.dec();
+      // The connection may be in the middle of a callback.
+      connection_manager_.connection().dispatcher().deferredDelete(std::move(*it));
+      connections.erase(it);
+      break;
+    }
+  }
+  if (connections.empty()) {
+    connections_.erase(iter);
+  }
+}
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
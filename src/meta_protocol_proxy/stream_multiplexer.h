@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "envoy/event/deferred_deletable.h"
+#include "envoy/network/connection.h"
+#include "envoy/tcp/conn_pool.h"
+
+#include "source/common/common/logger.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "src/meta_protocol_proxy/codec/codec.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
+#include "src/meta_protocol_proxy/stream.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+class ConnectionManager;
+class StreamMultiplexer;
+
+/**
+ * SharedStreamConnection is an upstream connection carrying several streams of a downstream
+ * connection. The frames read from it are decoded and handed to their stream by stream id.
+ */
+class SharedStreamConnection : public Tcp::ConnectionPool::UpstreamCallbacks,
+                               public Event::DeferredDeletable,
+                               Logger::Loggable<Logger::Id::filter> {
+public:
+  SharedStreamConnection(StreamMultiplexer& parent, const std::string& host,
+                         Tcp::ConnectionPool::ConnectionDataPtr conn_data, CodecPtr codec);
+  ~SharedStreamConnection() override;
+
+  // Tcp::ConnectionPool::UpstreamCallbacks
+  void onUpstreamData(Buffer::Instance& data, bool end_stream) override;
+  void onEvent(Network::ConnectionEvent event) override;
+  void onAboveWriteBufferHighWatermark() override;
+  void onBelowWriteBufferLowWatermark() override;
+
+  Tcp::ConnectionPool::ConnectionData& connectionData() { return *conn_data_; }
+  const std::string& host() const { return host_; }
+  uint64_t streams() const { return streams_.size(); }
+  bool closed() const { return closed_; }
+
+  void addStream(Stream& stream);
+
+  /**
+   * Detach a stream, the connection goes back to the pool once it carries no stream.
+   * @param stream_id supplies the id of the stream.
+   * @param completed supplies whether the stream has completed. The connection is closed instead
+   *        of going back to the pool if a stream has been given up on, since its frames may still
+   *        come.
+   */
+  void removeStream(uint64_t stream_id, bool completed);
+
+private:
+  void closeStreams();
+
+  StreamMultiplexer& parent_;
+  const std::string host_;
+  Tcp::ConnectionPool::ConnectionDataPtr conn_data_;
+  CodecPtr codec_;
+  // Reused for each upstream message of the connection.
+  MetadataImpl frame_;
+  absl::flat_hash_map<uint64_t, Stream*> streams_;
+  bool abandoned_{false};
+  bool closed_{false};
+};
+
+using SharedStreamConnectionPtr = std::unique_ptr<SharedStreamConnection>;
+
+/**
+ * StreamMultiplexer puts the streams of a downstream connection going to the same upstream host
+ * onto a few shared upstream connections instead of one connection per stream. The stream ids are
+ * chosen by the client, so only the streams of the same downstream connection can share an
+ * upstream connection without rewriting the ids. The upstream demultiplexes the frames by stream
+ * id, as tRPC does.
+ */
+class StreamMultiplexer : Logger::Loggable<Logger::Id::filter> {
+public:
+  StreamMultiplexer(ConnectionManager& connection_manager, uint32_t max_streams_per_connection);
+
+  /**
+   * @return bool whether the streams share their upstream connections.
+   */
+  bool enabled() const { return max_streams_per_connection_ > 1; }
+
+  /**
+   * Attach a new stream to a shared connection to the host which has room for another stream.
+   * @return Tcp::ConnectionPool::ConnectionData* the connection to write the stream init message
+   *         to, or nullptr if a new connection is needed.
+   */
+  Tcp::ConnectionPool::ConnectionData* attach(Stream& stream, const std::string& host);
+
+  /**
+   * Share a new upstream connection, starting with the stream it has been acquired for.
+   */
+  void add(Stream& stream, Tcp::ConnectionPool::ConnectionDataPtr conn_data);
+
+  /**
+   * Forget a connection which carries no stream anymore, it's deleted at the end of the event
+   * loop iteration.
+   */
+  void remove(SharedStreamConnection& connection);
+
+  ConnectionManager& connectionManager() { return connection_manager_; }
+
+private:
+  ConnectionManager& connection_manager_;
+  const uint32_t max_streams_per_connection_;
+  absl::flat_hash_map<std::string, std::list<SharedStreamConnectionPtr>> connections_;
+};
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
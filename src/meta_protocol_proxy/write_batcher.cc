@@ -0,0 +1,84 @@
+#include "src/meta_protocol_proxy/write_batcher.h"
+
+#include "envoy/event/dispatcher.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+WriteBatcher::WriteBatcher(Network::Connection& connection, uint64_t max_batch_bytes)
+    : connection_(connection), max_batch_bytes_(max_batch_bytes),
+      flush_callback_(connection.dispatcher().createSchedulableCallback([this]() { flush(); })) {}
+
+WriteBatcher::~WriteBatcher() {
+  ENVOY_LOG(trace, "********** WriteBatcher destructed ***********");
+}
+
+void WriteBatcher::write(Buffer::Instance& data, bool end_stream) {
+  if (queue_time_ != nullptr && pending_.length() == 0) {
+    pending_since_ = time_source_->monotonicTime();
+  }
+  pending_.move(data);
+
+  if (end_stream) {
+    doWrite(true);
+    return;
+  }
+
+  // Above the high watermark of the connection, the frames go to its write buffer at once so that
+  // its watermarks account for them.
+  if (above_high_watermark_ || pending_.length() >= max_batch_bytes_) {
+    doWrite(false);
+    return;
+  }
+
+  if (!flush_callback_->enabled()) {
+    flush_callback_->scheduleCallbackCurrentIteration();
+  }
+}
+
+void WriteBatcher::flush() { doWrite(false); }
+
+// The frames already pending are left to the scheduled flush, the watermark callbacks run in the
+// middle of a write to the connection.
+void WriteBatcher::onAboveWriteBufferHighWatermark() { above_high_watermark_ = true; }
+
+void WriteBatcher::onBelowWriteBufferLowWatermark() { above_high_watermark_ = false; }
+
+void WriteBatcher::doWrite(bool end_stream) {
+  flush_callback_->cancel();
+
+  if (connection_.state() != Network::Connection::State::Open) {
+    ENVOY_LOG(debug, "meta protocol: connection is closed or closing, drop {} pending bytes",
+              pending_.length());
+    pending_.drain(pending_.length());
+    return;
+  }
+
+  if (pending_.length() == 0 && !end_stream) {
+    return;
+  }
+  ENVOY_LOG(trace, "meta protocol: flush {} pending bytes", pending_.length());
+  if (queue_time_ != nullptr && pending_.length() != 0) {
+    queue_time_->recordValue(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 time_source_->monotonicTime() - pending_since_)
+                                 .count());
+  }
+  connection_.write(pending_, end_stream);
+}
+
+WriteBatcher& WriteBatcher::upstream(Tcp::ConnectionPool::ConnectionData& conn_data) {
+  WriteBatcher* batcher = conn_data.connectionStateTyped<WriteBatcher>();
+  if (batcher == nullptr) {
+    auto state = std::make_unique<WriteBatcher>(conn_data.connection());
+    batcher = state.get();
+    conn_data.setConnectionState(std::move(state));
+  }
+  return *batcher;
+}
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+#include "envoy/buffer/buffer.h"
+#include "envoy/common/time.h"
+#include "envoy/event/schedulable_cb.h"
+#include "envoy/network/connection.h"
+#include "envoy/stats/stats.h"
+#include "envoy/tcp/conn_pool.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/logger.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+
+/**
+ * WriteBatcher coalesces the frames written to a connection during one dispatcher iteration, so
+ * that pipelined or multiplexed small messages leave in a single write instead of one write per
+ * message. The pending frames are flushed by a callback scheduled at the end of the current
+ * dispatcher iteration, which bounds the added latency to the iteration itself, or as soon as the
+ * pending bytes reach the byte cap.
+ *
+ * A WriteBatcher doubles as the tcp connection pool's per-connection state, so all the requests
+ * that share a pooled upstream connection also share its batcher and keep their write order.
+ */
+class WriteBatcher : public Tcp::ConnectionPool::ConnectionState,
+                     Logger::Loggable<Logger::Id::filter> {
+public:
+  static constexpr uint64_t DefaultMaxBatchBytes = 64 * 1024;
+
+  WriteBatcher(Network::Connection& connection, uint64_t max_batch_bytes = DefaultMaxBatchBytes);
+  ~WriteBatcher() override;
+
+  /**
+   * Queue the data for writing, the data is drained.
+   * @param data the frame to write.
+   * @param end_stream if true, the pending frames and data are written immediately with end_stream
+   */
+  void write(Buffer::Instance& data, bool end_stream);
+
+  /**
+   * Write all the pending frames to the connection immediately.
+   */
+  void flush();
+
+  /**
+   * Stop batching while the connection's write buffer is above its high watermark. The frames
+   * written meanwhile are moved to the write buffer at once, so that the watermarks of the
+   * connection account for them, rather than held in the batcher where nothing bounds them.
+   */
+  void onAboveWriteBufferHighWatermark();
+
+  /**
+   * Resume batching once the write buffer is below its low watermark.
+   */
+  void onBelowWriteBufferLowWatermark();
+
+  /**
+   * @return uint64_t the bytes waiting for the next flush.
+   */
+  uint64_t pendingBytes() const { return pending_.length(); }
+
+  /**
+   * Record in the histogram the microseconds the oldest pending frame waited before each write.
+   */
+  void recordQueueTime(Stats::Histogram& histogram, TimeSource& time_source) {
+    queue_time_ = &histogram;
+    time_source_ = &time_source;
+  }
+
+  /**
+   * @return WriteBatcher& the batcher attached to the pooled upstream connection, it's created on
+   *         the first use and lives as long as the connection.
+   */
+  static WriteBatcher& upstream(Tcp::ConnectionPool::ConnectionData& conn_data);
+
+private:
+  void doWrite(bool end_stream);
+
+  Network::Connection& connection_;
+  const uint64_t max_batch_bytes_;
+  Buffer::OwnedImpl pending_;
+  Event::SchedulableCallbackPtr flush_callback_;
+  bool above_high_watermark_{false};
+  Stats::Histogram* queue_time_{};
+  TimeSource* time_source_{};
+  MonotonicTime pending_since_;
+};
+
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
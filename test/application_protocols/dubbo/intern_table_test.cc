@@ -0,0 +1,65 @@
+#include <string>
+
+#include "src/application_protocols/dubbo/intern_table.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Dubbo {
+namespace {
+
+// The limits of the table, see intern_table.h.
+constexpr size_t MaxStrings = 4096;
+constexpr size_t MaxStringLength = 256;
+
+TEST(InternTableTest, KeepsASingleCopyOfEachString) {
+  InternTable table;
+  const std::string* interned = table.intern("org.apache.dubbo.DemoService");
+  ASSERT_NE(nullptr, interned);
+  EXPECT_EQ("org.apache.dubbo.DemoService", *interned);
+
+  const std::string value = "org.apache.dubbo.DemoService";
+  EXPECT_EQ(interned, table.intern(value));
+  EXPECT_NE(interned, table.intern("sayHello"));
+  EXPECT_EQ(2U, table.size());
+}
+
+TEST(InternTableTest, RejectsLongStrings) {
+  InternTable table;
+  EXPECT_NE(nullptr, table.intern(std::string(MaxStringLength, 'a')));
+  EXPECT_EQ(nullptr, table.intern(std::string(MaxStringLength + 1, 'a')));
+  EXPECT_EQ(1U, table.size());
+}
+
+// A full table still finds the strings it has, and the addresses of the strings stay the same as
+// the table grows.
+TEST(InternTableTest, StopsGrowingOnceFull) {
+  InternTable table;
+  const std::string* first = table.intern("name0");
+  for (size_t i = 1; i < MaxStrings; i++) {
+    ASSERT_NE(nullptr, table.intern("name" + std::to_string(i)));
+  }
+  EXPECT_EQ(MaxStrings, table.size());
+
+  EXPECT_EQ(nullptr, table.intern("another"));
+  EXPECT_EQ(first, table.intern("name0"));
+  EXPECT_EQ("name0", *first);
+  EXPECT_NE(nullptr, table.intern("name" + std::to_string(MaxStrings - 1)));
+  EXPECT_EQ(MaxStrings, table.size());
+}
+
+TEST(InternTableTest, GetsTheTableOfTheThread) {
+  EXPECT_EQ(&InternTable::get(), &InternTable::get());
+  const std::string* interned = InternTable::get().intern("sayHello");
+  EXPECT_EQ(interned, InternTable::get().intern("sayHello"));
+}
+
+} // namespace
+} // namespace Dubbo
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,135 @@
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "src/application_protocols/thrift/field_extractor.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+namespace {
+
+// Writes the binary protocol.
+class BinaryWriter {
+public:
+  BinaryWriter& fieldBegin(ThriftProxy::FieldType type, int16_t id) {
+    data_.push_back(static_cast<char>(type));
+    return int16(id);
+  }
+  BinaryWriter& stop() {
+    data_.push_back(static_cast<char>(ThriftProxy::FieldType::Stop));
+    return *this;
+  }
+  BinaryWriter& int16(int16_t value) {
+    data_.push_back(static_cast<char>(value >> 8));
+    data_.push_back(static_cast<char>(value));
+    return *this;
+  }
+  BinaryWriter& int32(int32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      data_.push_back(static_cast<char>(value >> shift));
+    }
+    return *this;
+  }
+  BinaryWriter& string(const std::string& value) {
+    int32(static_cast<int32_t>(value.size()));
+    data_.append(value);
+    return *this;
+  }
+
+  const std::string& data() const { return data_; }
+
+private:
+  std::string data_;
+};
+
+FieldExtractor extractor(const std::vector<std::pair<std::string, std::string>>& paths) {
+  Protobuf::RepeatedPtrField<aeraki::meta_protocol::codec::FieldExtraction> extractions;
+  for (const auto& path : paths) {
+    auto* extraction = extractions.Add();
+    extraction->set_path(path.first);
+    extraction->set_key(path.second);
+  }
+  return FieldExtractor(extractions);
+}
+
+class FieldExtractorTest : public testing::Test {
+public:
+  FieldExtractorTest() : extractor_(extractor({{"1", "name"}, {"2.3", "id"}})) {
+    // sayHello(1: string name, 2: struct {3: i32 id, 4: string note}, 5: string trace)
+    writer_.fieldBegin(ThriftProxy::FieldType::String, 1).string("alice");
+    writer_.fieldBegin(ThriftProxy::FieldType::Struct, 2);
+    writer_.fieldBegin(ThriftProxy::FieldType::I32, 3).int32(7);
+    id_end_ = writer_.data().size();
+    writer_.fieldBegin(ThriftProxy::FieldType::String, 4).string("note").stop();
+    writer_.fieldBegin(ThriftProxy::FieldType::String, 5).string("trace").stop();
+  }
+
+  bool extract(const std::string& data, ExtractedFields& fields, uint64_t& offset,
+               bool read_all) {
+    SpanReader reader(ThriftProxy::ProtocolType::Binary,
+                      reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    const bool done = extractor_.extract(reader, fields, read_all);
+    offset = reader.offset();
+    return done;
+  }
+
+  FieldExtractor extractor_;
+  BinaryWriter writer_;
+  // The end of the last configured field.
+  uint64_t id_end_;
+};
+
+TEST_F(FieldExtractorTest, ExtractsTheConfiguredFields) {
+  const std::string data = writer_.data() + "next";
+  ExtractedFields fields;
+  uint64_t offset;
+  EXPECT_TRUE(extract(data, fields, offset, true));
+  EXPECT_EQ(ExtractedFields({{"name", "alice"}, {"id", "7"}}), fields);
+  EXPECT_EQ(writer_.data().size(), offset);
+}
+
+// Without reading the struct to its end, the read stops once all the fields are found, and the rest
+// of the struct isn't needed.
+TEST_F(FieldExtractorTest, StopsOnceAllTheFieldsAreFound) {
+  const std::string data = writer_.data().substr(0, id_end_);
+  ExtractedFields fields;
+  uint64_t offset;
+  EXPECT_TRUE(extract(data, fields, offset, false));
+  EXPECT_EQ(ExtractedFields({{"name", "alice"}, {"id", "7"}}), fields);
+  EXPECT_EQ(id_end_, offset);
+
+  fields.clear();
+  EXPECT_FALSE(extract(data, fields, offset, true));
+}
+
+TEST_F(FieldExtractorTest, DoesNotExtractFromATruncatedStruct) {
+  for (size_t length = 0; length < id_end_; length++) {
+    ExtractedFields fields;
+    uint64_t offset;
+    EXPECT_FALSE(extract(writer_.data().substr(0, length), fields, offset, false))
+        << "length " << length;
+  }
+}
+
+TEST(FieldExtractorConfigTest, RejectsInvalidPaths) {
+  EXPECT_THROW(extractor({{"1.x", "name"}}), EnvoyException);
+  EXPECT_THROW(extractor({{"70000", "name"}}), EnvoyException);
+  EXPECT_THROW(extractor({{"1", "name"}, {"1", "other"}}), EnvoyException);
+  EXPECT_TRUE(extractor({}).empty());
+  EXPECT_TRUE(extractor({{"1", "name"}}).hasKey("name"));
+}
+
+} // namespace
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "envoy/common/exception.h"
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/thrift/header_rewriter.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+namespace {
+
+using Headers = std::vector<std::pair<std::string, std::string>>;
+
+void writeVarint(std::string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// A header transport frame with the info headers and the payload, its header section is padded to
+// at least section_size bytes.
+std::string headerFrame(const Headers& headers, const std::string& payload,
+                        size_t section_size = 0) {
+  std::string section;
+  // The binary protocol without transforms.
+  writeVarint(section, 0);
+  writeVarint(section, 0);
+  if (!headers.empty()) {
+    writeVarint(section, 1);
+    writeVarint(section, static_cast<uint32_t>(headers.size()));
+    for (const auto& header : headers) {
+      writeVarint(section, static_cast<uint32_t>(header.first.size()));
+      section.append(header.first);
+      writeVarint(section, static_cast<uint32_t>(header.second.size()));
+      section.append(header.second);
+    }
+  }
+  section.resize(std::max(section_size, (section.size() + 3) / 4 * 4), '\0');
+
+  Buffer::OwnedImpl frame;
+  frame.writeBEInt<int32_t>(static_cast<int32_t>(10 + section.size() + payload.size()));
+  frame.writeBEInt<uint16_t>(0x0fff);
+  // The flags and the sequence id.
+  frame.writeBEInt<uint16_t>(0);
+  frame.writeBEInt<uint32_t>(42);
+  frame.writeBEInt<uint16_t>(static_cast<uint16_t>(section.size() / 4));
+  frame.add(section);
+  frame.add(payload);
+  return frame.toString();
+}
+
+TEST(HeaderRewriterTest, TellsHeaderFrames) {
+  Buffer::OwnedImpl header(headerFrame({}, "payload"));
+  EXPECT_TRUE(HeaderRewriter::isHeaderFrame(header));
+
+  // A framed binary message.
+  Buffer::OwnedImpl framed(std::string("\x00\x00\x00\x10\x80\x01\x00\x01", 8) +
+                           std::string(8, '\0'));
+  EXPECT_FALSE(HeaderRewriter::isHeaderFrame(framed));
+  Buffer::OwnedImpl short_frame("\x00\x00\x00\x10\x0f\xff", 6);
+  EXPECT_FALSE(HeaderRewriter::isHeaderFrame(short_frame));
+}
+
+// A section which doesn't grow is overwritten in place, the frame keeps its size and its slices.
+TEST(HeaderRewriterTest, RewritesTheSectionInPlace) {
+  Buffer::OwnedImpl frame(headerFrame({{"user", "alice"}, {"zone", "a"}}, "payload", 32));
+  const void* front = frame.frontSlice().mem_;
+
+  HeaderRewriter::rewrite(frame, {{"user", "bob"}, {"trace", "1"}});
+  EXPECT_EQ(headerFrame({{"user", "bob"}, {"zone", "a"}, {"trace", "1"}}, "payload", 32),
+            frame.toString());
+  EXPECT_EQ(front, frame.frontSlice().mem_);
+}
+
+// A section which grows is rebuilt, with a new frame size and header size.
+TEST(HeaderRewriterTest, GrowsTheSection) {
+  Buffer::OwnedImpl frame(headerFrame({{"user", "alice"}}, "payload"));
+  const uint64_t length = frame.length();
+
+  HeaderRewriter::rewrite(frame, {{"trace", std::string(100, 't')}});
+  const std::string expected =
+      headerFrame({{"user", "alice"}, {"trace", std::string(100, 't')}}, "payload");
+  EXPECT_EQ(expected, frame.toString());
+  EXPECT_LT(length, frame.length());
+  EXPECT_EQ(0U, (frame.length() - 14 - 7) % 4);
+}
+
+TEST(HeaderRewriterTest, AddsTheFirstHeaders) {
+  Buffer::OwnedImpl frame(headerFrame({}, "payload"));
+  HeaderRewriter::rewrite(frame, {{"user", "bob"}});
+  EXPECT_EQ(headerFrame({{"user", "bob"}}, "payload"), frame.toString());
+}
+
+TEST(HeaderRewriterTest, RejectsAnInvalidSection) {
+  // The header section is larger than the frame.
+  std::string frame = headerFrame({{"user", "alice"}}, "");
+  frame[3] = 4;
+  Buffer::OwnedImpl too_large(frame);
+  EXPECT_THROW(HeaderRewriter::rewrite(too_large, {{"user", "bob"}}), EnvoyException);
+
+  // A string runs past the end of the section.
+  frame = headerFrame({{"user", "alice"}}, "payload");
+  frame[14 + 4] = 100;
+  Buffer::OwnedImpl truncated(frame);
+  EXPECT_THROW(HeaderRewriter::rewrite(truncated, {{"user", "bob"}}), EnvoyException);
+
+  // An unknown info id.
+  frame = headerFrame({{"user", "alice"}}, "payload");
+  frame[14 + 2] = 7;
+  Buffer::OwnedImpl unknown(frame);
+  EXPECT_THROW(HeaderRewriter::rewrite(unknown, {{"user", "bob"}}), EnvoyException);
+}
+
+} // namespace
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <string>
+
+#include "envoy/common/exception.h"
+
+#include "src/application_protocols/thrift/span_reader.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+namespace {
+
+// The compact protocol type of the i64 elements of a list.
+constexpr uint8_t CompactI64 = 6;
+
+// A varint of the given length, the length is padded with zero groups like a sloppy encoder may do.
+void writeVarint(std::string& out, uint32_t length) {
+  for (uint32_t i = 1; i < length; i++) {
+    out.push_back(static_cast<char>(0x80 | (i & 0x7f)));
+  }
+  out.push_back(0x01);
+}
+
+// A compact list of i64 whose element i is a varint of lengths(i) bytes.
+template <class Lengths> std::string compactList(uint32_t size, Lengths lengths) {
+  std::string list;
+  if (size < 15) {
+    list.push_back(static_cast<char>(size << 4 | CompactI64));
+  } else {
+    list.push_back(static_cast<char>(0xf0 | CompactI64));
+    for (uint32_t value = size; true; value >>= 7) {
+      if (value < 0x80) {
+        list.push_back(static_cast<char>(value));
+        break;
+      }
+      list.push_back(static_cast<char>(0x80 | (value & 0x7f)));
+    }
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    writeVarint(list, lengths(i));
+  }
+  return list;
+}
+
+bool skip(ThriftProxy::ProtocolType protocol, const std::string& data,
+          ThriftProxy::FieldType field_type, uint64_t& offset) {
+  SpanReader reader(protocol, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  const bool done = reader.skip(field_type);
+  offset = reader.offset();
+  return done;
+}
+
+bool skipCompact(const std::string& data, ThriftProxy::FieldType field_type, uint64_t& offset) {
+  return skip(ThriftProxy::ProtocolType::Compact, data, field_type, offset);
+}
+
+// The varints of a list are counted eight bytes at a time, the lists of varints of all the lengths
+// put the ends of the varints and the runs of continuation bytes at all the positions of the words.
+TEST(SpanReaderTest, SkipsCompactVarintListsAcrossWords) {
+  for (uint32_t size = 1; size <= 40; size++) {
+    for (uint32_t stride = 1; stride <= 10; stride++) {
+      const std::string list =
+          compactList(size, [stride](uint32_t i) { return 1 + (i * stride) % 10; });
+      // The bytes after the list belong to the next value.
+      const std::string data = list + std::string(16, '\x80');
+
+      uint64_t offset;
+      ASSERT_TRUE(skipCompact(data, ThriftProxy::FieldType::List, offset))
+          << "size " << size << " stride " << stride;
+      EXPECT_EQ(list.size(), offset) << "size " << size << " stride " << stride;
+    }
+  }
+}
+
+// A truncated list isn't skipped, and the cursor is left before the list.
+TEST(SpanReaderTest, DoesNotSkipATruncatedVarintList) {
+  for (uint32_t size : {1, 7, 8, 9, 16, 33}) {
+    const std::string list = compactList(size, [](uint32_t i) { return 1 + (i * 3) % 10; });
+    for (size_t length = 0; length < list.size(); length++) {
+      uint64_t offset;
+      EXPECT_FALSE(skipCompact(list.substr(0, length), ThriftProxy::FieldType::List, offset))
+          << "size " << size << " length " << length;
+      EXPECT_EQ(0U, offset);
+    }
+  }
+}
+
+// The longest varint of a 64 bit value has 10 bytes, a longer one is invalid wherever it starts in
+// a word.
+TEST(SpanReaderTest, RejectsAVarintLongerThanTenBytes) {
+  for (uint32_t before = 0; before < 10; before++) {
+    const std::string valid =
+        compactList(before + 2, [before](uint32_t i) { return i == before ? 10 : 1; });
+    uint64_t offset;
+    EXPECT_TRUE(skipCompact(valid + std::string(16, '\0'), ThriftProxy::FieldType::List, offset));
+    EXPECT_EQ(valid.size(), offset);
+
+    const std::string invalid =
+        compactList(before + 2, [before](uint32_t i) { return i == before ? 11 : 1; });
+    EXPECT_THROW(
+        skipCompact(invalid + std::string(16, '\0'), ThriftProxy::FieldType::List, offset),
+        EnvoyException);
+  }
+
+  std::string varint;
+  writeVarint(varint, 11);
+  SpanReader reader(ThriftProxy::ProtocolType::Compact,
+                    reinterpret_cast<const uint8_t*>(varint.data()), varint.size());
+  int64_t value;
+  EXPECT_THROW(reader.readInt64(value), EnvoyException);
+}
+
+TEST(SpanReaderTest, SkipsBinaryListsOfFixedSizeAtOnce) {
+  // list<i32> of 3 elements.
+  const std::string list = std::string("\x08\x00\x00\x00\x03", 5) + std::string(12, '\x01');
+
+  uint64_t offset;
+  EXPECT_TRUE(skip(ThriftProxy::ProtocolType::Binary, list + "next", ThriftProxy::FieldType::List,
+                   offset));
+  EXPECT_EQ(list.size(), offset);
+
+  EXPECT_FALSE(skip(ThriftProxy::ProtocolType::Binary, list.substr(0, list.size() - 1),
+                    ThriftProxy::FieldType::List, offset));
+  EXPECT_EQ(0U, offset);
+}
+
+TEST(SpanReaderTest, DoesNotReadATruncatedString) {
+  const std::string data("\x00\x00\x00\x05hell", 8);
+  SpanReader reader(ThriftProxy::ProtocolType::Binary,
+                    reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  absl::string_view value;
+  EXPECT_FALSE(reader.readString(value));
+  EXPECT_EQ(0U, reader.offset());
+}
+
+} // namespace
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,90 @@
+#include <memory>
+#include <string>
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/thrift/thrift_codec.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
+
+#include "test/benchmark/corpus.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+namespace {
+
+FieldExtractorSharedPtr nameExtractor() {
+  Protobuf::RepeatedPtrField<aeraki::meta_protocol::codec::FieldExtraction> extractions;
+  auto* extraction = extractions.Add();
+  extraction->set_path("1");
+  extraction->set_key("name");
+  return std::make_shared<const FieldExtractor>(extractions);
+}
+
+class ThriftCodecTest : public testing::TestWithParam<ThriftProxy::ProtocolType> {
+public:
+  std::string request(uint64_t name_size) {
+    return Benchmark::thriftRequest(ThriftProxy::TransportType::Unframed, GetParam(), name_size);
+  }
+};
+
+INSTANTIATE_TEST_SUITE_P(Protocols, ThriftCodecTest,
+                         testing::Values(ThriftProxy::ProtocolType::Binary,
+                                         ThriftProxy::ProtocolType::Compact));
+
+// The end of an unframed request is found by scanning its body, which stops at the end of the
+// arguments even though the buffer holds the next pipelined request too.
+TEST_P(ThriftCodecTest, ScansAnUnframedRequestFollowedByAPipelinedOne) {
+  const std::string first = request(16);
+  const std::string second = request(32);
+
+  for (const auto& field_extractor : {nameExtractor(), FieldExtractorSharedPtr()}) {
+    ThriftCodec codec(field_extractor);
+    Buffer::OwnedImpl buffer(first + second);
+
+    MetadataImpl metadata;
+    ASSERT_EQ(DecodeStatus::Done, codec.decode(buffer, metadata));
+    EXPECT_EQ(first, metadata.originMessage().toString());
+    EXPECT_EQ(second, buffer.toString());
+
+    MetadataImpl next;
+    ASSERT_EQ(DecodeStatus::Done, codec.decode(buffer, next));
+    EXPECT_EQ(second, next.originMessage().toString());
+    EXPECT_EQ(0U, buffer.length());
+
+    if (field_extractor != nullptr) {
+      EXPECT_EQ(std::string(16, 'a'), metadata.getString("name"));
+      EXPECT_EQ(std::string(32, 'a'), next.getString("name"));
+    }
+  }
+}
+
+// The scan starts over when more of the body comes, wherever the request was cut.
+TEST_P(ThriftCodecTest, ScansAnUnframedRequestReceivedInTwoParts) {
+  const std::string first = request(16);
+  const std::string second = request(32);
+
+  for (size_t length = 1; length < first.size(); length++) {
+    ThriftCodec codec(nameExtractor());
+    Buffer::OwnedImpl buffer(first.substr(0, length));
+
+    MetadataImpl metadata;
+    ASSERT_EQ(DecodeStatus::WaitForData, codec.decode(buffer, metadata)) << "length " << length;
+    buffer.add(first.substr(length) + second);
+    ASSERT_EQ(DecodeStatus::Done, codec.decode(buffer, metadata)) << "length " << length;
+    EXPECT_EQ(first, metadata.originMessage().toString()) << "length " << length;
+    EXPECT_EQ(std::string(16, 'a'), metadata.getString("name")) << "length " << length;
+    EXPECT_EQ(second, buffer.toString()) << "length " << length;
+  }
+}
+
+} // namespace
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,52 @@
+#include "test/benchmark/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef META_PROTOCOL_COUNT_ALLOCATIONS
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+} // namespace
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+#endif
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Benchmark {
+
+#ifdef META_PROTOCOL_COUNT_ALLOCATIONS
+
+bool allocationCountEnabled() { return true; }
+
+uint64_t allocationCount() { return allocations.load(std::memory_order_relaxed); }
+
+#else
+
+bool allocationCountEnabled() { return false; }
+
+uint64_t allocationCount() { return 0; }
+
+#endif
+
+} // namespace Benchmark
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Benchmark {
+
+/**
+ * The heap allocations are only counted when the benchmark is built with
+ * --define tcmalloc=disabled, since counting them replaces the global operator new which tcmalloc
+ * already defines.
+ * @return bool whether allocationCount() counts the allocations.
+ */
+bool allocationCountEnabled();
+
+/**
+ * @return uint64_t the number of operator new calls since the start of the process, or 0 if the
+ *         allocations are not counted.
+ */
+uint64_t allocationCount();
+
+} // namespace Benchmark
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
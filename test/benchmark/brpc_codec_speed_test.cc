@@ -0,0 +1,42 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management.
+
+#include <string>
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/brpc/brpc_codec.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
+
+#include "test/benchmark/corpus.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Brpc {
+
+// Decodes a request the way the connection manager does, from a buffer holding one message.
+static void bmBrpcDecode(benchmark::State& state) {
+  const std::string request = Benchmark::brpcRequest(state.range(0));
+  BrpcCodec codec;
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    Buffer::OwnedImpl buffer(request);
+    MetadataImpl metadata;
+    metadata.setMessageType(MessageType::Request);
+    auto status = codec.decode(buffer, metadata);
+    RELEASE_ASSERT(status == DecodeStatus::Done, "");
+    benchmark::DoNotOptimize(metadata.originMessage().length());
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(bmBrpcDecode)->Arg(64)->Arg(4 * 1024)->Arg(256 * 1024);
+
+} // namespace Brpc
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,362 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management. Build it with
+// --define tcmalloc=disabled to also report the allocations per request.
+//
+// The connection manager and the router run on a real dispatcher, while the downstream and the
+// upstream connections are mocks. The absolute numbers include the cost of the mocks, they're meant
+// to compare two builds of the proxy rather than to size a deployment.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "envoy/tcp/conn_pool.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/common/random_generator.h"
+
+#include "src/application_protocols/brpc/brpc_codec.h"
+#include "src/application_protocols/dubbo/dubbo_codec.h"
+#include "src/application_protocols/thrift/thrift_codec.h"
+#include "src/meta_protocol_proxy/conn_manager.h"
+#include "src/meta_protocol_proxy/filters/router/router_impl.h"
+#include "src/meta_protocol_proxy/route/route_matcher_impl.h"
+
+#include "test/benchmark/allocation_counter.h"
+#include "test/benchmark/corpus.h"
+#include "test/mocks/network/mocks.h"
+#include "test/mocks/server/factory_context.h"
+#include "test/mocks/server/server_factory_context.h"
+#include "test/mocks/upstream/host.h"
+#include "test/test_common/utility.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Benchmark {
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::ReturnRef;
+
+enum class Protocol { Dubbo, Thrift, Brpc };
+
+constexpr char ClusterName[] = "benchmark";
+constexpr uint64_t PayloadSize = 256;
+// The dispatcher iterations a round trip may take before the responses are considered lost.
+constexpr uint32_t MaxLoopsPerRoundTrip = 1000;
+
+static std::string request(Protocol protocol) {
+  switch (protocol) {
+  case Protocol::Dubbo:
+    return dubboRequest(PayloadSize);
+  case Protocol::Thrift:
+    return thriftRequest(ThriftProxy::TransportType::Framed, ThriftProxy::ProtocolType::Binary,
+                         PayloadSize);
+  case Protocol::Brpc:
+    return brpcRequest(PayloadSize);
+  }
+  NOT_REACHED_GCOVR_EXCL_LINE;
+}
+
+static std::string response(Protocol protocol) {
+  switch (protocol) {
+  case Protocol::Dubbo:
+    return dubboResponse(PayloadSize);
+  case Protocol::Thrift:
+    return thriftResponse(ThriftProxy::TransportType::Framed, ThriftProxy::ProtocolType::Binary,
+                          PayloadSize);
+  case Protocol::Brpc:
+    return brpcResponse(PayloadSize);
+  }
+  NOT_REACHED_GCOVR_EXCL_LINE;
+}
+
+/**
+ * FakeUpstreamConnection is a pooled upstream connection to a server that answers each request
+ * with the same response in the current dispatcher iteration.
+ */
+class FakeUpstreamConnection {
+public:
+  FakeUpstreamConnection(Event::Dispatcher& dispatcher, const std::string& response)
+      : response_(response.data(), response.size(), nullptr),
+        respond_(dispatcher.createSchedulableCallback([this]() { respond(); })) {
+    ON_CALL(connection_, dispatcher()).WillByDefault(ReturnRef(dispatcher));
+    ON_CALL(connection_, write(_, _)).WillByDefault(Invoke([this](Buffer::Instance& data, bool) {
+      // The pool hands the connection to one request at a time, so a write is one request.
+      data.drain(data.length());
+      respond_->scheduleCallbackCurrentIteration();
+    }));
+  }
+
+  Network::ClientConnection& connection() { return connection_; }
+  Tcp::ConnectionPool::ConnectionState* state() { return state_.get(); }
+  void setState(Tcp::ConnectionPool::ConnectionStatePtr&& state) { state_ = std::move(state); }
+  void setUpstreamCallbacks(Tcp::ConnectionPool::UpstreamCallbacks& callbacks) {
+    callbacks_ = &callbacks;
+  }
+
+private:
+  void respond() {
+    // The response shares the bytes of the fragment, so the fake server doesn't allocate.
+    Buffer::OwnedImpl data;
+    data.addBufferFragment(response_);
+    callbacks_->onUpstreamData(data, false);
+  }
+
+  Buffer::BufferFragmentImpl response_;
+  NiceMock<Network::MockClientConnection> connection_;
+  // The connection state outlives the requests like in the tcp connection pool, e.g. the write
+  // batcher of the router.
+  Tcp::ConnectionPool::ConnectionStatePtr state_;
+  Tcp::ConnectionPool::UpstreamCallbacks* callbacks_{};
+  Event::SchedulableCallbackPtr respond_;
+};
+
+/**
+ * FakeConnectionData lends a connection to a request and returns it to the idle connections when
+ * the request releases it.
+ */
+class FakeConnectionData : public Tcp::ConnectionPool::ConnectionData {
+public:
+  FakeConnectionData(FakeUpstreamConnection& connection,
+                     std::vector<FakeUpstreamConnection*>& idle_connections)
+      : connection_(connection), idle_connections_(idle_connections) {}
+  ~FakeConnectionData() override { idle_connections_.push_back(&connection_); }
+
+  // Tcp::ConnectionPool::ConnectionData
+  Network::ClientConnection& connection() override { return connection_.connection(); }
+  void addUpstreamCallbacks(Tcp::ConnectionPool::UpstreamCallbacks& callbacks) override {
+    connection_.setUpstreamCallbacks(callbacks);
+  }
+
+private:
+  // Tcp::ConnectionPool::ConnectionData
+  void setConnectionState_(Tcp::ConnectionPool::ConnectionStatePtr&& state) override {
+    connection_.setState(std::move(state));
+  }
+  Tcp::ConnectionPool::ConnectionState* connectionState() override { return connection_.state(); }
+
+  FakeUpstreamConnection& connection_;
+  std::vector<FakeUpstreamConnection*>& idle_connections_;
+};
+
+/**
+ * FakeUpstream stands for the tcp connection pool of the cluster, it opens a new connection when
+ * all the connections are busy and hands the connections over synchronously.
+ */
+class FakeUpstream {
+public:
+  FakeUpstream(Event::Dispatcher& dispatcher, const std::string& response)
+      : dispatcher_(dispatcher), response_(response),
+        host_(std::make_shared<NiceMock<Upstream::MockHostDescription>>()) {}
+
+  Tcp::ConnectionPool::Cancellable* newConnection(Tcp::ConnectionPool::Callbacks& callbacks) {
+    if (idle_connections_.empty()) {
+      connections_.push_back(std::make_unique<FakeUpstreamConnection>(dispatcher_, response_));
+      idle_connections_.push_back(connections_.back().get());
+    }
+    FakeUpstreamConnection* connection = idle_connections_.back();
+    idle_connections_.pop_back();
+    callbacks.onPoolReady(std::make_unique<FakeConnectionData>(*connection, idle_connections_),
+                          host_);
+    return nullptr;
+  }
+
+private:
+  Event::Dispatcher& dispatcher_;
+  const std::string& response_;
+  Upstream::HostDescriptionConstSharedPtr host_;
+  std::vector<std::unique_ptr<FakeUpstreamConnection>> connections_;
+  std::vector<FakeUpstreamConnection*> idle_connections_;
+};
+
+/**
+ * BenchmarkConfig routes every request to the benchmark cluster with the router as the only
+ * filter.
+ */
+class BenchmarkConfig : public Config, public Route::Config, public FilterChainFactory {
+public:
+  BenchmarkConfig(Protocol protocol, Server::Configuration::FactoryContext& context,
+                  Server::Configuration::ServerFactoryContext& server_context)
+      : protocol_(protocol),
+        stats_(MetaProtocolProxyStats::generateStats("benchmark.", context.scope())),
+        route_matcher_(routeConfig(), server_context),
+        router_config_(Router::RouterProto(), "benchmark.", context) {}
+
+  // FilterChainFactory
+  void createFilterChain(FilterChainFactoryCallbacks& callbacks) override {
+    callbacks.addFilter(std::make_shared<Router::Router>(router_config_));
+  }
+
+  // Route::Config
+  Route::RouteConstSharedPtr route(const Metadata& metadata,
+                                   uint64_t random_value) const override {
+    return route_matcher_.route(metadata, random_value);
+  }
+
+  // Config
+  FilterChainFactory& filterFactory() override { return *this; }
+  MetaProtocolProxyStats& stats() override { return stats_; }
+  MetaProtocolProxyPhaseStats* phaseStats() override { return nullptr; }
+  MethodStats* methodStats() override { return nullptr; }
+  uint32_t maxMessageSize() override { return 0; }
+  CodecPtr createCodec() override {
+    switch (protocol_) {
+    case Protocol::Dubbo:
+      return std::make_unique<Dubbo::DubboCodec>();
+    case Protocol::Thrift:
+      return std::make_unique<Thrift::ThriftCodec>();
+    case Protocol::Brpc:
+      return std::make_unique<Brpc::BrpcCodec>();
+    }
+    NOT_REACHED_GCOVR_EXCL_LINE;
+  }
+  Route::Config& routerConfig() override { return *this; }
+  std::string applicationProtocol() override { return "benchmark"; }
+  absl::optional<std::chrono::milliseconds> idleTimeout() override { return absl::nullopt; }
+  const StreamLimits& streamLimits() override { return stream_limits_; }
+  Route::RouteConfigProvider* routeConfigProvider() override { return nullptr; }
+
+private:
+  static Route::RouteMatcherImpl::RouteConfig routeConfig() {
+    Route::RouteMatcherImpl::RouteConfig config;
+    config.set_name(ClusterName);
+    auto* route = config.add_routes();
+    route->set_name(ClusterName);
+    route->mutable_route()->set_cluster(ClusterName);
+    return config;
+  }
+
+  const Protocol protocol_;
+  MetaProtocolProxyStats stats_;
+  Route::RouteMatcherImpl route_matcher_;
+  Router::RouterConfig router_config_;
+  StreamLimits stream_limits_;
+};
+
+/**
+ * ProxyHarness drives a connection manager with batches of pipelined requests and records the
+ * latency of each request, from the read of its batch to the write of its response.
+ */
+class ProxyHarness {
+public:
+  ProxyHarness(Protocol protocol, uint64_t pipeline_depth)
+      : api_(Api::createApiForTest()), dispatcher_(api_->allocateDispatcher("benchmark")),
+        response_(response(protocol)), upstream_(*dispatcher_, response_),
+        config_(protocol, context_, server_context_), pipeline_depth_(pipeline_depth) {
+    for (uint64_t i = 0; i < pipeline_depth_; i++) {
+      requests_.append(request(protocol));
+    }
+
+    context_.cluster_manager_.initializeThreadLocalClusters({ClusterName});
+    ON_CALL(context_.cluster_manager_.thread_local_cluster_.tcp_conn_pool_, newConnection(_))
+        .WillByDefault(Invoke(&upstream_, &FakeUpstream::newConnection));
+
+    auto& connection = read_callbacks_.connection_;
+    ON_CALL(connection, dispatcher()).WillByDefault(ReturnRef(*dispatcher_));
+    ON_CALL(connection, write(_, _)).WillByDefault(Invoke([this](Buffer::Instance& data, bool) {
+      // The responses are counted when they're decoded, and all the decoded ones are written in
+      // the same batch.
+      const uint64_t responses = config_.stats().response_.value() - responses_;
+      data.drain(data.length());
+      const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          dispatcher_->timeSource().monotonicTime() - batch_start_);
+      latencies_us_.insert(latencies_us_.end(), responses, latency.count() / 1000.0);
+      responses_ += responses;
+    }));
+
+    manager_ = std::make_unique<ConnectionManager>(config_, random_, dispatcher_->timeSource());
+    manager_->initializeReadFilterCallbacks(read_callbacks_);
+    manager_->onNewConnection();
+  }
+
+  ~ProxyHarness() {
+    // The messages of the last batch are still queued for deferred deletion and refer to the
+    // connection manager.
+    dispatcher_->clearDeferredDeleteList();
+  }
+
+  // Sends a batch of requests in a single read and runs the dispatcher until all the responses
+  // are written to the downstream.
+  void roundTrip() {
+    Buffer::OwnedImpl data(requests_);
+    const uint64_t responses = responses_ + pipeline_depth_;
+    batch_start_ = dispatcher_->timeSource().monotonicTime();
+    manager_->onData(data, false);
+    for (uint32_t loops = 0; responses_ < responses; loops++) {
+      RELEASE_ASSERT(loops < MaxLoopsPerRoundTrip, "responses are lost");
+      dispatcher_->run(Event::Dispatcher::RunType::NonBlock);
+    }
+  }
+
+  double percentile(double quantile) {
+    if (latencies_us_.empty()) {
+      return 0;
+    }
+    auto nth = latencies_us_.begin() + static_cast<size_t>(quantile * (latencies_us_.size() - 1));
+    std::nth_element(latencies_us_.begin(), nth, latencies_us_.end());
+    return *nth;
+  }
+
+private:
+  Api::ApiPtr api_;
+  Event::DispatcherPtr dispatcher_;
+  const std::string response_;
+  FakeUpstream upstream_;
+  NiceMock<Server::Configuration::MockFactoryContext> context_;
+  NiceMock<Server::Configuration::MockServerFactoryContext> server_context_;
+  BenchmarkConfig config_;
+  NiceMock<Network::MockReadFilterCallbacks> read_callbacks_;
+  Random::RandomGeneratorImpl random_;
+  std::unique_ptr<ConnectionManager> manager_;
+
+  const uint64_t pipeline_depth_;
+  std::string requests_;
+  MonotonicTime batch_start_;
+  // The responses written to the downstream.
+  uint64_t responses_{};
+  std::vector<double> latencies_us_;
+};
+
+// Proxies batches of state.range(1) pipelined requests of the state.range(0) protocol through the
+// connection manager and the router. The rate is per core as the proxy runs on the benchmark
+// thread only.
+static void bmConnectionManager(benchmark::State& state) {
+  const auto protocol = static_cast<Protocol>(state.range(0));
+  const uint64_t pipeline_depth = state.range(1);
+  ProxyHarness harness(protocol, pipeline_depth);
+  // Warm up the upstream connections and the buffers.
+  harness.roundTrip();
+
+  const uint64_t allocations = allocationCount();
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    harness.roundTrip();
+  }
+  const double requests = state.iterations() * pipeline_depth;
+
+  state.counters["rps"] = benchmark::Counter(requests, benchmark::Counter::kIsRate);
+  state.counters["p50_us"] = harness.percentile(0.5);
+  state.counters["p99_us"] = harness.percentile(0.99);
+  if (allocationCountEnabled()) {
+    state.counters["allocs_per_rq"] = (allocationCount() - allocations) / requests;
+  }
+}
+BENCHMARK(bmConnectionManager)
+    ->ArgsProduct({{static_cast<int64_t>(Protocol::Dubbo), static_cast<int64_t>(Protocol::Thrift),
+                    static_cast<int64_t>(Protocol::Brpc)},
+                   {1, 16, 128}})
+    ->ArgNames({"protocol", "pipeline"});
+
+} // namespace Benchmark
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,163 @@
+#include "test/benchmark/corpus.h"
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/brpc/brpc_meta.pb.h"
+#include "src/application_protocols/dubbo/hessian_utils.h"
+#include "src/application_protocols/dubbo/message_impl.h"
+#include "src/application_protocols/thrift/protocol.h"
+#include "src/application_protocols/thrift/transport.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Benchmark {
+
+namespace {
+
+constexpr uint16_t DubboMagic = 0xdabb;
+// Two-way request and response flags with the Hessian2 serialization id.
+constexpr uint8_t DubboRequestFlag = 0xc2;
+constexpr uint8_t DubboResponseFlag = 0x02;
+constexpr uint8_t DubboResponseOk = 20;
+constexpr int32_t DubboResponseWithValue = 1;
+
+std::string dubboMessage(uint8_t flag, uint8_t status, Buffer::Instance& body) {
+  Buffer::OwnedImpl message;
+  message.writeBEInt<uint16_t>(DubboMagic);
+  message.writeByte(flag);
+  message.writeByte(status);
+  message.writeBEInt<int64_t>(1);
+  message.writeBEInt<uint32_t>(body.length());
+  message.move(body);
+  return message.toString();
+}
+
+std::string thriftMessage(ThriftProxy::TransportType transport_type,
+                          ThriftProxy::ProtocolType protocol_type,
+                          ThriftProxy::MessageType message_type,
+                          const std::function<void(ThriftProxy::Protocol&, Buffer::Instance&)>&
+                              write_fields) {
+  auto transport =
+      ThriftProxy::NamedTransportConfigFactory::getFactory(transport_type).createTransport();
+  auto protocol =
+      ThriftProxy::NamedProtocolConfigFactory::getFactory(protocol_type).createProtocol();
+
+  ThriftProxy::MessageMetadata metadata;
+  metadata.setMethodName("sayHello");
+  metadata.setMessageType(message_type);
+  metadata.setSequenceId(1);
+  metadata.setProtocol(protocol_type);
+
+  Buffer::OwnedImpl message;
+  protocol->writeMessageBegin(message, metadata);
+  protocol->writeStructBegin(message, "");
+  write_fields(*protocol, message);
+  protocol->writeFieldBegin(message, "", ThriftProxy::FieldType::Stop, 0);
+  protocol->writeStructEnd(message);
+  protocol->writeMessageEnd(message);
+
+  Buffer::OwnedImpl frame;
+  transport->encodeFrame(frame, metadata, message);
+  return frame.toString();
+}
+
+std::string brpcMessage(const aeraki::meta_protocol::brpc::RpcMeta& meta, uint64_t payload_size) {
+  const std::string meta_bytes = meta.SerializeAsString();
+
+  Buffer::OwnedImpl message;
+  message.add("PRPC");
+  message.writeBEInt<uint32_t>(meta_bytes.size() + payload_size);
+  message.writeBEInt<uint32_t>(meta_bytes.size());
+  message.add(meta_bytes);
+  message.add(std::string(payload_size, 'a'));
+  return message.toString();
+}
+
+} // namespace
+
+std::string dubboRequest(uint64_t argument_size) {
+  using Dubbo::BufferWriter;
+  using Dubbo::RpcInvocationImpl;
+
+  Buffer::OwnedImpl body;
+  Hessian2::Encoder encoder(std::make_unique<BufferWriter>(body));
+  encoder.encode<std::string>("2.7.8");
+  encoder.encode<std::string>("org.apache.dubbo.samples.basic.api.DemoService");
+  encoder.encode<std::string>("0.0.0");
+  encoder.encode<std::string>("sayHello");
+  encoder.encode<std::string>("Ljava/lang/String;");
+  encoder.encode<std::string>(std::string(argument_size, 'a'));
+
+  RpcInvocationImpl::Attachment attachment(
+      std::make_unique<RpcInvocationImpl::Attachment::Map>(), 0);
+  attachment.insert("path", "org.apache.dubbo.samples.basic.api.DemoService");
+  attachment.insert("interface", "org.apache.dubbo.samples.basic.api.DemoService");
+  attachment.insert("version", "0.0.0");
+  attachment.insert("timeout", "3000");
+  attachment.insert("remote.application", "dubbo-sample-consumer");
+  encoder.encode(attachment.attachment());
+
+  return dubboMessage(DubboRequestFlag, 0, body);
+}
+
+std::string dubboResponse(uint64_t value_size) {
+  Buffer::OwnedImpl body;
+  Hessian2::Encoder encoder(std::make_unique<Dubbo::BufferWriter>(body));
+  encoder.encode<int32_t>(DubboResponseWithValue);
+  encoder.encode<std::string>(std::string(value_size, 'a'));
+
+  return dubboMessage(DubboResponseFlag, DubboResponseOk, body);
+}
+
+std::string thriftRequest(ThriftProxy::TransportType transport_type,
+                          ThriftProxy::ProtocolType protocol_type, uint64_t name_size) {
+  return thriftMessage(
+      transport_type, protocol_type, ThriftProxy::MessageType::Call,
+      [name_size](ThriftProxy::Protocol& protocol, Buffer::Instance& message) {
+        protocol.writeFieldBegin(message, "name", ThriftProxy::FieldType::String, 1);
+        protocol.writeString(message, std::string(name_size, 'a'));
+        protocol.writeFieldEnd(message);
+        protocol.writeFieldBegin(message, "ids", ThriftProxy::FieldType::List, 2);
+        protocol.writeListBegin(message, ThriftProxy::FieldType::I32, 16);
+        for (int32_t id = 0; id < 16; id++) {
+          protocol.writeInt32(message, id);
+        }
+        protocol.writeListEnd(message);
+        protocol.writeFieldEnd(message);
+      });
+}
+
+std::string thriftResponse(ThriftProxy::TransportType transport_type,
+                           ThriftProxy::ProtocolType protocol_type, uint64_t value_size) {
+  return thriftMessage(transport_type, protocol_type, ThriftProxy::MessageType::Reply,
+                       [value_size](ThriftProxy::Protocol& protocol, Buffer::Instance& message) {
+                         protocol.writeFieldBegin(message, "success",
+                                                  ThriftProxy::FieldType::String, 0);
+                         protocol.writeString(message, std::string(value_size, 'a'));
+                         protocol.writeFieldEnd(message);
+                       });
+}
+
+std::string brpcRequest(uint64_t payload_size) {
+  aeraki::meta_protocol::brpc::RpcMeta meta;
+  meta.mutable_request()->set_service_name("example.EchoService");
+  meta.mutable_request()->set_method_name("Echo");
+  meta.mutable_request()->set_log_id(1);
+  meta.set_correlation_id(1);
+  return brpcMessage(meta, payload_size);
+}
+
+std::string brpcResponse(uint64_t payload_size) {
+  aeraki::meta_protocol::brpc::RpcMeta meta;
+  meta.mutable_response()->set_error_code(0);
+  meta.set_correlation_id(1);
+  return brpcMessage(meta, payload_size);
+}
+
+} // namespace Benchmark
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "src/application_protocols/thrift/thrift.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Benchmark {
+
+/**
+ * The messages the benchmarks feed to the codecs and the connection manager. Each call returns the
+ * wire bytes of one complete message.
+ */
+
+// A two-way Hessian2 request of DemoService.sayHello with a string argument of the given size and
+// the attachments a Dubbo consumer usually sends.
+std::string dubboRequest(uint64_t argument_size);
+
+// A successful Hessian2 response carrying a string value of the given size.
+std::string dubboResponse(uint64_t value_size);
+
+// A call of sayHello(1: string name, 2: list<i32> ids) with a name of the given size.
+std::string thriftRequest(ThriftProxy::TransportType transport_type,
+                          ThriftProxy::ProtocolType protocol_type, uint64_t name_size);
+
+// A reply of sayHello carrying a string of the given size.
+std::string thriftResponse(ThriftProxy::TransportType transport_type,
+                           ThriftProxy::ProtocolType protocol_type, uint64_t value_size);
+
+// A baidu_std request of EchoService.Echo with a payload of the given size.
+std::string brpcRequest(uint64_t payload_size);
+
+// A successful baidu_std response of EchoService.Echo with a payload of the given size.
+std::string brpcResponse(uint64_t payload_size);
+
+} // namespace Benchmark
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,65 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management.
+
+#include <string>
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/dubbo/dubbo_codec.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
+
+#include "test/benchmark/corpus.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Dubbo {
+
+// Decodes a request the way the connection manager does, from a buffer holding one message.
+static void bmDubboDecode(benchmark::State& state) {
+  const std::string request = Benchmark::dubboRequest(state.range(0));
+  DubboCodec codec;
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    Buffer::OwnedImpl buffer(request);
+    MetadataImpl metadata;
+    auto status = codec.decode(buffer, metadata);
+    RELEASE_ASSERT(status == DecodeStatus::Done, "");
+    benchmark::DoNotOptimize(metadata.getRequestId());
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(bmDubboDecode)->Arg(64)->Arg(4 * 1024)->Arg(256 * 1024);
+
+// Decodes a request and encodes it again the way the router does, with and without a mutation of
+// the attachments. The encode cost is the difference with bmDubboDecode.
+static void bmDubboDecodeEncode(benchmark::State& state) {
+  const std::string request = Benchmark::dubboRequest(state.range(0));
+  Mutation mutation;
+  if (state.range(1) != 0) {
+    mutation.emplace("x-request-source", "benchmark");
+  }
+  DubboCodec codec;
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    Buffer::OwnedImpl buffer(request);
+    MetadataImpl metadata;
+    auto status = codec.decode(buffer, metadata);
+    RELEASE_ASSERT(status == DecodeStatus::Done, "");
+    codec.encode(metadata, mutation, metadata.originMessage());
+    benchmark::DoNotOptimize(metadata.originMessage().length());
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(bmDubboDecodeEncode)
+    ->ArgsProduct({{64, 4 * 1024, 256 * 1024}, {0, 1}})
+    ->ArgNames({"size", "mutation"});
+
+} // namespace Dubbo
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
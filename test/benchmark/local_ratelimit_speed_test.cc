@@ -0,0 +1,68 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management.
+
+#include <chrono>
+#include <limits>
+#include <memory>
+
+#include "src/meta_protocol_proxy/codec_impl.h"
+#include "src/meta_protocol_proxy/filters/local_ratelimit/local_ratelimit_impl.h"
+
+#include "test/mocks/event/mocks.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace LocalRateLimit {
+
+// The token buckets never run dry during a run, so every request goes through the compare and swap
+// that the workers contend on.
+constexpr uint32_t MaxTokens = std::numeric_limits<uint32_t>::max();
+
+// A limiter shared by all the benchmark threads like the one shared by the workers, with a
+// condition on the method and the global bucket as the fallback.
+static LocalRateLimiterImpl& sharedLimiter() {
+  static auto* dispatcher = new testing::NiceMock<Event::MockDispatcher>();
+  static auto* limiter = [] {
+    LocalRateLimitConfig config;
+    config.set_stat_prefix("benchmark");
+    config.mutable_token_bucket()->set_max_tokens(MaxTokens);
+    config.mutable_token_bucket()->mutable_fill_interval()->set_seconds(1);
+    auto* condition = config.add_conditions();
+    auto* method = condition->mutable_match()->add_metadata();
+    method->set_name("method");
+    method->set_exact_match("sayHello");
+    condition->mutable_token_bucket()->set_max_tokens(MaxTokens);
+    condition->mutable_token_bucket()->mutable_fill_interval()->set_seconds(1);
+    return new LocalRateLimiterImpl(std::chrono::milliseconds(1000), MaxTokens, MaxTokens,
+                                    *dispatcher, config.conditions(), config);
+  }();
+  return *limiter;
+}
+
+// Requests checked by several threads at once, state.range(0) tells whether they match the method
+// condition or fall back to the global bucket.
+static void bmLocalRateLimit(benchmark::State& state) {
+  auto& limiter = sharedLimiter();
+  auto metadata = std::make_shared<MetadataImpl>();
+  metadata->putString("method", state.range(0) == 0 ? "sayHello" : "sayGoodbye");
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    benchmark::DoNotOptimize(limiter.requestAllowed(metadata));
+  }
+}
+BENCHMARK(bmLocalRateLimit)
+    ->Arg(0)
+    ->Arg(1)
+    ->ArgName("global")
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+} // namespace LocalRateLimit
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,78 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management.
+
+#include <string>
+
+#include "src/meta_protocol_proxy/codec_impl.h"
+#include "src/meta_protocol_proxy/route/route_matcher_impl.h"
+
+#include "test/mocks/server/server_factory_context.h"
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Route {
+
+// A route configuration with one route per service, each matching the interface and the method of
+// the request metadata.
+static RouteMatcherImpl::RouteConfig routeConfig(uint64_t routes) {
+  RouteMatcherImpl::RouteConfig config;
+  config.set_name("benchmark");
+  for (uint64_t i = 0; i < routes; i++) {
+    auto* route = config.add_routes();
+    route->set_name(absl::StrCat("route-", i));
+    auto* interface = route->mutable_match()->add_metadata();
+    interface->set_name("interface");
+    interface->set_exact_match(absl::StrCat("org.apache.dubbo.Service", i));
+    auto* method = route->mutable_match()->add_metadata();
+    method->set_name("method");
+    method->set_exact_match("sayHello");
+    route->mutable_route()->set_cluster(absl::StrCat("outbound|20880||service-", i));
+  }
+  return config;
+}
+
+// Matches a request against the middle route, which is what a linear scan costs on average.
+static void bmRouteMatch(benchmark::State& state) {
+  const uint64_t routes = state.range(0);
+  testing::NiceMock<Server::Configuration::MockServerFactoryContext> context;
+  RouteMatcherImpl matcher(routeConfig(routes), context);
+
+  MetadataImpl metadata;
+  metadata.putString("interface", absl::StrCat("org.apache.dubbo.Service", routes / 2));
+  metadata.putString("method", "sayHello");
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    auto route = matcher.route(metadata, 0);
+    RELEASE_ASSERT(route != nullptr, "");
+    benchmark::DoNotOptimize(route);
+  }
+}
+BENCHMARK(bmRouteMatch)->Arg(10)->Arg(1000)->Arg(10000);
+
+// Matches a request that no route accepts, which scans all the routes.
+static void bmRouteMiss(benchmark::State& state) {
+  testing::NiceMock<Server::Configuration::MockServerFactoryContext> context;
+  RouteMatcherImpl matcher(routeConfig(state.range(0)), context);
+
+  MetadataImpl metadata;
+  metadata.putString("interface", "org.apache.dubbo.UnknownService");
+  metadata.putString("method", "sayHello");
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    auto route = matcher.route(metadata, 0);
+    RELEASE_ASSERT(route == nullptr, "");
+    benchmark::DoNotOptimize(route);
+  }
+}
+BENCHMARK(bmRouteMiss)->Arg(10)->Arg(1000)->Arg(10000);
+
+} // namespace Route
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
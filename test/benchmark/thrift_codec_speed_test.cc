@@ -0,0 +1,49 @@
+// Note: this should be run with --compilation_mode=opt, and would benefit from a
+// quiescent system with disabled cstate power management.
+
+#include <string>
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/application_protocols/thrift/thrift_codec.h"
+#include "src/meta_protocol_proxy/codec_impl.h"
+
+#include "test/benchmark/corpus.h"
+
+#include "benchmark/benchmark.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Thrift {
+
+// Decodes a request the way the connection manager does, from a buffer holding one message. The
+// body of a framed message is passed through, an unframed one is walked field by field.
+static void bmThriftDecode(benchmark::State& state) {
+  const auto transport_type = state.range(1) == 0 ? ThriftProxy::TransportType::Framed
+                                                  : ThriftProxy::TransportType::Unframed;
+  const auto protocol_type = state.range(2) == 0 ? ThriftProxy::ProtocolType::Binary
+                                                 : ThriftProxy::ProtocolType::Compact;
+  const std::string request =
+      Benchmark::thriftRequest(transport_type, protocol_type, state.range(0));
+  ThriftCodec codec;
+  for (auto _ : state) { // NOLINT(clang-analyzer-deadcode.DeadStores)
+    UNREFERENCED_PARAMETER(_);
+    Buffer::OwnedImpl buffer(request);
+    MetadataImpl metadata;
+    auto status = codec.decode(buffer, metadata);
+    RELEASE_ASSERT(status == DecodeStatus::Done, "");
+    benchmark::DoNotOptimize(metadata.originMessage().length());
+  }
+  state.SetBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(bmThriftDecode)
+    ->ArgsProduct({{64, 4 * 1024, 256 * 1024}, {0, 1}, {0, 1}})
+    ->ArgNames({"size", "unframed", "compact"});
+
+} // namespace Thrift
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
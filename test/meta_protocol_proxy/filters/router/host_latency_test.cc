@@ -0,0 +1,115 @@
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "src/meta_protocol_proxy/filters/router/host_latency.h"
+
+#include "test/mocks/upstream/host.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+namespace {
+
+using testing::NiceMock;
+
+// The samples after which the median of a cluster is refreshed, see host_latency.cc.
+constexpr uint32_t MedianUpdateInterval = 100;
+
+class HostLatencyTest : public testing::Test {
+public:
+  HostLatencyTest() {
+    // The hosts are all in the same cluster, the mocks share its name.
+    for (int i = 0; i < 3; i++) {
+      hosts_.push_back(std::make_shared<NiceMock<Upstream::MockHostDescription>>());
+    }
+  }
+
+  void initialize() { latency_ = std::make_unique<ThreadLocalHostLatency>(config_); }
+
+  void record(uint32_t host, uint64_t latency_us) {
+    latency_->record(hosts_[host], std::chrono::microseconds(latency_us));
+  }
+
+  // Records the same latency for all the hosts, until the median of the cluster has been refreshed.
+  void recordMedian(uint64_t latency_us) {
+    for (uint32_t i = 0; i < MedianUpdateInterval; i++) {
+      record(i % hosts_.size(), latency_us);
+    }
+  }
+
+  bool isSlow(uint32_t host) { return latency_->isSlow(*hosts_[host]); }
+
+  LatencyOutlierConfig config_;
+  std::vector<std::shared_ptr<NiceMock<Upstream::MockHostDescription>>> hosts_;
+  std::unique_ptr<ThreadLocalHostLatency> latency_;
+};
+
+// With the default weight of 0.2 and factor of 3, a host which goes from 100us to 1000us averages
+// 280us after one sample and 424us after two, the second is above 3 times the median of 100us.
+TEST_F(HostLatencyTest, EjectsAHostAboveTheFactorOfTheMedian) {
+  initialize();
+  recordMedian(100);
+  for (uint32_t i = 0; i < hosts_.size(); i++) {
+    EXPECT_FALSE(isSlow(i));
+  }
+
+  record(2, 1000);
+  EXPECT_FALSE(isSlow(2));
+  record(2, 1000);
+  EXPECT_TRUE(isSlow(2));
+  EXPECT_FALSE(isSlow(0));
+  EXPECT_FALSE(isSlow(1));
+
+  // The average comes back under the threshold after three more samples: 359us, 307us and 266us.
+  record(2, 100);
+  record(2, 100);
+  EXPECT_TRUE(isSlow(2));
+  record(2, 100);
+  EXPECT_FALSE(isSlow(2));
+}
+
+TEST_F(HostLatencyTest, HonorsTheConfiguredWeightAndFactor) {
+  config_.set_ewma_weight(0.5);
+  config_.set_slow_host_factor(6);
+  initialize();
+  recordMedian(100);
+
+  // 550us, then 775us against a threshold of 600us.
+  record(2, 1000);
+  EXPECT_FALSE(isSlow(2));
+  record(2, 1000);
+  EXPECT_TRUE(isSlow(2));
+}
+
+// The median of too few hosts isn't meaningful.
+TEST_F(HostLatencyTest, NeedsTheMinimumHosts) {
+  config_.set_min_hosts(4);
+  initialize();
+  recordMedian(100);
+
+  for (int i = 0; i < 10; i++) {
+    record(2, 10000);
+  }
+  EXPECT_FALSE(isSlow(2));
+}
+
+TEST_F(HostLatencyTest, UnknownHostsAreNotSlow) {
+  initialize();
+  EXPECT_FALSE(isSlow(0));
+
+  recordMedian(100);
+  NiceMock<Upstream::MockHostDescription> unknown;
+  EXPECT_FALSE(latency_->isSlow(unknown));
+}
+
+} // namespace
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
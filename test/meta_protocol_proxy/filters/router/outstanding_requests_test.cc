@@ -0,0 +1,159 @@
+#include <memory>
+#include <vector>
+
+#include "src/meta_protocol_proxy/filters/router/outstanding_requests.h"
+
+#include "test/mocks/upstream/host.h"
+#include "test/mocks/upstream/thread_local_cluster.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace Router {
+namespace {
+
+using testing::NiceMock;
+using testing::ReturnRef;
+
+using MockHostSharedPtr = std::shared_ptr<NiceMock<Upstream::MockHost>>;
+
+class OutstandingRequestsTest : public testing::Test {
+public:
+  // A host of the cluster, it's only in the priority set if it's a member.
+  MockHostSharedPtr newHost(bool member = true) {
+    auto host = std::make_shared<NiceMock<Upstream::MockHost>>();
+    ON_CALL(*host, cluster()).WillByDefault(ReturnRef(*cluster_.cluster_.info_));
+    if (member) {
+      cluster_.cluster_.priority_set_.getMockHostSet(0)->hosts_.push_back(host);
+    }
+    return host;
+  }
+
+  void inc(const MockHostSharedPtr& host, uint32_t times = 1) {
+    for (uint32_t i = 0; i < times; i++) {
+      requests_.inc(host);
+    }
+  }
+
+  NiceMock<Upstream::MockThreadLocalCluster> cluster_;
+  ThreadLocalOutstandingRequests requests_;
+};
+
+TEST_F(OutstandingRequestsTest, CountsTheRequestsOfEachHost) {
+  auto first = newHost();
+  auto second = newHost();
+  requests_.addCluster(cluster_);
+
+  inc(first, 2);
+  inc(second);
+  EXPECT_EQ(2U, requests_.get(*first));
+  EXPECT_EQ(1U, requests_.get(*second));
+
+  requests_.dec(*first);
+  requests_.dec(*second);
+  // A host without requests in flight isn't decremented below zero.
+  requests_.dec(*second);
+  EXPECT_EQ(1U, requests_.get(*first));
+  EXPECT_EQ(0U, requests_.get(*second));
+
+  auto unknown = newHost(false);
+  requests_.dec(*unknown);
+  EXPECT_EQ(0U, requests_.get(*unknown));
+}
+
+// The hosts without requests count in the average of the cluster.
+TEST_F(OutstandingRequestsTest, ComparesAHostToTheAverageOfItsCluster) {
+  auto first = newHost();
+  auto second = newHost();
+  auto third = newHost();
+  requests_.addCluster(cluster_);
+
+  inc(first, 2);
+  inc(second);
+  // 3 requests on 3 hosts.
+  EXPECT_TRUE(requests_.aboveAverage(*first));
+  EXPECT_FALSE(requests_.aboveAverage(*second));
+  EXPECT_FALSE(requests_.aboveAverage(*third));
+
+  inc(second);
+  // 4 requests on 3 hosts.
+  EXPECT_TRUE(requests_.aboveAverage(*first));
+  EXPECT_TRUE(requests_.aboveAverage(*second));
+
+  requests_.dec(*first);
+  requests_.dec(*first);
+  EXPECT_FALSE(requests_.aboveAverage(*first));
+  EXPECT_TRUE(requests_.aboveAverage(*second));
+}
+
+// The host count follows the membership updates of the cluster.
+TEST_F(OutstandingRequestsTest, FollowsTheHostCountOfTheCluster) {
+  auto first = newHost();
+  auto second = newHost();
+  requests_.addCluster(cluster_);
+
+  inc(first, 2);
+  inc(second, 2);
+  // 4 requests on 2 hosts.
+  EXPECT_FALSE(requests_.aboveAverage(*first));
+
+  // 4 requests on 4 hosts.
+  auto third = newHost();
+  auto fourth = newHost();
+  cluster_.cluster_.priority_set_.runUpdateCallbacks(0, {third, fourth}, {});
+  EXPECT_TRUE(requests_.aboveAverage(*first));
+
+  // Adding the cluster again doesn't reset its entry.
+  requests_.addCluster(cluster_);
+  EXPECT_TRUE(requests_.aboveAverage(*first));
+}
+
+// Without the host count of the cluster, no host is above the average.
+TEST_F(OutstandingRequestsTest, NeedsTheHostCount) {
+  auto host = newHost();
+  inc(host, 2);
+  EXPECT_EQ(2U, requests_.get(*host));
+  EXPECT_FALSE(requests_.aboveAverage(*host));
+}
+
+// Once the host entries reach the sweep size, the hosts which are only kept alive by their entry
+// are forgotten, unless they still have requests in flight.
+TEST_F(OutstandingRequestsTest, SweepsTheRemovedHosts) {
+  requests_.addCluster(cluster_);
+
+  auto removed = newHost(false);
+  std::weak_ptr<Upstream::MockHost> removed_ref = removed;
+  inc(removed);
+  requests_.dec(*removed);
+
+  auto busy = newHost(false);
+  std::weak_ptr<Upstream::MockHost> busy_ref = busy;
+  inc(busy);
+
+  removed.reset();
+  busy.reset();
+  EXPECT_FALSE(removed_ref.expired());
+
+  // 64 host entries at least trigger a sweep, see outstanding_requests.h.
+  std::vector<MockHostSharedPtr> hosts;
+  for (int i = 0; i < 64; i++) {
+    hosts.push_back(newHost());
+    inc(hosts.back());
+  }
+  EXPECT_TRUE(removed_ref.expired());
+  EXPECT_FALSE(busy_ref.expired());
+  for (const auto& host : hosts) {
+    EXPECT_EQ(1U, requests_.get(*host));
+  }
+}
+
+} // namespace
+} // namespace Router
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
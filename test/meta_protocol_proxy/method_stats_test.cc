@@ -0,0 +1,136 @@
+#include <memory>
+#include <string>
+
+#include "source/common/stats/isolated_store_impl.h"
+
+#include "src/meta_protocol_proxy/method_stats.h"
+
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace {
+
+// The requests between two rebalances of a table, see method_stats.cc.
+constexpr uint64_t RebalanceInterval = 1024;
+
+class MethodStatsTest : public testing::Test {
+public:
+  void initialize(uint32_t max_methods, uint32_t max_stat_names) {
+    names_ = std::make_shared<MethodStatNames>(store_, "test.method.", max_stat_names);
+    other_ = std::make_shared<MetaProtocolProxyMethodStats>(
+        MetaProtocolProxyMethodStats::generateStats("test.method.other.", store_));
+    local_ = std::make_unique<ThreadLocalMethodStats>(names_, max_methods, other_);
+  }
+
+  MetaProtocolProxyMethodStatsSharedPtr request(const std::string& method, uint64_t times = 1) {
+    MetaProtocolProxyMethodStatsSharedPtr stats;
+    for (uint64_t i = 0; i < times; i++) {
+      stats = local_->requested({"svc", method});
+    }
+    return stats;
+  }
+
+  bool hasStats(const std::string& method) { return request(method) != other_; }
+
+  Stats::IsolatedStoreImpl store_;
+  MethodStatNamesSharedPtr names_;
+  MetaProtocolProxyMethodStatsSharedPtr other_;
+  std::unique_ptr<ThreadLocalMethodStats> local_;
+};
+
+// An RPC gets its stats at the rebalance which follows its requests, not before.
+TEST_F(MethodStatsTest, PromotesAFrequentRpcAtTheRebalance) {
+  initialize(2, 8);
+
+  EXPECT_EQ(other_, request("sayHello", RebalanceInterval - 1));
+  // The request which triggers the rebalance is still counted in the "other" bucket.
+  EXPECT_EQ(other_, request("sayHello"));
+
+  auto stats = request("sayHello");
+  ASSERT_NE(other_, stats);
+  EXPECT_EQ(stats, names_->get({"svc", "sayHello"}));
+  stats->request_.inc();
+  EXPECT_EQ(1U, store_.counterFromString("test.method.svc.sayHello.request").value());
+}
+
+TEST_F(MethodStatsTest, SanitizesTheStatNames) {
+  initialize(2, 8);
+
+  for (uint64_t i = 0; i < RebalanceInterval; i++) {
+    local_->requested({"com.example:1.0", "say.hello"});
+  }
+  auto stats = local_->requested({"com.example:1.0", "say.hello"});
+  ASSERT_NE(other_, stats);
+  stats->request_.inc();
+  EXPECT_EQ(1U,
+            store_.counterFromString("test.method.com_example_1_0.say_hello.request").value());
+}
+
+TEST_F(MethodStatsTest, RequestsWithoutAMethodGoToOther) {
+  initialize(2, 8);
+
+  for (uint64_t i = 0; i < 2 * RebalanceInterval; i++) {
+    EXPECT_EQ(other_, local_->requested({"svc", ""}));
+  }
+}
+
+// The names which only come once, e.g. random ones, keep replacing each other in the sketch and
+// never get stats.
+TEST_F(MethodStatsTest, RareRpcsAreNeverPromoted) {
+  initialize(2, 8);
+
+  for (uint64_t i = 0; i < RebalanceInterval; i++) {
+    EXPECT_EQ(other_, request("random" + std::to_string(i)));
+  }
+  EXPECT_FALSE(hasStats("random0"));
+  EXPECT_FALSE(hasStats("random" + std::to_string(RebalanceInterval - 1)));
+}
+
+// A candidate requested more often than the least requested RPC of a full table takes its place.
+TEST_F(MethodStatsTest, EvictsTheLeastRequestedRpc) {
+  initialize(1, 8);
+
+  request("first", RebalanceInterval);
+  EXPECT_TRUE(hasStats("first"));
+
+  // The hits of the table are halved at each rebalance, so "first" has about RebalanceInterval / 2
+  // when "second" is considered.
+  request("second", RebalanceInterval - 1);
+  EXPECT_TRUE(hasStats("second"));
+  EXPECT_FALSE(hasStats("first"));
+}
+
+TEST_F(MethodStatsTest, KeepsTheTableAgainstLessRequestedRpcs) {
+  initialize(1, 8);
+
+  request("first", RebalanceInterval);
+  EXPECT_TRUE(hasStats("first"));
+
+  request("first", RebalanceInterval / 2);
+  request("second", RebalanceInterval / 2 - 1);
+  EXPECT_TRUE(hasStats("first"));
+  EXPECT_FALSE(hasStats("second"));
+}
+
+// Once max_stat_names RPCs have stats, the others stay in the "other" bucket even if the table of
+// the worker has room.
+TEST_F(MethodStatsTest, LimitsTheRpcsWithStats) {
+  initialize(2, 1);
+
+  request("first", RebalanceInterval);
+  EXPECT_TRUE(hasStats("first"));
+
+  request("second", RebalanceInterval - 1);
+  EXPECT_FALSE(hasStats("second"));
+  EXPECT_TRUE(hasStats("first"));
+  EXPECT_EQ(nullptr, names_->get({"svc", "second"}));
+}
+
+} // namespace
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
@@ -0,0 +1,268 @@
+#include <memory>
+#include <string>
+
+#include "envoy/tcp/conn_pool.h"
+
+#include "source/common/buffer/buffer_impl.h"
+#include "source/common/stats/isolated_store_impl.h"
+
+#include "src/meta_protocol_proxy/conn_manager.h"
+#include "src/meta_protocol_proxy/stream_multiplexer.h"
+
+#include "test/mocks/common.h"
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+#include "test/test_common/simulated_time_system.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+/**
+ * FakeCodec frames each message as a byte of stream id, a byte of message type and a byte of body
+ * length, followed by the body.
+ */
+class FakeCodec : public Codec {
+public:
+  static std::string frame(uint8_t stream_id, MessageType type, const std::string& body) {
+    return std::string({static_cast<char>(stream_id), static_cast<char>(type),
+                        static_cast<char>(body.size())}) +
+           body;
+  }
+
+  // Codec
+  DecodeStatus decode(Buffer::Instance& buffer, Metadata& metadata) override {
+    if (buffer.length() < 3) {
+      return DecodeStatus::WaitForData;
+    }
+    const uint64_t length = 3 + static_cast<uint64_t>(buffer.peekInt<uint8_t>(2));
+    if (buffer.length() < length) {
+      return DecodeStatus::WaitForData;
+    }
+    metadata.setStreamId(buffer.peekInt<uint8_t>(0));
+    metadata.setMessageType(static_cast<MessageType>(buffer.peekInt<uint8_t>(1)));
+    metadata.originMessage().move(buffer, length);
+    return DecodeStatus::Done;
+  }
+  void encode(const Metadata&, const Mutation&, Buffer::Instance&) override {}
+  void onError(const Metadata&, const Error&, Buffer::Instance&) override {}
+};
+
+/**
+ * TestConfig only configures what the streams use.
+ */
+class TestConfig : public Config, public Route::Config, public FilterChainFactory {
+public:
+  TestConfig() : stats_(MetaProtocolProxyStats::generateStats("test.", store_)) {
+    stream_limits_.max_streams_per_upstream_connection_ = 2;
+  }
+
+  // FilterChainFactory
+  void createFilterChain(FilterChainFactoryCallbacks&) override {}
+
+  // Route::Config
+  Route::RouteConstSharedPtr route(const Metadata&, uint64_t) const override { return nullptr; }
+
+  // Config
+  FilterChainFactory& filterFactory() override { return *this; }
+  MetaProtocolProxyStats& stats() override { return stats_; }
+  MetaProtocolProxyPhaseStats* phaseStats() override { return nullptr; }
+  MethodStats* methodStats() override { return nullptr; }
+  uint32_t maxMessageSize() override { return 0; }
+  CodecPtr createCodec() override { return std::make_unique<FakeCodec>(); }
+  Route::Config& routerConfig() override { return *this; }
+  std::string applicationProtocol() override { return "test"; }
+  absl::optional<std::chrono::milliseconds> idleTimeout() override { return absl::nullopt; }
+  const StreamLimits& streamLimits() override { return stream_limits_; }
+  Route::RouteConfigProvider* routeConfigProvider() override { return nullptr; }
+
+  Stats::IsolatedStoreImpl store_;
+  MetaProtocolProxyStats stats_;
+  StreamLimits stream_limits_;
+};
+
+/**
+ * TestUpstream is a pooled upstream connection, it tells whether it has been released to the pool.
+ */
+struct TestUpstream {
+  NiceMock<Network::MockClientConnection> connection_;
+  Tcp::ConnectionPool::UpstreamCallbacks* callbacks_{};
+  Tcp::ConnectionPool::ConnectionStatePtr state_;
+  bool released_{false};
+};
+
+class TestConnectionData : public Tcp::ConnectionPool::ConnectionData {
+public:
+  TestConnectionData(TestUpstream& upstream) : upstream_(upstream) {}
+  ~TestConnectionData() override { upstream_.released_ = true; }
+
+  // Tcp::ConnectionPool::ConnectionData
+  Network::ClientConnection& connection() override { return upstream_.connection_; }
+  void addUpstreamCallbacks(Tcp::ConnectionPool::UpstreamCallbacks& callbacks) override {
+    upstream_.callbacks_ = &callbacks;
+  }
+
+private:
+  // Tcp::ConnectionPool::ConnectionData
+  void setConnectionState_(Tcp::ConnectionPool::ConnectionStatePtr&& state) override {
+    upstream_.state_ = std::move(state);
+  }
+  Tcp::ConnectionPool::ConnectionState* connectionState() override {
+    return upstream_.state_.get();
+  }
+
+  TestUpstream& upstream_;
+};
+
+class StreamMultiplexerTest : public testing::Test {
+public:
+  StreamMultiplexerTest()
+      : flush_callback_(new NiceMock<Event::MockSchedulableCallback>(
+            &read_callbacks_.connection_.dispatcher_)) {
+    ON_CALL(read_callbacks_.connection_, write(_, _))
+        .WillByDefault(Invoke([this](Buffer::Instance& data, bool) {
+          downstream_.append(data.toString());
+          data.drain(data.length());
+        }));
+    manager_ = std::make_unique<ConnectionManager>(config_, random_, time_system_);
+    manager_->initializeReadFilterCallbacks(read_callbacks_);
+  }
+
+  std::string host() {
+    return upstream_.connection_.connectionInfoProvider().remoteAddress()->asString();
+  }
+
+  // Two streams sharing the connection of the upstream.
+  void shareConnection() {
+    Stream& first = manager_->newActiveStream(1);
+    Stream& second = manager_->newActiveStream(2);
+    auto& multiplexer = manager_->streamMultiplexer();
+    ASSERT_TRUE(multiplexer.enabled());
+    EXPECT_EQ(nullptr, multiplexer.attach(first, host()));
+    multiplexer.add(first, std::make_unique<TestConnectionData>(upstream_));
+    auto* conn_data = multiplexer.attach(second, host());
+    ASSERT_NE(nullptr, conn_data);
+    EXPECT_EQ(&upstream_.connection_, &conn_data->connection());
+    ASSERT_NE(nullptr, upstream_.callbacks_);
+  }
+
+  void upstreamData(const std::string& data) {
+    Buffer::OwnedImpl buffer(data);
+    upstream_.callbacks_->onUpstreamData(buffer, false);
+  }
+
+  // Flushes the frames written to the downstream during the iteration.
+  std::string flushDownstream() {
+    flush_callback_->invokeCallback();
+    std::string written;
+    written.swap(downstream_);
+    return written;
+  }
+
+  TestConfig config_;
+  NiceMock<Random::MockRandomGenerator> random_;
+  Event::SimulatedTimeSystem time_system_;
+  NiceMock<Network::MockReadFilterCallbacks> read_callbacks_;
+  // Owned by the write batcher of the downstream.
+  NiceMock<Event::MockSchedulableCallback>* flush_callback_;
+  TestUpstream upstream_;
+  std::string downstream_;
+  std::unique_ptr<ConnectionManager> manager_;
+};
+
+TEST_F(StreamMultiplexerTest, SharesAConnectionUpToTheStreamLimit) {
+  shareConnection();
+  EXPECT_EQ(1U, config_.stats_.stream_multiplexed_.value());
+  EXPECT_EQ(1U, config_.stats_.stream_upstream_cx_shared_.value());
+
+  // The connection carries two streams already.
+  Stream& third = manager_->newActiveStream(3);
+  EXPECT_EQ(nullptr, manager_->streamMultiplexer().attach(third, host()));
+}
+
+// The frames of the shared connection are handed to their stream by stream id, and reach the
+// downstream in the order they came.
+TEST_F(StreamMultiplexerTest, DemultiplexesTheFramesByStreamId) {
+  shareConnection();
+
+  const std::string second = FakeCodec::frame(2, MessageType::Stream_Data, "two");
+  const std::string first = FakeCodec::frame(1, MessageType::Stream_Data, "one");
+  const std::string unknown = FakeCodec::frame(7, MessageType::Stream_Data, "seven");
+  const std::string last = FakeCodec::frame(1, MessageType::Stream_Data, "last");
+
+  Buffer::OwnedImpl buffer(second + unknown + first + last.substr(0, 4));
+  upstream_.callbacks_->onUpstreamData(buffer, false);
+  // The frame of an unknown stream is dropped, the partial frame waits for its end.
+  EXPECT_EQ(second + first, flushDownstream());
+  EXPECT_EQ(4U, buffer.length());
+
+  buffer.add(last.substr(4));
+  upstream_.callbacks_->onUpstreamData(buffer, false);
+  EXPECT_EQ(last, flushDownstream());
+  EXPECT_EQ(0U, buffer.length());
+  EXPECT_FALSE(upstream_.released_);
+}
+
+// The connection goes back to the pool once all its streams have completed.
+TEST_F(StreamMultiplexerTest, ReleasesTheConnectionOnceTheStreamsComplete) {
+  shareConnection();
+  EXPECT_CALL(upstream_.connection_, close(_)).Times(0);
+
+  const std::string first = FakeCodec::frame(1, MessageType::Stream_Close_Two_Way, "");
+  upstreamData(first);
+  EXPECT_FALSE(upstream_.released_);
+
+  const std::string second = FakeCodec::frame(2, MessageType::Stream_Close_Two_Way, "");
+  // The frames after the last one are dropped with the connection.
+  upstreamData(second + FakeCodec::frame(2, MessageType::Stream_Data, "late"));
+  EXPECT_TRUE(upstream_.released_);
+  EXPECT_EQ(first + second, flushDownstream());
+  EXPECT_EQ(0U, config_.stats_.stream_upstream_cx_shared_.value());
+  EXPECT_EQ(0U, config_.stats_.stream_active_.value());
+}
+
+// The frames of a stream given up on may still come, so the connection is closed instead of being
+// reused once the other streams complete.
+TEST_F(StreamMultiplexerTest, ClosesTheConnectionOfAnAbandonedStream) {
+  shareConnection();
+
+  EXPECT_CALL(upstream_.connection_, close(_)).Times(0);
+  manager_->getActiveStream(1).close(true);
+  EXPECT_FALSE(upstream_.released_);
+  testing::Mock::VerifyAndClearExpectations(&upstream_.connection_);
+
+  const std::string late = FakeCodec::frame(1, MessageType::Stream_Data, "late");
+  const std::string second = FakeCodec::frame(2, MessageType::Stream_Close_Two_Way, "");
+  EXPECT_CALL(upstream_.connection_, close(Network::ConnectionCloseType::NoFlush));
+  upstreamData(late + second);
+  EXPECT_TRUE(upstream_.released_);
+  EXPECT_EQ(second, flushDownstream());
+  EXPECT_EQ(0U, config_.stats_.stream_upstream_cx_shared_.value());
+}
+
+// The streams of a connection closed by the upstream are closed.
+TEST_F(StreamMultiplexerTest, ClosesTheStreamsWithTheConnection) {
+  shareConnection();
+
+  upstream_.callbacks_->onEvent(Network::ConnectionEvent::RemoteClose);
+  EXPECT_TRUE(upstream_.released_);
+  EXPECT_FALSE(manager_->streamExisted(1));
+  EXPECT_FALSE(manager_->streamExisted(2));
+  EXPECT_EQ(2U, config_.stats_.stream_upstream_close_.value());
+  EXPECT_EQ(0U, config_.stats_.stream_upstream_cx_shared_.value());
+}
+
+} // namespace
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy
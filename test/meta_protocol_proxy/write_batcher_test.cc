@@ -0,0 +1,141 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "source/common/buffer/buffer_impl.h"
+
+#include "src/meta_protocol_proxy/write_batcher.h"
+
+#include "test/mocks/event/mocks.h"
+#include "test/mocks/network/mocks.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace Envoy {
+namespace Extensions {
+namespace NetworkFilters {
+namespace MetaProtocolProxy {
+namespace {
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+
+class WriteBatcherTest : public testing::Test {
+public:
+  WriteBatcherTest()
+      : flush_callback_(new NiceMock<Event::MockSchedulableCallback>(&connection_.dispatcher_)) {
+    ON_CALL(connection_, write(_, _))
+        .WillByDefault(Invoke([this](Buffer::Instance& data, bool end_stream) {
+          writes_.push_back(data.toString());
+          end_streams_.push_back(end_stream);
+          data.drain(data.length());
+        }));
+  }
+
+  void initialize(uint64_t max_batch_bytes = WriteBatcher::DefaultMaxBatchBytes) {
+    batcher_ = std::make_unique<WriteBatcher>(connection_, max_batch_bytes);
+  }
+
+  void write(const std::string& frame, bool end_stream = false) {
+    Buffer::OwnedImpl data(frame);
+    batcher_->write(data, end_stream);
+    EXPECT_EQ(0U, data.length());
+  }
+
+  NiceMock<Network::MockConnection> connection_;
+  // Owned by the batcher.
+  NiceMock<Event::MockSchedulableCallback>* flush_callback_;
+  std::unique_ptr<WriteBatcher> batcher_;
+  std::vector<std::string> writes_;
+  std::vector<bool> end_streams_;
+};
+
+// The frames written during a dispatcher iteration leave in one write at its end.
+TEST_F(WriteBatcherTest, BatchesFramesUntilTheScheduledFlush) {
+  initialize();
+
+  write("one");
+  write("two");
+  EXPECT_TRUE(writes_.empty());
+  EXPECT_EQ(6U, batcher_->pendingBytes());
+  EXPECT_TRUE(flush_callback_->enabled());
+
+  flush_callback_->invokeCallback();
+  EXPECT_EQ(std::vector<std::string>({"onetwo"}), writes_);
+  EXPECT_EQ(std::vector<bool>({false}), end_streams_);
+  EXPECT_EQ(0U, batcher_->pendingBytes());
+
+  // Nothing is written without pending frames.
+  batcher_->flush();
+  EXPECT_EQ(1U, writes_.size());
+}
+
+TEST_F(WriteBatcherTest, WritesOnceTheByteCapIsReached) {
+  initialize(8);
+
+  write("1234");
+  EXPECT_TRUE(writes_.empty());
+  write("5678");
+  EXPECT_EQ(std::vector<std::string>({"12345678"}), writes_);
+  EXPECT_FALSE(flush_callback_->enabled());
+
+  write("9");
+  EXPECT_EQ(1U, writes_.size());
+  EXPECT_TRUE(flush_callback_->enabled());
+}
+
+TEST_F(WriteBatcherTest, EndStreamWritesThePendingFramesAtOnce) {
+  initialize();
+
+  write("one");
+  write("two", true);
+  EXPECT_EQ(std::vector<std::string>({"onetwo"}), writes_);
+  EXPECT_EQ(std::vector<bool>({true}), end_streams_);
+  EXPECT_FALSE(flush_callback_->enabled());
+}
+
+// Above the high watermark the frames go to the write buffer of the connection, so that its
+// watermarks account for them.
+TEST_F(WriteBatcherTest, WritesImmediatelyAboveTheHighWatermark) {
+  initialize();
+
+  write("one");
+  batcher_->onAboveWriteBufferHighWatermark();
+  // The pending frame is left to the scheduled flush, the callback runs in the middle of a write.
+  EXPECT_TRUE(writes_.empty());
+  EXPECT_TRUE(flush_callback_->enabled());
+
+  write("two");
+  EXPECT_EQ(std::vector<std::string>({"onetwo"}), writes_);
+  write("three");
+  EXPECT_EQ(std::vector<std::string>({"onetwo", "three"}), writes_);
+  EXPECT_FALSE(flush_callback_->enabled());
+
+  batcher_->onBelowWriteBufferLowWatermark();
+  write("four");
+  EXPECT_EQ(2U, writes_.size());
+  EXPECT_EQ(4U, batcher_->pendingBytes());
+  flush_callback_->invokeCallback();
+  EXPECT_EQ(std::vector<std::string>({"onetwo", "three", "four"}), writes_);
+}
+
+TEST_F(WriteBatcherTest, DropsTheFramesOfAClosedConnection) {
+  initialize();
+
+  write("one");
+  connection_.state_ = Network::Connection::State::Closed;
+  EXPECT_CALL(connection_, write(_, _)).Times(0);
+  flush_callback_->invokeCallback();
+  EXPECT_EQ(0U, batcher_->pendingBytes());
+
+  write("two", true);
+  EXPECT_EQ(0U, batcher_->pendingBytes());
+}
+
+} // namespace
+} // namespace MetaProtocolProxy
+} // namespace NetworkFilters
+} // namespace Extensions
+} // namespace Envoy